@@ -0,0 +1,105 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "hfpagreplyparser.h"
+
+HfpAGReplyParser::HfpAGReplyParser()
+{
+	mCallStateParser.bindArray("lines", [this]() {
+		mCallState.hasLines = true;
+	});
+	mCallStateParser.bindObject("lines[]", [this]() {
+		AGReply::CallLine line = {"", "", "", 0, false, false, false, false, false, false, 0};
+		mCallState.lines.push_back(line);
+	});
+	mCallStateParser.bindString("lines[].state", [this](const std::string &value) {
+		mCallState.lines.back().state = value;
+		mCallState.lines.back().hasState = true;
+	});
+	mCallStateParser.bindObject("lines[].calls[]", [this]() {
+		mCallState.lines.back().callCount++;
+	});
+	mCallStateParser.bindNumber("lines[].calls[].id", [this](int64_t value) {
+		auto &line = mCallState.lines.back();
+		if (line.callCount != 1)
+			return;
+		line.id = static_cast<int>(value);
+		line.hasId = true;
+	});
+	mCallStateParser.bindString("lines[].calls[].origin", [this](const std::string &value) {
+		auto &line = mCallState.lines.back();
+		if (line.callCount != 1)
+			return;
+		line.origin = value;
+		line.hasOrigin = true;
+	});
+	mCallStateParser.bindBoolean("lines[].calls[].imsconfinfo", [this](bool value) {
+		auto &line = mCallState.lines.back();
+		if (line.callCount != 1)
+			return;
+		line.imsconfinfo = value;
+		line.hasImsConfInfo = true;
+	});
+	mCallStateParser.bindString("lines[].calls[].address", [this](const std::string &value) {
+		auto &line = mCallState.lines.back();
+		if (line.callCount != 1)
+			return;
+		line.address = value;
+		line.hasAddress = true;
+	});
+
+	mDeviceStatusParser.bindObject("devices[]", [this]() {
+		mDeviceStatus.devices.push_back({"", false, false, false});
+	});
+	mDeviceStatusParser.bindString("devices[].address", [this](const std::string &value) {
+		mDeviceStatus.devices.back().address = value;
+		mDeviceStatus.devices.back().hasAddress = true;
+	});
+	mDeviceStatusParser.bindArray("devices[].connectedProfiles", [this]() {
+		mDeviceStatus.devices.back().hasConnectedProfiles = true;
+	});
+	mDeviceStatusParser.bindString("devices[].connectedProfiles[]", [this](const std::string &value) {
+		if (value == "hfp")
+			mDeviceStatus.devices.back().hfpConnected = true;
+	});
+}
+
+HfpAGReplyParser::~HfpAGReplyParser()
+{
+}
+
+bool HfpAGReplyParser::parseCallState(const std::string &payload, AGReply::CallState &result)
+{
+	mCallState.hasLines = false;
+	mCallState.lines.clear();
+
+	if (!mCallStateParser.parse(payload))
+		return false;
+
+	result = std::move(mCallState);
+	return true;
+}
+
+bool HfpAGReplyParser::parseDeviceStatus(const std::string &payload, AGReply::DeviceStatus &result)
+{
+	mDeviceStatus.devices.clear();
+
+	if (!mDeviceStatusParser.parse(payload))
+		return false;
+
+	result = std::move(mDeviceStatus);
+	return true;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPAGREPLYPARSER_H_
+#define HFPAGREPLYPARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "jsonsaxparser.h"
+
+namespace AGReply
+{
+	// One entry of callStateQuery "lines", only the first call is kept
+	struct CallLine
+	{
+		std::string state;
+		std::string origin;
+		std::string address;
+		int id;
+		bool imsconfinfo;
+		bool hasState;
+		bool hasId;
+		bool hasOrigin;
+		bool hasImsConfInfo;
+		bool hasAddress;
+		int callCount;
+	};
+
+	// com.palm.telephony/callStateQuery
+	struct CallState
+	{
+		bool hasLines;
+		std::vector<CallLine> lines;
+	};
+
+	// One entry of device/getStatus "devices"
+	struct Device
+	{
+		std::string address;
+		bool hasAddress;
+		bool hasConnectedProfiles;
+		bool hfpConnected;
+	};
+
+	// device/getStatus
+	struct DeviceStatus
+	{
+		std::vector<Device> devices;
+	};
+}
+
+class HfpAGReplyParser
+{
+public:
+	HfpAGReplyParser();
+	~HfpAGReplyParser();
+
+	bool parseCallState(const std::string &payload, AGReply::CallState &result);
+	bool parseDeviceStatus(const std::string &payload, AGReply::DeviceStatus &result);
+
+private:
+	JsonSaxParser mCallStateParser;
+	JsonSaxParser mDeviceStatusParser;
+	AGReply::CallState mCallState;
+	AGReply::DeviceStatus mDeviceStatus;
+};
+
+#endif
+
+// HFPAGREPLYPARSER_H_
@@ -55,8 +55,8 @@ HfpAGRole::~HfpAGRole()
 
 void HfpAGRole::initialize()
 {
-	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_TEL_CALL_STATE, std::bind(&HfpAGRole::callStateCb, this, _1));
-	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_BT_DEVICE_STATUS, std::bind(&HfpAGRole::deviceStatusCb, this, _1));
+	mSubscribe->setPayloadCallbackFunc(HfpAGSubscribe::CB_TEL_CALL_STATE, std::bind(&HfpAGRole::callStateCb, this, _1));
+	mSubscribe->setPayloadCallbackFunc(HfpAGSubscribe::CB_BT_DEVICE_STATUS, std::bind(&HfpAGRole::deviceStatusCb, this, _1));
 	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_LB_BATTERY_INFO, std::bind(&HfpAGRole::batteryInfoCb, this, _1));
 	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_AUDIO_CALL_VOLUME, std::bind(&HfpAGRole::callVolumeCb, this, _1));
 	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_TEL_SIGNAL_STRENGTH, std::bind(&HfpAGRole::signalStrengthCb, this, _1));
@@ -66,38 +66,32 @@ void HfpAGRole::initialize()
 	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_BT_HFP_STATUS, std::bind(&HfpAGRole::hfpStatusCb, this, _1));
 	mSubscribe->setCallbackFunc(HfpAGSubscribe::CB_TEL_PHONE_NUMBER, std::bind(&HfpAGRole::phoneNumberCb, this, _1));
 
-	mSubscribe->subscribeServices();
+	// Battery and audio follow once a hands-free unit connects
+	mSubscribe->subscribeServices(false);
 }
 
-void HfpAGRole::deviceStatusCb(const pbnjson::JValue &replyObj)
+void HfpAGRole::deviceStatusCb(const std::string &payload)
 {
-	if (!replyObj.hasKey("devices"))
+	AGReply::DeviceStatus deviceStatus;
+	if (!mReplyParser.parseDeviceStatus(payload, deviceStatus))
+	{
+		BT_DEBUG("subscribe callback error:%s", retrieveErrorText(BT_ERR_BAD_JSON).c_str());
 		return;
+	}
 
-	auto devicesObjArray = replyObj["devices"];
-	for (int i = 0; i < devicesObjArray.arraySize(); i++)
+	for (auto &device : deviceStatus.devices)
 	{
-		auto deviceObj = devicesObjArray[i];
-		if (!deviceObj.hasKey("address") || !deviceObj.hasKey("connectedProfiles"))
+		if (!device.hasAddress || !device.hasConnectedProfiles)
 			continue;
 
-		auto address = deviceObj["address"].asString();
-		auto connectedProfiles = deviceObj["connectedProfiles"];
-		bool bFound = false;
-		for (int n = 0; n < connectedProfiles.arraySize(); n++)
+		if (device.hfpConnected)
 		{
-			std::string profile = connectedProfiles[n].asString();
-			if (profile != "hfp")
-				continue;
-
-			bFound = true;
-			addConnectedDevice(address);
-			BT_DEBUG("Add device:%s", address.c_str());
-			break;
+			addConnectedDevice(device.address);
+			BT_DEBUG("Add device:%s", device.address.c_str());
+			mSubscribe->subscribeServices();
 		}
-
-		if (!bFound)
-			removeConnectedDevice(address);
+		else
+			removeConnectedDevice(device.address);
 	}
 }
 
@@ -391,43 +385,35 @@ void HfpAGRole::requestSCOchannel(bool isOpen, const std::string &address)
 		LSCallOneReply(getService()->get(), "luna://com.webos.service.bluetooth2/hfp/closeSCO", param, nullptr, nullptr, nullptr, nullptr);
 }
 
-void HfpAGRole::setCallStatus(const pbnjson::JValue &inputObj, HfpAGCallStatus &callStatus)
+void HfpAGRole::setCallStatus(const std::vector<AGReply::CallLine> &lines, HfpAGCallStatus &callStatus)
 {
-	for (int i = 0; i < inputObj.arraySize(); i++)
+	for (int i = 0; i < lines.size(); i++)
 	{
-		auto lineObj = inputObj[i];
-		if (lineObj.hasKey("state"))
-			callStatus.setCallStatus(i, lineObj["state"].asString());
+		auto &line = lines[i];
+		if (line.hasState)
+			callStatus.setCallStatus(i, line.state);
 
-		if (!lineObj.hasKey("calls"))
-			continue;
-
-		auto callsObjArray = lineObj["calls"];
-		auto callObj = callsObjArray[0];
-		if (callObj.hasKey("id"))
-			callStatus.setCallInfo(i, HfpAGCallStatus::INDEX, callObj["id"].asNumber<int32_t>());
-		if (callObj.hasKey("origin"))
+		if (line.hasId)
+			callStatus.setCallInfo(i, HfpAGCallStatus::INDEX, line.id);
+		if (line.hasOrigin)
 		{
-			std::string origin = callObj["origin"].asString();
-			if (origin.compare("outgoing") == 0)
+			if (line.origin.compare("outgoing") == 0)
 				callStatus.setCallInfo(i, HfpAGCallStatus::DIRECTION, 0);
-			else if (origin.compare("incoming") == 0)
+			else if (line.origin.compare("incoming") == 0)
 				callStatus.setCallInfo(i, HfpAGCallStatus::DIRECTION, 1);
 		}
 
-		if (callObj.hasKey("imsconfinfo"))
+		if (line.hasImsConfInfo)
 		{
-			bool imsconfinfo = callObj["imsconfinfo"].asBool();
-			if (imsconfinfo)
+			if (line.imsconfinfo)
 				callStatus.setCallInfo(i, HfpAGCallStatus::MULTIPARTY, 1);
 			else
 				callStatus.setCallInfo(i, HfpAGCallStatus::MULTIPARTY, 0);
 		}
-		if (callObj.hasKey("address"))
+		if (line.hasAddress)
 		{
-			std::string address = callObj["address"].asString();
-			callStatus.setCallNumber(i, address);
-			if(address[0] == '+')
+			callStatus.setCallNumber(i, line.address);
+			if(line.address[0] == '+')
 				callStatus.setCallInfo(i, HfpAGCallStatus::TYPE, TYPE_INTERNATIONAL);
 			else
 				callStatus.setCallInfo(i, HfpAGCallStatus::TYPE, TYPE_NATIONAL);
@@ -602,33 +588,33 @@ void HfpAGRole::processMultiCall(int count, const HfpAGCallStatus &callStatus)
 	mCallStatus->printCINDState("MA");
 }
 
-void HfpAGRole::callStateCb(const pbnjson::JValue &replyObj)
+void HfpAGRole::callStateCb(const std::string &payload)
 {
 	if (nullptr == mCallStatus)
 		return;
 
-	if (!replyObj.hasKey("lines"))
+	AGReply::CallState callState;
+	if (!mReplyParser.parseCallState(payload, callState))
 	{
-		mCallStatus->clearCallInfo();
+		BT_DEBUG("subscribe callback error:%s", retrieveErrorText(BT_ERR_BAD_JSON).c_str());
 		return;
 	}
 
-	auto linesObjArray = replyObj["lines"];
-	if (0 == linesObjArray.arraySize())
+	if (!callState.hasLines || callState.lines.empty())
 	{
 		mCallStatus->clearCallInfo();
 		return;
 	}
 
 	HfpAGCallStatus newCallStatus;
-	setCallStatus(linesObjArray, newCallStatus);
+	setCallStatus(callState.lines, newCallStatus);
 	newCallStatus.printCallInfo("NC");
 	mCallStatus->printCallInfo("CC");
 
-	if (1 == linesObjArray.arraySize())
+	if (1 == callState.lines.size())
 		processSingleCall(newCallStatus);
 	else
-		processMultiCall(linesObjArray.arraySize(), newCallStatus);
+		processMultiCall(callState.lines.size(), newCallStatus);
 
 	for (int i = 0; i < MAX_CALL; i++)
 	{
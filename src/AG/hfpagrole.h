@@ -18,9 +18,11 @@
 #define HFPAGROLE_H_
 
 #include <glib.h>
+#include <vector>
 #include <luna-service2/lunaservice.hpp>
 
 #include "hfprole.h"
+#include "hfpagreplyparser.h"
 
 class HfpAGSubscribe;
 class HfpAGCallStatus;
@@ -42,12 +44,12 @@ private:
 	void sendResult(const std::string &resultCode);
 	void indicateCall(const std::string &number);
 	void requestSCOchannel(bool isOpen, const std::string &address);
-	void setCallStatus(const pbnjson::JValue &inputObj, HfpAGCallStatus &callStatus);
+	void setCallStatus(const std::vector<AGReply::CallLine> &lines, HfpAGCallStatus &callStatus);
 	void processSingleCall(const HfpAGCallStatus &callStatus);
 	void processMultiCall(int count, const HfpAGCallStatus &callStatus);
 
-	void callStateCb(const pbnjson::JValue &replyObj);
-	void deviceStatusCb(const pbnjson::JValue &replyObj);
+	void callStateCb(const std::string &payload);
+	void deviceStatusCb(const std::string &payload);
 	void batteryInfoCb(const pbnjson::JValue &replyObj);
 	void callVolumeCb(const pbnjson::JValue &replyObj);
 	void signalStrengthCb(const pbnjson::JValue &replyObj);
@@ -64,6 +66,7 @@ private:
 	bool mHfpSco;
 	HfpAGSubscribe *mSubscribe;
 	HfpAGCallStatus *mCallStatus;
+	HfpAGReplyParser mReplyParser;
 };
 
 #endif
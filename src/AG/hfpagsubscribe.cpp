@@ -19,11 +19,11 @@
 #include "logging.h"
 #include "bluetootherrors.h"
 #include "ls2utils.h"
+#include "loopmonitor.h"
 
 HfpAGSubscribe::HfpAGSubscribe(HfpAGRole *role, LSHandle *handle) :
         mHfpAGRole(role),
-        mHandle(handle),
-        mServerStatusRegistered(false)
+        mHandle(handle)
 {
 	memset(mLSCallToken, LSMESSAGE_TOKEN_INVALID, sizeof(mLSCallToken));
 	memset(mSubscribeCbs, 0x0, sizeof(mSubscribeCbs));
@@ -56,13 +56,17 @@ void HfpAGSubscribe::subscribeService(const std::string &service, const bool con
 	}
 }
 
-void HfpAGSubscribe::subscribeServices()
+// Only of use once a hands-free unit is connected to the AG. Telephony is
+// not among them, AT+CIND? and AT+CLCC during the first service level
+// connection are answered from its state. A battery level that comes in
+// later is reported with +CIEV.
+static const std::unordered_set<std::string> deferredServices = {
+	"com.palm.lunabus",
+	"com.palm.audio"
+};
+
+void HfpAGSubscribe::subscribeServices(bool includeDeferred)
 {
-	if (mServerStatusRegistered)
-	{
-		BT_DEBUG("already registered");
-		return;
-	}
 
 	auto callback = [](LSHandle *handle, const char *service, bool connected, void *context) -> bool {
 		HfpAGSubscribe::AGSubscribeInfo *cbInfo = static_cast<HfpAGSubscribe::AGSubscribeInfo *>(context);
@@ -94,6 +98,12 @@ void HfpAGSubscribe::subscribeServices()
 		if (iter != serviceMap.end())
 			continue;
 
+		if (mRegisteredServices.find(subscribe->second.service) != mRegisteredServices.end())
+			continue;
+
+		if (!includeDeferred && deferredServices.find(subscribe->second.service) != deferredServices.end())
+			continue;
+
 		serviceMap.insert(std::pair<std::string, int>(subscribe->second.service, i));
 
 		LSErrorInit(&lserror);
@@ -107,9 +117,10 @@ void HfpAGSubscribe::subscribeServices()
 		{
 			BT_DEBUG("register server(%s) error:%s", subscribe->second.service.c_str(), lserror.message);
 			LSErrorFree(&lserror);
+			continue;
 		}
+		mRegisteredServices.insert(subscribe->second.service);
 	}
-	mServerStatusRegistered = true;
 }
 
 void HfpAGSubscribe::subscribeAll()
@@ -194,8 +205,15 @@ bool HfpAGSubscribe::setCallbackFunc(SubscribeCbType cbType, SubscribeCbFunc cbF
 	return true;
 }
 
+bool HfpAGSubscribe::setPayloadCallbackFunc(SubscribeCbType cbType, SubscribePayloadCbFunc cbFunc)
+{
+	mSubscribePayloadCbs[cbType] = cbFunc;
+	return true;
+}
+
 bool HfpAGSubscribe::subscribeCb(LSHandle *handle, LSMessage *reply, void *context)
 {
+	LOOP_MONITOR_SCOPE();
 	HfpAGSubscribe::AGSubscribeInfo *cbInfo = static_cast<HfpAGSubscribe::AGSubscribeInfo *>(context);
 	if (nullptr == cbInfo)
 		return true;
@@ -204,7 +222,19 @@ bool HfpAGSubscribe::subscribeCb(LSHandle *handle, LSMessage *reply, void *conte
 	if (nullptr == self)
 		return true;
 
+	if (cbInfo->cbType >= MAX_CALLBACK_TYPE || cbInfo->cbType < 0)
+		return true;
+
 	LS::Message replyMsg(reply);
+
+	// Payload callbacks extract their own fields, so skip building the DOM
+	if (self->mSubscribePayloadCbs[cbInfo->cbType])
+	{
+		BT_DEBUG("subscribe callback:%d", cbInfo->cbType);
+		self->mSubscribePayloadCbs[cbInfo->cbType](replyMsg.getPayload());
+		return true;
+	}
+
 	pbnjson::JValue replyObj;
 	int parseError = 0;
 
@@ -218,9 +248,6 @@ bool HfpAGSubscribe::subscribeCb(LSHandle *handle, LSMessage *reply, void *conte
 		return true;
 	}
 
-	if (cbInfo->cbType >= MAX_CALLBACK_TYPE || cbInfo->cbType < 0)
-		return true;
-
 	BT_DEBUG("subscribe callback:%d", cbInfo->cbType);
 	if (self->mSubscribeCbs[cbInfo->cbType])
 		self->mSubscribeCbs[cbInfo->cbType](replyObj);
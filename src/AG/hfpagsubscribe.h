@@ -19,11 +19,13 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <luna-service2/lunaservice.hpp>
 #include <pbnjson.hpp>
 
 typedef std::function<void(const pbnjson::JValue &)> SubscribeCbFunc;
+typedef std::function<void(const std::string &)> SubscribePayloadCbFunc;
 
 class HfpAGRole;
 
@@ -73,13 +75,14 @@ public:
 		MAX_CALLBACK_TYPE
 	};
 
-	void subscribeServices();
+	void subscribeServices(bool includeDeferred = true);
 	void subscribeAll();
 	void subscribeService(const std::string &service, const bool connected);
 	bool subscribe(SubscribeCbType cbType);
 	bool cancelSubscribe(SubscribeCbType cbType);
 	bool setPayload(SubscribeCbType cbType, const std::string &payload);
 	bool setCallbackFunc(SubscribeCbType cbType, SubscribeCbFunc cbFunc);
+	bool setPayloadCallbackFunc(SubscribeCbType cbType, SubscribePayloadCbFunc cbFunc);
 	HfpAGRole *getParent() { return mHfpAGRole; }
 
 private:
@@ -87,10 +90,11 @@ private:
 
 private:
 	SubscribeCbFunc mSubscribeCbs[MAX_CALLBACK_TYPE];
+	SubscribePayloadCbFunc mSubscribePayloadCbs[MAX_CALLBACK_TYPE];
 	LSMessageToken mLSCallToken[MAX_CALLBACK_TYPE];
 	HfpAGRole *mHfpAGRole;
 	LSHandle *mHandle;
-	bool mServerStatusRegistered;
+	std::unordered_set<std::string> mRegisteredServices;
 
 	std::unordered_map<int, HfpAGSubscribe::AGSubscribeInfo> mAGSubscribeInfo = {
 		{CB_TEL_CALL_STATE, {CB_TEL_CALL_STATE, "luna://com.palm.telephony/callStateQuery", "{\"subscribe\":true}", "com.palm.telephony", nullptr, true, true}},
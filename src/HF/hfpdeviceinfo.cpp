@@ -16,6 +16,7 @@
 
 #include <memory.h>
 #include "hfpdeviceinfo.h"
+#include "statejournal.h"
 #include "logging.h"
 
 HfpDeviceInfo::HfpDeviceInfo():
@@ -39,9 +40,22 @@ HfpDeviceInfo::~HfpDeviceInfo()
 {
 }
 
+void HfpDeviceInfo::setAddress(const std::string &remoteAddr, const std::string &adapterAddr)
+{
+	mAddress = remoteAddr;
+	mAdapterAddress = adapterAddr;
+}
+
+void HfpDeviceInfo::journal(JOURNAL::Event event, int index, int value, const std::string &key, const std::string &text)
+{
+	StateJournal::getInstance().record(event, mAdapterAddress, mAddress, index, value, key, text);
+}
+
 bool HfpDeviceInfo::setDeviceStatus(int index, int value)
 {
 	//int type = mCINDIndex[index];
+	if (mDeviceStatus[index] != value)
+		journal(JOURNAL::INDICATOR, index, value);
 	mDeviceStatus[index] = value;
 
 /*
@@ -58,11 +72,62 @@ void HfpDeviceInfo::setCallStatus(const std::string &phoneNumber, int index, con
 	if (localCallStatus == nullptr)
 	{
 		localCallStatus = new HfpHFCallStatus;
+		if (mAudioStatus[SCO::DeviceStatus::CONNECTED] == HFGeneral::Status::STATUSTRUE)
+			localCallStatus->setSCOConnected(true);
 		mCallStatus.insert(std::make_pair(phoneNumber, localCallStatus));
 	}
+	if (localCallStatus->getCallStatus(index) != value)
+		journal(JOURNAL::CALL_STATUS, index, 0, phoneNumber, value);
 	localCallStatus->setCallStatus(index, value);
 }
 
+void HfpDeviceInfo::setAudioStatus(int index, int value)
+{
+	if (mAudioStatus[index] != value)
+		journal(JOURNAL::AUDIO, index, value);
+	mAudioStatus[index] = value;
+	if (index != SCO::DeviceStatus::CONNECTED)
+		return;
+
+	for (auto &callStatus : mCallStatus)
+		callStatus.second->setSCOConnected(value == HFGeneral::Status::STATUSTRUE);
+}
+
+void HfpDeviceInfo::setAGFeature(int index, bool value)
+{
+	if (mAGFeature[index] != value)
+		journal(JOURNAL::FEATURE, index, value);
+	mAGFeature[index] = value;
+}
+
+void HfpDeviceInfo::setBVRA(bool isEnabled)
+{
+	if (mIsEnabledBVRA != isEnabled)
+		journal(JOURNAL::BVRA, 0, isEnabled);
+	mIsEnabledBVRA = isEnabled;
+}
+
+void HfpDeviceInfo::setRING(bool received)
+{
+	if (mIsReceivedRING != received)
+		journal(JOURNAL::RING, 0, received);
+	mIsReceivedRING = received;
+}
+
+void HfpDeviceInfo::setNetworkOperatorName(std::string name)
+{
+	if (mNetworkOperatorName != name)
+		journal(JOURNAL::NETWORK_OPERATOR, 0, 0, "", name);
+	mNetworkOperatorName = name;
+}
+
+void HfpDeviceInfo::setNetworkRegistrationStatus(std::string status)
+{
+	if (mNetworkRegistrationStatus != status)
+		journal(JOURNAL::NETWORK_STATUS, 0, 0, "", status);
+	mNetworkRegistrationStatus = status;
+}
+
 std::string HfpDeviceInfo::getCallStatus(const std::string &phoneNumber, int index)
 {
 	HfpHFCallStatus* localCallStatus = findCallStatusObj(phoneNumber);
@@ -83,10 +148,16 @@ HfpHFCallStatus* HfpDeviceInfo::findCallStatusObj(const std::string &phoneNumber
 
 void HfpDeviceInfo::clearCLCC()
 {
+	if (!mCallStatus.empty())
+		journal(JOURNAL::CALLS_CLEARED);
 	for (auto& i : mCallStatus)
 	{
 		if (i.second != nullptr)
+		{
+			if (mCallEndedFunc)
+				mCallEndedFunc(i.first, *i.second);
 			delete i.second;
+		}
 	}
 	mCallStatus.clear();
 }
@@ -96,6 +167,9 @@ void HfpDeviceInfo::eraseCallStatus(const std::string &phoneNumber)
 	auto eraseCallStatus = mCallStatus.find(phoneNumber);
 	if (eraseCallStatus != mCallStatus.end())
 	{
+		journal(JOURNAL::CALL_ERASED, 0, 0, phoneNumber);
+		if (mCallEndedFunc)
+			mCallEndedFunc(phoneNumber, *eraseCallStatus->second);
 		delete eraseCallStatus->second;
 		mCallStatus.erase(phoneNumber);
 	}
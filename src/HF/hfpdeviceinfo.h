@@ -19,9 +19,12 @@
 
 #include "hfphfdefines.h"
 #include "hfphfcallstatus.h"
+#include "statejournalformat.h"
+#include <functional>
 #include <unordered_map>
 
 using CallStatusList =  std::unordered_map<std::string, HfpHFCallStatus*>;
+using CallEndedFunc = std::function<void(const std::string &phoneNumber, const HfpHFCallStatus &callStatus)>;
 
 class HfpDeviceInfo
 {
@@ -30,14 +33,16 @@ public:
 	~HfpDeviceInfo();
 
 	bool setDeviceStatus(int index, int value);
-	void setAudioStatus(int index, int value) {mAudioStatus[index] = value; }
-	void setAGFeature(int index, bool value) { mAGFeature[index] = value; }
-	void setBVRA(bool isEnabled) noexcept { mIsEnabledBVRA = isEnabled; }
-	void setRING(bool received) noexcept { mIsReceivedRING = received; }
+	void setAddress(const std::string &remoteAddr, const std::string &adapterAddr);
+	void setAudioStatus(int index, int value);
+	void setAGFeature(int index, bool value);
+	void setBVRA(bool isEnabled);
+	void setRING(bool received);
 	void setCINDIndex(int index, int type) { mCINDIndex[index] = type; }
 	void setCallStatus(const std::string &phoneNumber, int index, const std::string &value);
-	void setNetworkOperatorName(std::string name) { mNetworkOperatorName = name; }
-	void setNetworkRegistrationStatus(std::string status) { mNetworkRegistrationStatus = status; }
+	void setNetworkOperatorName(std::string name);
+	void setNetworkRegistrationStatus(std::string status);
+	void setCallEndedFunc(CallEndedFunc func) { mCallEndedFunc = func; }
 	void eraseCallStatus(const std::string &phoneNumber);
 	void clearCLCC();
 
@@ -50,11 +55,13 @@ public:
 	int getCINDIndex(int index) const { return mCINDIndex[index]; }
 	CallStatusList getCallStatusList() const noexcept { return mCallStatus; }
 	std::string getAdapterAddress() const {return mAdapterAddress;}
+	std::string getAddress() const { return mAddress; }
 	std::string getNetworkOperatorName() const { return mNetworkOperatorName; }
 	std::string getNetworkRegistrationStatus() const { return mNetworkRegistrationStatus; }
 
 private:
 	void initialize();
+	void journal(JOURNAL::Event event, int index = 0, int value = 0, const std::string &key = "", const std::string &text = "");
 	HfpHFCallStatus* findCallStatusObj(const std::string &phoneNumber);
 
 private:
@@ -66,7 +73,9 @@ private:
 	int mCINDIndex[CIND::DeviceStatus::MAXSTATUS];
 	CallStatusList mCallStatus;
 	std::string mAdapterAddress;
+	std::string mAddress;
 	std::string mNetworkOperatorName;
 	std::string mNetworkRegistrationStatus;
+	CallEndedFunc mCallEndedFunc; //told about every call before it is dropped
 };
 #endif //__HFPDEVICEINFO_H_
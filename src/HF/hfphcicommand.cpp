@@ -0,0 +1,250 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "hfphcicommand.h"
+#include "logging.h"
+
+// Kernel HCI socket interface, kept local so that no bluez headers are needed
+#define HCI_AF_BLUETOOTH         31
+#define HCI_BTPROTO_HCI          1
+#define HCI_SOL_HCI              0
+#define HCI_FILTER               2
+#define HCI_CHANNEL_RAW          0
+#define HCI_COMMAND_PKT          0x01
+#define HCI_EVENT_PKT            0x04
+#define HCI_EVT_CMD_COMPLETE     0x0E
+#define HCI_EVT_CMD_STATUS       0x0F
+#define HCI_OPCODE(ogf, ocf)     ((uint16_t) (((ogf) << 10) | (ocf)))
+
+// Vendor specific SCO routing command, same as
+// "hcitool cmd 0x3F 0x01C 0x01 0x02 0x00 0x01 0x01"
+#define HCI_OGF_VENDOR           0x3F
+#define HCI_OCF_SCO_ROUTING      0x01C
+
+struct HciSocketAddress
+{
+	sa_family_t family;
+	unsigned short device;
+	unsigned short channel;
+};
+
+struct HciFilter
+{
+	uint32_t typeMask;
+	uint32_t eventMask[2];
+	uint16_t opcode;
+};
+
+HfpHciSocketTransport::HfpHciSocketTransport(unsigned int timeoutMs) :
+	mTimeoutMs(timeoutMs)
+{
+}
+
+HfpHciSocketTransport::~HfpHciSocketTransport()
+{
+	for (auto &pending : mPendingCommands)
+	{
+		PendingCommand *command = pending.second;
+		if (command->ioWatch)
+			g_source_remove(command->ioWatch);
+		if (command->timeout)
+			g_source_remove(command->timeout);
+		close(command->fd);
+		delete command;
+	}
+	mPendingCommands.clear();
+}
+
+int HfpHciSocketTransport::openSocket(int deviceId)
+{
+	int fd = socket(HCI_AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, HCI_BTPROTO_HCI);
+	if (fd < 0)
+		return -1;
+
+	HciSocketAddress address;
+	memset(&address, 0, sizeof(address));
+	address.family = HCI_AF_BLUETOOTH;
+	address.device = deviceId;
+	address.channel = HCI_CHANNEL_RAW;
+	if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	HciFilter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.typeMask = 1 << HCI_EVENT_PKT;
+	filter.eventMask[0] = (1 << HCI_EVT_CMD_COMPLETE) | (1 << HCI_EVT_CMD_STATUS);
+	if (setsockopt(fd, HCI_SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool HfpHciSocketTransport::sendCommand(int deviceId, uint16_t opcode, const std::vector<uint8_t> &params,
+                                        HciCompletionCallback callback)
+{
+	if (params.size() > 255)
+		return false;
+
+	int fd = openSocket(deviceId);
+	if (fd < 0)
+	{
+		BT_ERROR("MSGID_HCI_SOCKET_FAILED", 0, "Failed to open HCI socket for hci%d: %s", deviceId, strerror(errno));
+		return false;
+	}
+
+	std::vector<uint8_t> packet;
+	packet.reserve(4 + params.size());
+	packet.push_back(HCI_COMMAND_PKT);
+	packet.push_back(opcode & 0xFF);
+	packet.push_back(opcode >> 8);
+	packet.push_back(params.size());
+	packet.insert(packet.end(), params.begin(), params.end());
+
+	if (write(fd, packet.data(), packet.size()) != (ssize_t) packet.size())
+	{
+		BT_ERROR("MSGID_HCI_SEND_FAILED", 0, "Failed to send HCI command 0x%04x to hci%d: %s", opcode, deviceId, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	PendingCommand *command = new PendingCommand;
+	command->transport = this;
+	command->fd = fd;
+	command->opcode = opcode;
+	command->callback = callback;
+
+	GIOChannel *channel = g_io_channel_unix_new(fd);
+	command->ioWatch = g_io_add_watch(channel, (GIOCondition) (G_IO_IN | G_IO_ERR | G_IO_HUP), handleSocketEvent, command);
+	g_io_channel_unref(channel);
+	command->timeout = g_timeout_add(mTimeoutMs, handleTimeout, command);
+
+	mPendingCommands[fd] = command;
+	return true;
+}
+
+void HfpHciSocketTransport::finishCommand(PendingCommand *command, bool success)
+{
+	if (command->ioWatch)
+		g_source_remove(command->ioWatch);
+	if (command->timeout)
+		g_source_remove(command->timeout);
+
+	close(command->fd);
+	mPendingCommands.erase(command->fd);
+
+	HciCompletionCallback callback = command->callback;
+	delete command;
+
+	if (callback)
+		callback(success);
+}
+
+gboolean HfpHciSocketTransport::handleSocketEvent(GIOChannel *channel, GIOCondition condition, gpointer userData)
+{
+	PendingCommand *command = static_cast<PendingCommand*>(userData);
+
+	if (condition & (G_IO_ERR | G_IO_HUP))
+	{
+		command->ioWatch = 0;
+		command->transport->finishCommand(command, false);
+		return FALSE;
+	}
+
+	uint8_t event[260];
+	ssize_t length = read(command->fd, event, sizeof(event));
+	if (length < 0)
+	{
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+
+		command->ioWatch = 0;
+		command->transport->finishCommand(command, false);
+		return FALSE;
+	}
+
+	if (length < 3 || event[0] != HCI_EVENT_PKT)
+		return TRUE;
+
+	uint16_t opcode = 0;
+	uint8_t status = 0;
+	if (event[1] == HCI_EVT_CMD_COMPLETE && length >= 7)
+	{
+		opcode = event[4] | (event[5] << 8);
+		status = event[6];
+	}
+	else if (event[1] == HCI_EVT_CMD_STATUS && length >= 7)
+	{
+		status = event[3];
+		opcode = event[5] | (event[6] << 8);
+	}
+	else
+	{
+		return TRUE;
+	}
+
+	if (opcode != command->opcode)
+		return TRUE;
+
+	command->ioWatch = 0;
+	command->transport->finishCommand(command, status == 0);
+	return FALSE;
+}
+
+gboolean HfpHciSocketTransport::handleTimeout(gpointer userData)
+{
+	PendingCommand *command = static_cast<PendingCommand*>(userData);
+
+	BT_ERROR("MSGID_HCI_COMMAND_TIMEOUT", 0, "HCI command 0x%04x timed out", command->opcode);
+	command->timeout = 0;
+	command->transport->finishCommand(command, false);
+	return FALSE;
+}
+
+HfpHciCommand::HfpHciCommand(HfpHciTransport *transport) :
+	mTransport(transport)
+{
+}
+
+HfpHciCommand::~HfpHciCommand()
+{
+	if (mTransport)
+		delete mTransport;
+}
+
+bool HfpHciCommand::enableScoRouting(const std::string &interfaceName, HciCompletionCallback callback)
+{
+	std::size_t found = interfaceName.find("hci");
+	if (found == std::string::npos)
+		return false;
+
+	std::string index = interfaceName.substr(found + 3);
+	if (index.empty() || index.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+
+	std::vector<uint8_t> params = {0x01, 0x02, 0x00, 0x01, 0x01};
+	return mTransport->sendCommand(std::stoi(index), HCI_OPCODE(HCI_OGF_VENDOR, HCI_OCF_SCO_ROUTING), params, callback);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHCICOMMAND_H_
+#define HFPHCICOMMAND_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+typedef std::function<void(bool success)> HciCompletionCallback;
+
+// Delivers one HCI command to a controller and reports its completion
+class HfpHciTransport
+{
+public:
+	virtual ~HfpHciTransport() {}
+
+	virtual bool sendCommand(int deviceId, uint16_t opcode, const std::vector<uint8_t> &params,
+	                         HciCompletionCallback callback) = 0;
+};
+
+// Raw HCI socket transport, completion is the matching Command Complete or
+// Command Status event read from the main loop
+class HfpHciSocketTransport : public HfpHciTransport
+{
+public:
+	HfpHciSocketTransport(unsigned int timeoutMs = 1000);
+	~HfpHciSocketTransport();
+
+	bool sendCommand(int deviceId, uint16_t opcode, const std::vector<uint8_t> &params,
+	                 HciCompletionCallback callback) override;
+
+private:
+	struct PendingCommand
+	{
+		HfpHciSocketTransport *transport;
+		int fd;
+		uint16_t opcode;
+		guint ioWatch;
+		guint timeout;
+		HciCompletionCallback callback;
+	};
+
+	int openSocket(int deviceId);
+	void finishCommand(PendingCommand *command, bool success);
+	static gboolean handleSocketEvent(GIOChannel *channel, GIOCondition condition, gpointer userData);
+	static gboolean handleTimeout(gpointer userData);
+
+	unsigned int mTimeoutMs;
+	std::unordered_map<int, PendingCommand*> mPendingCommands; //socket to command
+};
+
+// Controller vendor commands, takes ownership of the transport
+class HfpHciCommand
+{
+public:
+	HfpHciCommand(HfpHciTransport *transport);
+	~HfpHciCommand();
+
+	bool enableScoRouting(const std::string &interfaceName, HciCompletionCallback callback);
+
+private:
+	HfpHciTransport *mTransport;
+};
+
+#endif //HFPHCICOMMAND_H_
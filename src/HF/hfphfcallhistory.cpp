@@ -0,0 +1,210 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <algorithm>
+#include <string.h>
+
+#include "hfphfcallhistory.h"
+#include "hfphfcallstatus.h"
+#include "logging.h"
+
+#define CALL_HISTORY_MAGIC 0x43504648 //"HFPC"
+#define CALL_HISTORY_FORMAT 1
+#define CALL_HISTORY_CAPACITY 1024
+
+enum CallDirection
+{
+	DIRECTION_UNKNOWN,
+	DIRECTION_INCOMING,
+	DIRECTION_OUTGOING
+};
+
+static void copyField(char *field, size_t size, const std::string &value)
+{
+	// Fields are always terminated, numbers too long for the record are cut
+	size_t length = std::min(value.size(), size - 1);
+	memcpy(field, value.data(), length);
+	memset(field + length, 0, size - length);
+}
+
+static std::string readField(const char *field, size_t size)
+{
+	return std::string(field, strnlen(field, size));
+}
+
+HfpHFCallHistory::HfpHFCallHistory() :
+	mFile("callhistory.ring", sizeof(Header) + CALL_HISTORY_CAPACITY * sizeof(Record)),
+	mCapacity(CALL_HISTORY_CAPACITY)
+{
+	if (!mFile.isOpen())
+		return;
+
+	const Header *header = getHeader();
+	if (mFile.isCreated() || header->magic != CALL_HISTORY_MAGIC || header->format != CALL_HISTORY_FORMAT ||
+	    header->headerSize != sizeof(Header) || header->recordSize != sizeof(Record) || header->capacity != mCapacity)
+	{
+		reset();
+		return;
+	}
+
+	uint64_t stored = header->nextSequence > mCapacity ? mCapacity : header->nextSequence - 1;
+	BT_DEBUG("Call history has %llu calls in %s", (unsigned long long) stored, mFile.getPath().c_str());
+}
+
+void HfpHFCallHistory::reset()
+{
+	memset(mFile.getData(), 0, mFile.getSize());
+
+	Header *header = getHeader();
+	header->magic = CALL_HISTORY_MAGIC;
+	header->format = CALL_HISTORY_FORMAT;
+	header->headerSize = sizeof(Header);
+	header->recordSize = sizeof(Record);
+	header->capacity = mCapacity;
+	header->nextSequence = 1;
+	mFile.markDirty();
+}
+
+HfpHFCallHistory::Record* HfpHFCallHistory::getRecord(uint64_t sequence) const
+{
+	Record *records = reinterpret_cast<Record*>(mFile.getData() + sizeof(Header));
+	return &records[(sequence - 1) % mCapacity];
+}
+
+void HfpHFCallHistory::append(const std::string &remoteAddr, const std::string &adapterAddr, const std::string &phoneNumber,
+                              const HfpHFCallStatus &callStatus)
+{
+	if (!mFile.isOpen())
+		return;
+
+	Header *header = getHeader();
+	uint64_t sequence = header->nextSequence;
+	Record *record = getRecord(sequence);
+
+	record->sequence = 0;
+	__sync_synchronize();
+
+	std::string direction = callStatus.getCallStatus(CLCC::DeviceStatus::DIRECTION);
+	record->startTime = callStatus.getStartTime() / 1000;
+	record->answerTime = callStatus.getAnswerTime() / 1000;
+	record->endTime = g_get_real_time() / 1000;
+	record->scoMs = (uint32_t) callStatus.getSCOTimeMs();
+	if (direction == "incoming")
+		record->direction = DIRECTION_INCOMING;
+	else if (direction == "outgoing")
+		record->direction = DIRECTION_OUTGOING;
+	else
+		record->direction = DIRECTION_UNKNOWN;
+	memset(record->reserved, 0, sizeof(record->reserved));
+	copyField(record->address, sizeof(record->address), remoteAddr);
+	copyField(record->adapterAddress, sizeof(record->adapterAddress), adapterAddr);
+	copyField(record->number, sizeof(record->number), phoneNumber);
+
+	__sync_synchronize();
+	record->sequence = sequence;
+	header->nextSequence = sequence + 1;
+	mFile.markDirty();
+
+	BT_DEBUG("Call %llu with %s ended after %lld ms, %u ms on SCO", (unsigned long long) sequence, remoteAddr.c_str(),
+	         (long long) (record->endTime - record->startTime), record->scoMs);
+}
+
+pbnjson::JValue HfpHFCallHistory::getCalls(const std::string &remoteAddr, const std::string &adapterAddr, uint64_t before,
+                                           size_t limit, uint64_t &next) const
+{
+	pbnjson::JValue callsObj = pbnjson::Array();
+	next = 0;
+	if (!mFile.isOpen())
+		return callsObj;
+
+	const Header *header = getHeader();
+	uint64_t newest = header->nextSequence - 1;
+	uint64_t oldest = newest > mCapacity ? newest - mCapacity + 1 : 1;
+	uint64_t sequence = (before && before - 1 < newest) ? before - 1 : newest;
+
+	size_t count = 0;
+	for (; sequence >= oldest && sequence > 0; sequence--)
+	{
+		if (count == limit)
+		{
+			next = sequence + 1;
+			break;
+		}
+
+		const Record *record = getRecord(sequence);
+		if (record->sequence != sequence)
+			continue;
+		if (!remoteAddr.empty() && strncmp(record->address, remoteAddr.c_str(), sizeof(record->address)) != 0)
+			continue;
+		if (!adapterAddr.empty() && strncmp(record->adapterAddress, adapterAddr.c_str(), sizeof(record->adapterAddress)) != 0)
+			continue;
+
+		pbnjson::JValue callObj = pbnjson::Object();
+		callObj.put("sequence", (int64_t) record->sequence);
+		callObj.put("number", readField(record->number, sizeof(record->number)));
+		if (record->direction == DIRECTION_INCOMING)
+			callObj.put("direction", "incoming");
+		else if (record->direction == DIRECTION_OUTGOING)
+			callObj.put("direction", "outgoing");
+		callObj.put("address", readField(record->address, sizeof(record->address)));
+		callObj.put("adapterAddress", readField(record->adapterAddress, sizeof(record->adapterAddress)));
+		callObj.put("startTime", (int64_t) record->startTime);
+		if (record->answerTime)
+			callObj.put("answerTime", (int64_t) record->answerTime);
+		callObj.put("endTime", (int64_t) record->endTime);
+		callObj.put("scoMs", (int64_t) record->scoMs);
+		callsObj.append(callObj);
+		count++;
+	}
+
+	return callsObj;
+}
+
+size_t HfpHFCallHistory::purge(const std::string &remoteAddr, const std::string &adapterAddr)
+{
+	if (!mFile.isOpen())
+		return 0;
+
+	const Header *header = getHeader();
+	uint64_t newest = header->nextSequence - 1;
+	uint64_t oldest = newest > mCapacity ? newest - mCapacity + 1 : 1;
+
+	size_t purged = 0;
+	for (uint64_t sequence = oldest; sequence <= newest; sequence++)
+	{
+		Record *record = getRecord(sequence);
+		if (record->sequence != sequence)
+			continue;
+		if (!remoteAddr.empty() && strncmp(record->address, remoteAddr.c_str(), sizeof(record->address)) != 0)
+			continue;
+		if (!adapterAddr.empty() && strncmp(record->adapterAddress, adapterAddr.c_str(), sizeof(record->adapterAddress)) != 0)
+			continue;
+
+		record->sequence = 0;
+		__sync_synchronize();
+		memset(reinterpret_cast<char*>(record) + sizeof(record->sequence), 0, sizeof(Record) - sizeof(record->sequence));
+		purged++;
+	}
+
+	if (purged)
+	{
+		mFile.markDirty();
+		BT_INFO("CALL_HISTORY_PURGED", 0, "Purged %zu calls of %s on %s", purged,
+		        remoteAddr.empty() ? "all AGs" : remoteAddr.c_str(), adapterAddr.empty() ? "all adapters" : adapterAddr.c_str());
+	}
+	return purged;
+}
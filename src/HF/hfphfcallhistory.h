@@ -0,0 +1,90 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef HFPHFCALLHISTORY_H_
+#define HFPHFCALLHISTORY_H_
+
+#include <stdint.h>
+#include <string>
+
+#include <pbnjson.hpp>
+
+#include "mappedfile.h"
+
+class HfpHFCallStatus;
+
+/*
+ * Calls the HF role has seen end, one fixed size record per call in a
+ * ring kept in a mapped file.
+ *
+ * A record is written in place into the slot following the newest one and
+ * is only valid once its sequence number is set, which happens last, so a
+ * crash mid-write leaves a slot that queries skip. Queries walk the ring
+ * from the newest record backwards, reading straight from the mapping, and
+ * page with the sequence number of the last record they returned.
+ *
+ * Purged records get their sequence number cleared and their fields wiped
+ * in place, so the ring keeps its order and queries skip them like slots
+ * that were never written.
+ */
+class HfpHFCallHistory
+{
+public:
+	HfpHFCallHistory();
+
+	bool isOpen() const { return mFile.isOpen(); }
+	void append(const std::string &remoteAddr, const std::string &adapterAddr, const std::string &phoneNumber,
+	            const HfpHFCallStatus &callStatus);
+	pbnjson::JValue getCalls(const std::string &remoteAddr, const std::string &adapterAddr, uint64_t before,
+	                         size_t limit, uint64_t &next) const;
+	size_t purge(const std::string &remoteAddr, const std::string &adapterAddr);
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint16_t format;
+		uint16_t headerSize;
+		uint16_t recordSize;
+		uint16_t reserved;
+		uint32_t capacity;
+		uint64_t nextSequence;
+	};
+
+	struct Record
+	{
+		uint64_t sequence; //0 while the slot is written
+		int64_t startTime; //ms since the epoch
+		int64_t answerTime; //0 if the call never became active
+		int64_t endTime;
+		uint32_t scoMs;
+		uint8_t direction;
+		uint8_t reserved[3];
+		char address[18];
+		char adapterAddress[18];
+		char number[52];
+	};
+
+	Header* getHeader() const { return reinterpret_cast<Header*>(mFile.getData()); }
+	Record* getRecord(uint64_t sequence) const;
+	void reset();
+
+	MappedFile mFile;
+	uint32_t mCapacity;
+};
+
+#endif //HFPHFCALLHISTORY_H_
@@ -19,16 +19,47 @@
 
 #include <vector>
 
+#include <glib.h>
+
 #include "hfphfdefines.h"
 
 class HfpHFCallStatus
 {
 public:
-	HfpHFCallStatus() noexcept { mCallStatus.assign(CLCC::DeviceStatus::MAXSTATUS, ""); }
+	HfpHFCallStatus() noexcept : mStartTime(g_get_real_time()), mAnswerTime(0), mSCOSince(0), mSCOTime(0)
+	{
+		mCallStatus.assign(CLCC::DeviceStatus::MAXSTATUS, "");
+	}
 	~HfpHFCallStatus() noexcept { mCallStatus.clear(); }
-	void setCallStatus(int index, const std::string &value) { mCallStatus[index] = value; }
+	void setCallStatus(int index, const std::string &value)
+	{
+		mCallStatus[index] = value;
+		if (index == CLCC::DeviceStatus::STATUS && value == "active" && !mAnswerTime)
+			mAnswerTime = g_get_real_time();
+	}
 	std::string getCallStatus(int index) const { return mCallStatus[index]; }
+
+	// Time the AG audio was routed to this side while the call existed
+	void setSCOConnected(bool connected)
+	{
+		gint64 now = g_get_monotonic_time();
+		if (connected && !mSCOSince)
+			mSCOSince = now;
+		else if (!connected && mSCOSince)
+		{
+			mSCOTime += now - mSCOSince;
+			mSCOSince = 0;
+		}
+	}
+	gint64 getSCOTimeMs() const { return (mSCOTime + (mSCOSince ? g_get_monotonic_time() - mSCOSince : 0)) / 1000; }
+	gint64 getStartTime() const { return mStartTime; }
+	gint64 getAnswerTime() const { return mAnswerTime; }
+
 private:
 	std::vector<std::string> mCallStatus;
+	gint64 mStartTime; //wall clock, us
+	gint64 mAnswerTime;
+	gint64 mSCOSince; //monotonic, us
+	gint64 mSCOTime;
 };
 #endif //HFPHFCALLSTATUS_H_
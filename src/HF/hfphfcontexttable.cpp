@@ -0,0 +1,136 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "hfphfcontexttable.h"
+
+HfpHFContextTable::HfpHFContextTable(HfpHFRole *role) :
+	mRole(role)
+{
+	mSlots.reserve(HFLS2::APIName::MAXVALUE);
+}
+
+HfpHFContextTable::~HfpHFContextTable()
+{
+}
+
+std::string HfpHFContextTable::makeKey(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr)
+{
+	return std::to_string(apiName) + "/" + adapterAddr + "/" + remoteAddr;
+}
+
+HfpHFContextTable::Handle HfpHFContextTable::add(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr)
+{
+	std::string key = makeKey(apiName, adapterAddr, remoteAddr);
+	if (mKeyIndex.find(key) != mKeyIndex.end())
+		return INVALIDHANDLE;
+
+	uint32_t index;
+	if (!mFreeSlots.empty())
+	{
+		index = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		if (mSlots.size() >= 0xFFFF)
+			return INVALIDHANDLE;
+		index = mSlots.size();
+		mSlots.push_back({0, false, {apiName, "", "", LSMESSAGE_TOKEN_INVALID}});
+	}
+
+	Slot &slot = mSlots[index];
+	slot.used = true;
+	slot.context = {apiName, adapterAddr, remoteAddr, LSMESSAGE_TOKEN_INVALID};
+
+	Handle handle = makeHandle(index, slot.generation);
+	mKeyIndex[key] = handle;
+	return handle;
+}
+
+void HfpHFContextTable::remove(Handle handle)
+{
+	Context *context = get(handle);
+	if (context == nullptr)
+		return;
+
+	mKeyIndex.erase(makeKey(context->apiName, context->adapterAddress, context->remoteAddress));
+	if (context->token != LSMESSAGE_TOKEN_INVALID)
+		mTokenIndex.erase(context->token);
+
+	uint32_t index = getIndex(handle);
+	mSlots[index].used = false;
+	mSlots[index].generation++;
+	mFreeSlots.push_back(index);
+}
+
+HfpHFContextTable::Context* HfpHFContextTable::get(Handle handle)
+{
+	if (handle == INVALIDHANDLE)
+		return nullptr;
+
+	uint32_t index = getIndex(handle);
+	if (index >= mSlots.size())
+		return nullptr;
+
+	Slot &slot = mSlots[index];
+	if (!slot.used || slot.generation != getGeneration(handle))
+		return nullptr;
+
+	return &slot.context;
+}
+
+HfpHFContextTable::Handle HfpHFContextTable::find(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr) const
+{
+	auto iter = mKeyIndex.find(makeKey(apiName, adapterAddr, remoteAddr));
+	if (iter == mKeyIndex.end())
+		return INVALIDHANDLE;
+
+	return iter->second;
+}
+
+void HfpHFContextTable::setToken(Handle handle, LSMessageToken token)
+{
+	Context *context = get(handle);
+	if (context == nullptr)
+		return;
+
+	if (context->token != LSMESSAGE_TOKEN_INVALID)
+		mTokenIndex.erase(context->token);
+
+	context->token = token;
+	if (token != LSMESSAGE_TOKEN_INVALID)
+		mTokenIndex[token] = handle;
+}
+
+HfpHFContextTable::Context* HfpHFContextTable::resolve(LSMessage *reply)
+{
+	auto iter = mTokenIndex.find(LSMessageGetResponseToken(reply));
+	if (iter == mTokenIndex.end())
+		return nullptr;
+
+	return get(iter->second);
+}
+
+std::vector<HfpHFContextTable::Handle> HfpHFContextTable::getHandles() const
+{
+	std::vector<Handle> handles;
+	for (uint32_t index = 0; index < mSlots.size(); index++)
+	{
+		if (mSlots[index].used)
+			handles.push_back(makeHandle(index, mSlots[index].generation));
+	}
+	return handles;
+}
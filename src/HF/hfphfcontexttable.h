@@ -0,0 +1,86 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHFCONTEXTTABLE_H_
+#define HFPHFCONTEXTTABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <luna-service2/lunaservice.h>
+
+#include "hfphfdefines.h"
+
+class HfpHFRole;
+
+/*
+ * Luna subscription contexts of the HF role.
+ *
+ * A context is referred to by a handle made of its slot and the slot's
+ * generation, which is bumped every time the slot is released. LSCall gets
+ * the table itself as user data and replies are mapped back through their
+ * response token, so a reply for a cancelled or replaced call simply does
+ * not resolve instead of touching freed memory.
+ */
+class HfpHFContextTable
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle INVALIDHANDLE = 0;
+
+	struct Context
+	{
+		HFLS2::APIName apiName;
+		std::string adapterAddress;
+		std::string remoteAddress;
+		LSMessageToken token;
+	};
+
+	HfpHFContextTable(HfpHFRole *role);
+	~HfpHFContextTable();
+
+	Handle add(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr);
+	void remove(Handle handle);
+	Context* get(Handle handle);
+	Handle find(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr) const;
+	void setToken(Handle handle, LSMessageToken token);
+	Context* resolve(LSMessage *reply);
+	std::vector<Handle> getHandles() const;
+	HfpHFRole* getRole() const { return mRole; }
+
+private:
+	struct Slot
+	{
+		uint16_t generation;
+		bool used;
+		Context context;
+	};
+
+	static std::string makeKey(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr);
+	static Handle makeHandle(uint32_t index, uint16_t generation) { return ((Handle) generation << 16) | (index + 1); }
+	static uint32_t getIndex(Handle handle) { return (handle & 0xFFFF) - 1; }
+	static uint16_t getGeneration(Handle handle) { return handle >> 16; }
+
+	HfpHFRole *mRole;
+	std::vector<Slot> mSlots;
+	std::vector<uint32_t> mFreeSlots;
+	std::unordered_map<std::string, Handle> mKeyIndex;
+	std::unordered_map<LSMessageToken, Handle> mTokenIndex;
+};
+
+#endif //HFPHFCONTEXTTABLE_H_
@@ -33,7 +33,6 @@ namespace HFLS2
 	const std::string LUNASENDAT = "hfp/sendAT";
 	const std::string LUNASETVOLUME="phone/setVolume";
 	const std::string LUNASETINPUTVOLUME = "setInputVolume";
-	const int INVALIDINDEX = -1;
 
 	enum APIName
 	{
@@ -43,23 +42,6 @@ namespace HFLS2
 		ADAPTERGETSTATUS,
 		MAXVALUE
 	};
-
-	enum ContextData
-	{
-		APINAME,
-		ADDRESS,
-		OBJECT,
-		TOKEN
-	};
-
-	enum ScoContextData
-	{
-		SCOAPINAME,
-		REMOTEADDRESS,
-		ADAPTERADDRESS,
-		SCOOBJECT,
-		SCOTOKEN
-	};
 }
 
 namespace HFGeneral
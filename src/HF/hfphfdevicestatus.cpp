@@ -23,6 +23,7 @@
 #include "hfphfdevicestatus.h"
 #include "hfphfrole.h"
 #include "hfpdeviceinfo.h"
+#include "statejournal.h"
 
 HfpHFDeviceStatus::HfpHFDeviceStatus(HfpHFRole* roleObj) :
 	mHFRole(roleObj),
@@ -98,7 +99,12 @@ void HfpHFDeviceStatus::updateStatus(const std::string &remoteAddr, std::string
 	else
 	{
 		if (resultCode.compare("RING") == 0)
+		{
+			// RING is posted right away rather than on the next idle
 			updateRingStatus(remoteAddr, true);
+			mHFRole->notifySubscribersStatusChanged(true);
+			mHFRole->flushStatusChanges();
+		}
 		else if (resultCode.find("OK") == 0)
 		{
 			int receivedATCmd = -1;
@@ -115,6 +121,7 @@ void HfpHFDeviceStatus::updateStatus(const std::string &remoteAddr, std::string
 					eraseCallStatus(remoteAddr);
 				mHFRole->notifySubscribersStatusChanged(true);
 				mHasCallStatus = 0;
+				mHFRole->sendResponseToClient(remoteAddr, true);
 				break;
 			case receiveATCMD::ATCMD::VGS:
 				mHFRole->notifySubscribersStatusChanged(true);
@@ -355,7 +362,12 @@ bool HfpHFDeviceStatus::createDeviceInfo(const std::string &remoteAddr , const s
 		mHfpDeviceInfo.insert(std::make_pair(adapterAddr,temp));
 	}
 
+	deviceInfo->setAddress(remoteAddr, adapterAddr);
+	StateJournal::getInstance().record(JOURNAL::DEVICE_CREATED, adapterAddr, remoteAddr);
 	deviceInfo->setAudioStatus(SCO::DeviceStatus::VOLUME, 9);
+	deviceInfo->setCallEndedFunc([this, remoteAddr, adapterAddr](const std::string &phoneNumber, const HfpHFCallStatus &callStatus) {
+		mHFRole->recordCallHistory(remoteAddr, adapterAddr, phoneNumber, callStatus);
+	});
 	BT_DEBUG("Create the %s's DeviceInfo", remoteAddr.c_str());
 
 	/*if (isCallActive(remoteAddr))
@@ -375,7 +387,10 @@ bool HfpHFDeviceStatus::removeDeviceInfo(const std::string &remoteAddr , const s
 		if(device != adapterItr->second.end())
 		{
 			BT_DEBUG("Remove adapter %s's device %s", adapterAddr.c_str(), remoteAddr.c_str());
+			// Calls still up when the AG goes away end with it
+			device->second->clearCLCC();
 			delete device->second;
+			StateJournal::getInstance().record(JOURNAL::DEVICE_REMOVED, adapterAddr, remoteAddr);
 			adapterItr->second.erase(device);
 			if(adapterItr->second.size() == 0)
 			{
@@ -397,7 +412,11 @@ bool HfpHFDeviceStatus::removeAllDevicebyAdapterAddress(const std::string &adapt
 		for (auto devitr : adapterItr->second)
 		{
 			if(devitr.second)
+			{
+				devitr.second->clearCLCC();
 				delete devitr.second;
+				StateJournal::getInstance().record(JOURNAL::DEVICE_REMOVED, adapterAddr, devitr.first);
+			}
 		}
 		mHfpDeviceInfo.erase(adapterAddr);
 		return true;
@@ -0,0 +1,238 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "hfphfpendingrequests.h"
+#include "ls2utils.h"
+#include "logging.h"
+
+#define WHEEL_TICK_MS     250
+#define WHEEL_SLOT_COUNT  32
+
+HfpHFPendingRequests::HfpHFPendingRequests(unsigned int timeoutMs) :
+	mTimeoutMs(timeoutMs),
+	mNextId(0),
+	mPendingCount(0),
+	mWheel(WHEEL_SLOT_COUNT),
+	mCursor(0),
+	mTickSource(0),
+	mStatistics({0, 0, 0, 0, 0, 0})
+{
+}
+
+HfpHFPendingRequests::~HfpHFPendingRequests()
+{
+	stopTicking();
+}
+
+void HfpHFPendingRequests::enqueue(const std::string &remoteAddr, const std::string &command)
+{
+	push(remoteAddr, {++mNextId, command, false, LS::Message(), nullptr, g_get_monotonic_time()});
+}
+
+void HfpHFPendingRequests::enqueue(const std::string &remoteAddr, const std::string &command, LS::Message &request,
+                                   CompletionFunc done)
+{
+	push(remoteAddr, {++mNextId, command, true, request, done, g_get_monotonic_time()});
+}
+
+void HfpHFPendingRequests::push(const std::string &remoteAddr, PendingRequest &&pending)
+{
+	auto &queue = mQueues[remoteAddr];
+	uint64_t id = pending.id;
+	BT_DEBUG("Pending AT+%s %llu for %s, depth %zu", pending.command.c_str(), (unsigned long long) id,
+	         remoteAddr.c_str(), queue.size() + 1);
+	queue.push_back(std::move(pending));
+	mPendingCount++;
+
+	if (queue.size() > mStatistics.maxDepth)
+		mStatistics.maxDepth = queue.size();
+
+	schedule(id, remoteAddr);
+	startTicking();
+}
+
+bool HfpHFPendingRequests::complete(const std::string &remoteAddr, bool returnValue)
+{
+	auto queueIter = mQueues.find(remoteAddr);
+	if (queueIter == mQueues.end() || queueIter->second.empty())
+		return false;
+
+	auto iter = queueIter->second.begin();
+	gint64 waitMs = getWaitMs(*iter);
+	mStatistics.completed++;
+	mStatistics.totalWaitMs += waitMs;
+	if (waitMs > mStatistics.maxWaitMs)
+		mStatistics.maxWaitMs = waitMs;
+	BT_DEBUG("Completed AT+%s for %s after %lld ms, depth %zu", iter->command.c_str(), remoteAddr.c_str(),
+	         (long long) waitMs, queueIter->second.size() - 1);
+
+	PendingRequest pending = std::move(*iter);
+	release(remoteAddr, iter);
+
+	if (pending.hasRequest)
+	{
+		pbnjson::JValue responseObj = pbnjson::Object();
+		responseObj.put("returnValue", returnValue);
+		LSUtils::postToClient(pending.request, responseObj);
+	}
+	if (pending.done)
+		pending.done(returnValue);
+	return true;
+}
+
+void HfpHFPendingRequests::cancel(const std::string &remoteAddr, BluetoothErrorCode errorCode)
+{
+	auto queueIter = mQueues.find(remoteAddr);
+	if (queueIter == mQueues.end())
+		return;
+
+	std::deque<PendingRequest> queue;
+	queue.swap(queueIter->second);
+	mQueues.erase(queueIter);
+	mPendingCount -= queue.size();
+	mStatistics.cancelled += queue.size();
+	if (mPendingCount == 0)
+		stopTicking();
+
+	// Stale wheel entries of the cancelled requests are dropped on expiry
+	for (auto &pending : queue)
+	{
+		if (pending.hasRequest)
+			LSUtils::respondWithError(pending.request, errorCode);
+		if (pending.done)
+			pending.done(false);
+	}
+}
+
+void HfpHFPendingRequests::cancelAll(BluetoothErrorCode errorCode)
+{
+	while (!mQueues.empty())
+		cancel(mQueues.begin()->first, errorCode);
+}
+
+pbnjson::JValue HfpHFPendingRequests::getStatus() const
+{
+	pbnjson::JValue statusObj = pbnjson::Object();
+	statusObj.put("pending", (int64_t) mPendingCount);
+	statusObj.put("completed", (int64_t) mStatistics.completed);
+	statusObj.put("timedOut", (int64_t) mStatistics.timedOut);
+	statusObj.put("cancelled", (int64_t) mStatistics.cancelled);
+	statusObj.put("maxDepth", (int64_t) mStatistics.maxDepth);
+	statusObj.put("maxWaitMs", (int64_t) mStatistics.maxWaitMs);
+	if (mStatistics.completed)
+		statusObj.put("averageWaitMs", (int64_t) (mStatistics.totalWaitMs / mStatistics.completed));
+
+	return statusObj;
+}
+
+void HfpHFPendingRequests::schedule(uint64_t id, const std::string &remoteAddr)
+{
+	unsigned int ticks = (mTimeoutMs + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+	if (ticks == 0)
+		ticks = 1;
+
+	unsigned int slot = (mCursor + ticks) % WHEEL_SLOT_COUNT;
+	mWheel[slot].push_back({id, remoteAddr, (ticks - 1) / WHEEL_SLOT_COUNT});
+}
+
+void HfpHFPendingRequests::expire(const WheelEntry &entry)
+{
+	auto queueIter = mQueues.find(entry.remoteAddr);
+	if (queueIter == mQueues.end())
+		return;
+
+	auto &queue = queueIter->second;
+	for (auto iter = queue.begin(); iter != queue.end(); ++iter)
+	{
+		if (iter->id != entry.id)
+			continue;
+
+		gint64 waitMs = getWaitMs(*iter);
+		mStatistics.timedOut++;
+		BT_ERROR("MSGID_AT_RESPONSE_TIMEOUT", 0, "No response to AT+%s from %s after %lld ms, depth %zu",
+		         iter->command.c_str(), entry.remoteAddr.c_str(), (long long) waitMs, queue.size() - 1);
+
+		PendingRequest pending = std::move(*iter);
+		release(entry.remoteAddr, iter);
+		if (pending.hasRequest)
+			LSUtils::respondWithError(pending.request, BT_ERR_AT_RESPONSE_TIMEOUT);
+		if (pending.done)
+			pending.done(false);
+		return;
+	}
+}
+
+void HfpHFPendingRequests::release(const std::string &remoteAddr, std::deque<PendingRequest>::iterator iter)
+{
+	auto queueIter = mQueues.find(remoteAddr);
+	queueIter->second.erase(iter);
+	if (queueIter->second.empty())
+		mQueues.erase(queueIter);
+
+	mPendingCount--;
+	if (mPendingCount == 0)
+		stopTicking();
+}
+
+gint64 HfpHFPendingRequests::getWaitMs(const PendingRequest &pending) const
+{
+	return (g_get_monotonic_time() - pending.enqueuedAt) / 1000;
+}
+
+void HfpHFPendingRequests::startTicking()
+{
+	if (mTickSource == 0)
+		mTickSource = g_timeout_add(WHEEL_TICK_MS, handleTick, this);
+}
+
+void HfpHFPendingRequests::stopTicking()
+{
+	if (mTickSource)
+	{
+		g_source_remove(mTickSource);
+		mTickSource = 0;
+	}
+
+	// Nothing is pending, so whatever is left on the wheel is stale
+	for (auto &slot : mWheel)
+		slot.clear();
+}
+
+gboolean HfpHFPendingRequests::handleTick(gpointer userData)
+{
+	HfpHFPendingRequests *pendingRequests = static_cast<HfpHFPendingRequests*>(userData);
+
+	pendingRequests->mCursor = (pendingRequests->mCursor + 1) % WHEEL_SLOT_COUNT;
+	std::vector<WheelEntry> due;
+	auto &slot = pendingRequests->mWheel[pendingRequests->mCursor];
+	for (auto iter = slot.begin(); iter != slot.end();)
+	{
+		if (iter->rounds > 0)
+		{
+			iter->rounds--;
+			++iter;
+			continue;
+		}
+		due.push_back(*iter);
+		iter = slot.erase(iter);
+	}
+
+	for (auto &entry : due)
+		pendingRequests->expire(entry);
+
+	// expire() may have stopped the wheel when the last request went away
+	return pendingRequests->mTickSource != 0;
+}
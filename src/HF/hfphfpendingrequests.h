@@ -0,0 +1,104 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHFPENDINGREQUESTS_H_
+#define HFPHFPENDINGREQUESTS_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.hpp>
+
+#include "bluetootherrors.h"
+
+/*
+ * AT commands waiting for their result code from an AG.
+ *
+ * The AG answers AT commands in order, so every command sent to it is kept
+ * in a FIFO per remote address, with or without an LS2 request behind it,
+ * and the next OK/ERROR completes the oldest one. Deadlines are driven by a
+ * timing wheel on the main loop which only ticks while at least one command
+ * is pending.
+ */
+class HfpHFPendingRequests
+{
+public:
+	typedef std::function<void(bool success)> CompletionFunc;
+
+	struct Statistics
+	{
+		unsigned long completed;
+		unsigned long timedOut;
+		unsigned long cancelled;
+		size_t maxDepth;
+		gint64 totalWaitMs;
+		gint64 maxWaitMs;
+	};
+
+	HfpHFPendingRequests(unsigned int timeoutMs = 5000);
+	~HfpHFPendingRequests();
+
+	void enqueue(const std::string &remoteAddr, const std::string &command);
+	void enqueue(const std::string &remoteAddr, const std::string &command, LS::Message &request, CompletionFunc done);
+	bool complete(const std::string &remoteAddr, bool returnValue);
+	void cancel(const std::string &remoteAddr, BluetoothErrorCode errorCode);
+	void cancelAll(BluetoothErrorCode errorCode);
+	pbnjson::JValue getStatus() const;
+
+private:
+	struct PendingRequest
+	{
+		uint64_t id;
+		std::string command;
+		bool hasRequest;
+		LS::Message request;
+		CompletionFunc done;
+		gint64 enqueuedAt;
+	};
+
+	struct WheelEntry
+	{
+		uint64_t id;
+		std::string remoteAddr;
+		unsigned int rounds;
+	};
+
+	void schedule(uint64_t id, const std::string &remoteAddr);
+	void expire(const WheelEntry &entry);
+	void push(const std::string &remoteAddr, PendingRequest &&pending);
+	void release(const std::string &remoteAddr, std::deque<PendingRequest>::iterator iter);
+	gint64 getWaitMs(const PendingRequest &pending) const;
+	void startTicking();
+	void stopTicking();
+	static gboolean handleTick(gpointer userData);
+
+	unsigned int mTimeoutMs;
+	uint64_t mNextId;
+	size_t mPendingCount;
+	std::unordered_map<std::string, std::deque<PendingRequest>> mQueues; //remote address to requests
+	std::vector<std::vector<WheelEntry>> mWheel;
+	unsigned int mCursor;
+	guint mTickSource;
+	Statistics mStatistics;
+};
+
+#endif //HFPHFPENDINGREQUESTS_H_
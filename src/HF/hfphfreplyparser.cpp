@@ -0,0 +1,110 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ls2utils.h"
+#include "hfphfreplyparser.h"
+
+HfpHFReplyParser::HfpHFReplyParser()
+{
+	mReceiveResultParser.bindString("address", [this](const std::string &value) {
+		mReceiveResult.address = value;
+	});
+	mReceiveResultParser.bindString("resultCode", [this](const std::string &value) {
+		mReceiveResult.resultCode = value;
+	});
+
+	mDeviceStatusParser.bindArray("devices", [this]() {
+		mDeviceStatus.hasDevices = true;
+	});
+	mDeviceStatusParser.bindObject("devices[]", [this]() {
+		mDeviceStatus.devices.push_back({"", false, false, false, true});
+	});
+	mDeviceStatusParser.bindString("devices[].address", [this](const std::string &value) {
+		mDeviceStatus.devices.back().address = value;
+		mDeviceStatus.devices.back().hasAddress = true;
+	});
+	mDeviceStatusParser.bindBoolean("devices[].paired", [this](bool value) {
+		mDeviceStatus.devices.back().paired = value;
+	});
+	mDeviceStatusParser.bindArray("devices[].connectedRoles", [this]() {
+		mDeviceStatus.devices.back().hasConnectedRoles = true;
+	});
+	mDeviceStatusParser.bindString("devices[].connectedRoles[]", [this](const std::string &value) {
+		if (value == "HFP_AG")
+			mDeviceStatus.devices.back().hfpAGConnected = true;
+	});
+
+	mSCOStatusParser.bindBoolean("returnValue", [this](bool value) {
+		mSCOStatus.returnValue = value;
+	});
+	mSCOStatusParser.bindBoolean("sco", [this](bool value) {
+		mSCOStatus.sco = value;
+	});
+	mSCOStatusParser.bindString("address", [this](const std::string &value) {
+		mSCOStatus.address = value;
+	});
+}
+
+HfpHFReplyParser::~HfpHFReplyParser()
+{
+}
+
+bool HfpHFReplyParser::parse(LS::Message &reply, JsonSaxParser &parser)
+{
+	if (!parser.parse(reply.getPayload()))
+	{
+		LSUtils::respondWithError(reply, BT_ERR_BAD_JSON);
+		return false;
+	}
+	return true;
+}
+
+bool HfpHFReplyParser::parseReceiveResult(LS::Message &reply, HFReply::ReceiveResult &result)
+{
+	mReceiveResult.address.clear();
+	mReceiveResult.resultCode.clear();
+
+	if (!parse(reply, mReceiveResultParser))
+		return false;
+
+	result = std::move(mReceiveResult);
+	return true;
+}
+
+bool HfpHFReplyParser::parseDeviceStatus(LS::Message &reply, HFReply::DeviceStatus &result)
+{
+	mDeviceStatus.hasDevices = false;
+	mDeviceStatus.devices.clear();
+
+	if (!parse(reply, mDeviceStatusParser))
+		return false;
+
+	result = std::move(mDeviceStatus);
+	return true;
+}
+
+bool HfpHFReplyParser::parseSCOStatus(LS::Message &reply, HFReply::SCOStatus &result)
+{
+	mSCOStatus.returnValue = true;
+	mSCOStatus.sco = false;
+	mSCOStatus.address.clear();
+
+	if (!parse(reply, mSCOStatusParser))
+		return false;
+
+	result = std::move(mSCOStatus);
+	return true;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHFREPLYPARSER_H_
+#define HFPHFREPLYPARSER_H_
+
+#include <string>
+#include <vector>
+
+#include <luna-service2/lunaservice.hpp>
+
+#include "jsonsaxparser.h"
+
+namespace HFReply
+{
+	// hfp/receiveResult
+	struct ReceiveResult
+	{
+		std::string address;
+		std::string resultCode;
+	};
+
+	// One entry of device/getStatus "devices"
+	struct Device
+	{
+		std::string address;
+		bool hasAddress;
+		bool hasConnectedRoles;
+		bool hfpAGConnected;
+		bool paired;
+	};
+
+	// device/getStatus
+	struct DeviceStatus
+	{
+		bool hasDevices;
+		std::vector<Device> devices;
+	};
+
+	// hfp/getStatus
+	struct SCOStatus
+	{
+		bool returnValue;
+		bool sco;
+		std::string address;
+	};
+}
+
+class HfpHFReplyParser
+{
+public:
+	HfpHFReplyParser();
+	~HfpHFReplyParser();
+
+	bool parseReceiveResult(LS::Message &reply, HFReply::ReceiveResult &result);
+	bool parseDeviceStatus(LS::Message &reply, HFReply::DeviceStatus &result);
+	bool parseSCOStatus(LS::Message &reply, HFReply::SCOStatus &result);
+
+private:
+	bool parse(LS::Message &reply, JsonSaxParser &parser);
+
+	JsonSaxParser mReceiveResultParser;
+	JsonSaxParser mDeviceStatusParser;
+	JsonSaxParser mSCOStatusParser;
+	HFReply::ReceiveResult mReceiveResult;
+	HFReply::DeviceStatus mDeviceStatus;
+	HFReply::SCOStatus mSCOStatus;
+};
+
+#endif //HFPHFREPLYPARSER_H_
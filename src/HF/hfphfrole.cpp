@@ -18,10 +18,15 @@
 #include "logging.h"
 #include "utils.h"
 #include "ls2utils.h"
+#include "loopmonitor.h"
+#include "startuptrace.h"
 #include "hfphfrole.h"
 #include "hfpdeviceinfo.h"
 #include "hfphfdevicestatus.h"
 #include "hfphfsubscribe.h"
+#include "hfphfreplyparser.h"
+#include "hfphcicommand.h"
+#include "hfphfcontexttable.h"
 #include "hfpofonomanager.h"
 #include "hfpofonomodem.h"
 #include "hfpofonovoicecall.h"
@@ -32,22 +37,43 @@
 
 HfpHFRole::HfpHFRole(BluetoothHfpService *service) :
         HfpRole(service),
-        mGetStatusSubscription(nullptr),
 	mHFLS2Call(nullptr),
 	mHFDevice(nullptr),
-	mNameWatch(G_BUS_TYPE_SYSTEM, "org.ofono")
+	mHFReplyParser(nullptr),
+	mHciCommand(nullptr),
+	mContextTable(nullptr),
+	mScoRetrySource(0),
+	mScoRetrySec(1),
+	mDeviceStatusSource(0),
+	mHfpOfonoManager(nullptr),
+	mOfonoAvailable(false),
+	mNameWatch(G_BUS_TYPE_SYSTEM, "org.ofono"),
+	mSkippedDeviceEntries(0),
+	mProcessedDeviceEntries(0),
+	mStatusVersion(0),
+	mStatusDirtySince(0),
+	mStatusFlushSource(0),
+	mStatusBackstopSource(0),
+	mStatusPruneSource(0),
+	mStatusStale(false),
+	mStaleTimeoutSource(0)
+#ifdef MULTI_SESSION_SUPPORT
+	, mSessionResolver(nullptr)
+#endif
 {
 	LS_CREATE_CATEGORY_BEGIN(HfpHFRole, adapter)
-		LS_CATEGORY_METHOD(answerCall)
-		LS_CATEGORY_METHOD(terminateCall)
-		LS_CATEGORY_METHOD(getStatus)
-		LS_CATEGORY_METHOD(releaseHeldCalls)
-		LS_CATEGORY_METHOD(releaseActiveCalls)
-		LS_CATEGORY_METHOD(holdActiveCalls)
-		LS_CATEGORY_METHOD(mergeCall)
-		LS_CATEGORY_METHOD(setVolume)
-		LS_CATEGORY_METHOD(call)
-		LS_CATEGORY_METHOD(setVoiceRecognition)
+		LS_CATEGORY_MONITORED_METHOD(answerCall)
+		LS_CATEGORY_MONITORED_METHOD(terminateCall)
+		LS_CATEGORY_MONITORED_METHOD(getStatus)
+		LS_CATEGORY_MONITORED_METHOD(releaseHeldCalls)
+		LS_CATEGORY_MONITORED_METHOD(releaseActiveCalls)
+		LS_CATEGORY_MONITORED_METHOD(holdActiveCalls)
+		LS_CATEGORY_MONITORED_METHOD(mergeCall)
+		LS_CATEGORY_MONITORED_METHOD(setVolume)
+		LS_CATEGORY_MONITORED_METHOD(call)
+		LS_CATEGORY_MONITORED_METHOD(setVoiceRecognition)
+		LS_CATEGORY_MONITORED_METHOD(getCallHistory)
+		LS_CATEGORY_MONITORED_METHOD(deleteCallHistory)
 	LS_CREATE_CATEGORY_END
 
 	getService()->registerCategory("/hf", LS_CATEGORY_TABLE_NAME(adapter), nullptr, nullptr);
@@ -58,18 +84,35 @@ HfpHFRole::HfpHFRole(BluetoothHfpService *service) :
 
 HfpHFRole::~HfpHFRole()
 {
+	destroyOfonoManager();
+	if (mStatusFlushSource)
+		g_source_remove(mStatusFlushSource);
+	if (mStatusBackstopSource)
+		g_source_remove(mStatusBackstopSource);
+	if (mStatusPruneSource)
+		g_source_remove(mStatusPruneSource);
+	if (mStaleTimeoutSource)
+		g_source_remove(mStaleTimeoutSource);
+	if (mScoRetrySource)
+		g_source_remove(mScoRetrySource);
+	if (mDeviceStatusSource)
+		g_source_remove(mDeviceStatusSource);
 	if (mHFDevice != nullptr)
 		delete mHFDevice;
-	if (mGetStatusSubscription != nullptr)
-		delete mGetStatusSubscription;
+	for (auto &subscription : mGetStatusSubscriptions)
+		delete subscription.second.subscribers;
 	if (mHFLS2Call != nullptr)
 		delete mHFLS2Call;
-	for (auto& iterContext : mContextList)
-	{
-		if (iterContext != nullptr)
-			delete iterContext;
-	}
-	mContextList.clear();
+	if (mHFReplyParser != nullptr)
+		delete mHFReplyParser;
+	if (mHciCommand != nullptr)
+		delete mHciCommand;
+	if (mContextTable != nullptr)
+		delete mContextTable;
+#ifdef MULTI_SESSION_SUPPORT
+	if (mSessionResolver != nullptr)
+		delete mSessionResolver;
+#endif
 }
 
 void HfpHFRole::initialize()
@@ -77,11 +120,15 @@ void HfpHFRole::initialize()
 	mHFDevice = new HfpHFDeviceStatus(this);
 	mHFLS2Call = new HfpHFLS2Call();
 	mHFSubscribe = new HfpHFSubscribe();
+	mHFReplyParser = new HfpHFReplyParser();
+	mHciCommand = new HfpHciCommand(new HfpHciSocketTransport());
 
-	mContextList.reserve(HFLS2::APIName::MAXVALUE);
-	mContextList = {new LSContext(HFLS2::APIName::ADAPTERGETSTATUS, "", this, LSMESSAGE_TOKEN_INVALID),
-                        new LSContext(HFLS2::APIName::RECEIVERESULT, "", this, LSMESSAGE_TOKEN_INVALID)};
-	mScoContextList.reserve(HFLS2::APIName::MAXVALUE);
+	mContextTable = new HfpHFContextTable(this);
+	loadStoredStatus();
+#ifdef MULTI_SESSION_SUPPORT
+	mSessionResolver = new SessionResolver(getService());
+	mSessionResolver->prefetch();
+#endif
 
 	LSError lserror;
 	LSErrorInit(&lserror);
@@ -90,16 +137,27 @@ void HfpHFRole::initialize()
 		BT_DEBUG("LS2 subscription is failed");
 	}
 
+	// A restart of oFono keeps the manager, and with it the state clients
+	// were told about, until the new instance has been reconciled with it.
+	// Modems are only enumerated once an AG is connected.
 	mNameWatch.watch([this](bool available) {
-		if (available)
+		mOfonoAvailable = available;
+		if (available && (mHfpOfonoManager || !mHFDevice->getDeviceInfoList().empty()))
 			createOfonoManager();
-		else
-			destroyOfonoManager();
+		else if (!available && mHfpOfonoManager)
+			mHfpOfonoManager->markStale();
 	});
 }
 
 void HfpHFRole::createOfonoManager()
 {
+	if (mHfpOfonoManager)
+	{
+		mHfpOfonoManager->reattach();
+		return;
+	}
+
+	StartupTrace::getInstance().mark("ofonoManager");
 	mHfpOfonoManager = new HfpOfonoManager("/", this);
 }
 
@@ -107,198 +165,231 @@ void HfpHFRole::destroyOfonoManager()
 {
 	if (mHfpOfonoManager)
 		delete mHfpOfonoManager;
+	mHfpOfonoManager = nullptr;
 }
 
-void HfpHFRole::unsubscribeService(HFLS2::APIName apiName)
+bool HfpHFRole::callService(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &lunaCmd,
+                            const std::string &payload, LSFilterFunc callback)
 {
-	int index = findContextIndex(apiName);
-	if (index == HFLS2::INVALIDINDEX || std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]) == LSMESSAGE_TOKEN_INVALID)
-	{
-		BT_DEBUG("LSCallCancel failed, token is invalid");
-		return;
-	}
-	unsubscribeService(index);
+	return callService(apiName, adapterAddr, "", lunaCmd, payload, callback);
 }
 
-void HfpHFRole::unsubscribeService(const std::string &remoteAddr)
+bool HfpHFRole::callService(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr,
+                            const std::string &lunaCmd, const std::string &payload, LSFilterFunc callback)
 {
-	int index = findContextIndex(remoteAddr);
-	if (index == HFLS2::INVALIDINDEX || std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]) == LSMESSAGE_TOKEN_INVALID)
+	unsubscribeService(mContextTable->find(apiName, adapterAddr, remoteAddr));
+
+	HfpHFContextTable::Handle handle = mContextTable->add(apiName, adapterAddr, remoteAddr);
+	if (handle == HfpHFContextTable::INVALIDHANDLE)
 	{
-		BT_DEBUG("LSCallCancel failed, index is invalid");
-		return;
+		BT_DEBUG("LS2 subscription is failed as context is invalid");
+		return false;
 	}
-	unsubscribeService(index);
-}
 
-void HfpHFRole::unsubscribeScoService(const std::string &remoteAddr, const std::string &adapterAddr)
-{
-	int index = findScoContextIndex(remoteAddr,adapterAddr);
-	if (index == HFLS2::INVALIDINDEX || std::get<HFLS2::ScoContextData::SCOTOKEN>(*mScoContextList[index]) == LSMESSAGE_TOKEN_INVALID)
+	LSMessageToken token = LSMESSAGE_TOKEN_INVALID;
+	LSError lserror;
+	LSErrorInit(&lserror);
+	if (!LSCall(this->mLSHandle, lunaCmd.c_str(), payload.c_str(), callback, mContextTable, &token, &lserror))
 	{
-		BT_DEBUG("LSCallCancel failed, index is invalid");
-		return;
+		BT_DEBUG("LS2 subscription is failed: %s", lserror.message);
+		LSErrorFree(&lserror);
+		mContextTable->remove(handle);
+		return false;
 	}
 
-	LSCallCancel(mLSHandle, std::get<HFLS2::ScoContextData::SCOTOKEN>(*mScoContextList[index]), nullptr);
-	BT_DEBUG("Unsubscribe ScoService: %d", std::get<HFLS2::ScoContextData::SCOAPINAME>(*mScoContextList[index]));
-	delete mScoContextList[index];
-	mScoContextList.erase(mScoContextList.begin() + index);
+	mContextTable->setToken(handle, token);
+	return true;
 }
 
-void HfpHFRole::unsubscribeScoServicebyAdapterAddress(const std::string &adapterAddr)
+void HfpHFRole::unsubscribeService(HfpHFContextTable::Handle handle)
 {
-	BT_DEBUG("");
-	LSError lserror;
-	LSErrorInit(&lserror);
-	auto it = mScoContextList.begin();
-	while (it != mScoContextList.end())
+	HfpHFContextTable::Context *context = mContextTable->get(handle);
+	if (context == nullptr)
+		return;
+
+	if (context->token != LSMESSAGE_TOKEN_INVALID)
 	{
-		if (std::get<HFLS2::ScoContextData::ADAPTERADDRESS>(*(*it)).compare(adapterAddr) == 0)
-		{
-			LSCallCancel(mLSHandle, std::get<HFLS2::ScoContextData::SCOTOKEN>(*(*it)), &lserror);
-			delete *it;
-			it = mScoContextList.erase(it);
-		}
-		else
-		{
-			it++;
-		}
+		LSCallCancel(mLSHandle, context->token, nullptr);
+		BT_DEBUG("Unsubscribe Service: %d", context->apiName);
 	}
+	mContextTable->remove(handle);
 }
 
+void HfpHFRole::unsubscribeService(HFLS2::APIName apiName)
+{
+	unsubscribeService(mContextTable->find(apiName, "", ""));
+}
 
-void HfpHFRole::unsubscribeService(int index)
+void HfpHFRole::unsubscribeService(const std::string &adapterAddr)
 {
-	LSCallCancel(mLSHandle, std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]), nullptr);
-	BT_DEBUG("Unsubscribe Service: %d", std::get<HFLS2::ContextData::APINAME>(*mContextList[index]));
+	unsubscribeService(mContextTable->find(HFLS2::APIName::GETSTATUS, adapterAddr, ""));
 }
 
-void HfpHFRole::unsubscribeServiceAll()
+void HfpHFRole::unsubscribeScoServicebyAdapterAddress(const std::string &adapterAddr)
 {
-	LSError lserror;
-	LSErrorInit(&lserror);
-	for (int i = 0; i < mContextList.size(); i++)
+	BT_DEBUG("");
+	auto remotes = mScoRemoteMap.find(adapterAddr);
+	if (remotes != mScoRemoteMap.end())
 	{
-		if (std::get<HFLS2::ContextData::TOKEN>(*mContextList[i]) != LSMESSAGE_TOKEN_INVALID)
-		{
-			LSCallCancel(mLSHandle, std::get<HFLS2::ContextData::TOKEN>(*mContextList[i]), &lserror);
-		}
+		for (auto &remoteAddr : remotes->second)
+			unsubscribeService(mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddr, remoteAddr));
+		mScoRemoteMap.erase(remotes);
 	}
+	unsubscribeService(mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddr, ""));
+}
 
-	for (int i = 0; i < mScoContextList.size(); i++)
+void HfpHFRole::unsubscribeServiceAll()
+{
+	for (auto handle : mContextTable->getHandles())
+		unsubscribeService(handle);
+
+	// bluetooth2 is gone, so everything is learned again from the next
+	// adapter/getStatus once it is back
+	mPendingRequests.cancelAll(BT_ERR_DEVICE_NOT_CONNECTED);
+	mScoRemoteMap.clear();
+	mScoPerDeviceAdapters.clear();
+	if (mScoRetrySource)
 	{
-		if (std::get<HFLS2::ScoContextData::SCOTOKEN>(*mScoContextList[i]) != LSMESSAGE_TOKEN_INVALID)
-		{
-			LSCallCancel(mLSHandle, std::get<HFLS2::ScoContextData::SCOTOKEN>(*mScoContextList[i]), &lserror);
-		}
+		g_source_remove(mScoRetrySource);
+		mScoRetrySource = 0;
 	}
+	mScoRetrySec = 1;
+	mPendingDeviceStatus.clear();
+	mDeviceFingerprints.clear();
+	mPairedDevices.clear();
+	mAdapterMap.clear();
+	mAdapterInterfaceMap.clear();
 
 	BT_DEBUG("Unregister callbacks");
 }
 
 void HfpHFRole::subscribeService()
 {
-	LSError lserror;
-	LSErrorInit(&lserror);
-
 	std::string lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNAADAPTERGETSTATUS;
-	unsubscribeService(HFLS2::APIName::ADAPTERGETSTATUS);
-	int index = findContextIndex(HFLS2::APIName::ADAPTERGETSTATUS);
-	if (index != HFLS2::INVALIDINDEX)
-	{
-		LSCall(this->mLSHandle, lunaCmd.c_str(), HFLS2::LUNASUBSCRIBE.c_str(), mHFSubscribe->getAdapterStatusCallback,
-				mContextList[index], &std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]), &lserror);
-	}
-	else
-	{
-		BT_DEBUG("LS2 subscription is failed as index is invalid");
-	}
-
-	/*lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNAGETSTATUS;
-	unsubscribeService(HFLS2::APIName::GETSTATUS);
-
-	int index = findContextIndex(HFLS2::APIName::GETSTATUS);
-	LSCall(this->mLSHandle, lunaCmd.c_str(), HFLS2::LUNASUBSCRIBE.c_str(), mHFSubscribe->getStatusCallback,
-                mContextList[index], &std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]), &lserror);*/
-
-	unsubscribeService(HFLS2::APIName::RECEIVERESULT);
-	index = findContextIndex(HFLS2::APIName::RECEIVERESULT);
-	if (index != HFLS2::INVALIDINDEX)
-	{
-		lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNARECEIVERESULT;
-		LSCall(this->mLSHandle, lunaCmd.c_str(), HFLS2::LUNASUBSCRIBE.c_str(), mHFSubscribe->receiveResultCallback,
-			   mContextList[index], &std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]), &lserror);
+	callService(HFLS2::APIName::ADAPTERGETSTATUS, "", lunaCmd, HFLS2::LUNASUBSCRIBE, mHFSubscribe->getAdapterStatusCallback);
 
+	lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNARECEIVERESULT;
+	if (callService(HFLS2::APIName::RECEIVERESULT, "", lunaCmd, HFLS2::LUNASUBSCRIBE, mHFSubscribe->receiveResultCallback))
 		BT_DEBUG("LS2 subscription is success");
-	}
-	else
-	{
-		BT_DEBUG("LS2 subscription is failed as index is invalid");
-	}
 }
 
 void HfpHFRole::subscribeGetDeviceStatus(const std::string &adapterAddr, bool available)
 {
 	BT_DEBUG("");
 	unsubscribeService(adapterAddr);
+	// The first reply of a new subscription is always applied in full
+	mPendingDeviceStatus.erase(adapterAddr);
+	mDeviceFingerprints.erase(adapterAddr);
+	mPairedDevices.erase(adapterAddr);
 
 	if(available)
 	{
 		BT_DEBUG("Subscribing");
 		std::string lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNAGETSTATUS;
 		std::string payload = "{\"subscribe\":true, \"adapterAddress\":\"" + adapterAddr + "\"}";
-		mContextList.push_back(new LSContext(HFLS2::APIName::GETSTATUS, adapterAddr, this, LSMESSAGE_TOKEN_INVALID));
-		int index = findContextIndex(adapterAddr);
-		if (index != HFLS2::INVALIDINDEX)
-		{
-			LSCall(this->mLSHandle, lunaCmd.c_str(), payload.c_str(), mHFSubscribe->getStatusCallback,
-				   mContextList[index], &std::get<HFLS2::ContextData::TOKEN>(*mContextList[index]), nullptr);
-		}
+		callService(HFLS2::APIName::GETSTATUS, adapterAddr, lunaCmd, payload, mHFSubscribe->getStatusCallback);
 	}
 }
 
-void HfpHFRole::subscribeGetSCOStatus(const std::string &remoteAddr, const std::string& adapterAddress, bool connected)
+bool HfpHFRole::subscribeGetSCOStatus(const std::string &remoteAddr, const std::string& adapterAddress, bool connected)
 {
 	BT_DEBUG("");
-	unsubscribeScoService(remoteAddr,adapterAddress);
-
+	// hfp/getStatus is subscribed once per adapter and the replies are
+	// demultiplexed by remote address, so only the first connected AG
+	// opens the subscription and the last one closes it
+	auto &remotes = mScoRemoteMap[adapterAddress];
 	if (connected)
+		remotes.insert(remoteAddr);
+	else
+	{
+		remotes.erase(remoteAddr);
+		unsubscribeService(mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddress, remoteAddr));
+	}
+
+	if (remotes.empty())
+	{
+		unsubscribeScoServicebyAdapterAddress(adapterAddress);
+		return true;
+	}
+
+	return subscribeSCOStatus(adapterAddress);
+}
+
+bool HfpHFRole::subscribeSCOStatus(const std::string &adapterAddr)
+{
+	auto remotes = mScoRemoteMap.find(adapterAddr);
+	if (remotes == mScoRemoteMap.end())
+		return true;
+
+	std::string lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNASCOSTATUS;
+	if (mScoPerDeviceAdapters.find(adapterAddr) == mScoPerDeviceAdapters.end())
 	{
+		if (mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddr, "") != HfpHFContextTable::INVALIDHANDLE)
+			return true;
+
 		BT_DEBUG("Subscribing");
-		pbnjson::JValue params = pbnjson::Object();
-		params.put("adapterAddress",adapterAddress.c_str());
-		params.put("address",remoteAddr.c_str());
-		params.put("subscribe",true);
-		std::string payload;
-		LSUtils::generatePayload(params, payload);
-		std::string lunaCmd = HFLS2::BTLSCALL + HFLS2::LUNASCOSTATUS;
-		//std::string payload = "{\"subscribe\":true, \"address\":\"" + remoteAddr + ""\" ,\"address\":\"+ }";
-		mScoContextList.push_back(new LSScoContext(HFLS2::APIName::SCOSTATUS, remoteAddr, adapterAddress, this, LSMESSAGE_TOKEN_INVALID));
-		int index = findScoContextIndex(remoteAddr ,adapterAddress);
-		if (index != HFLS2::INVALIDINDEX)
-		{
-			LSCall(this->mLSHandle, lunaCmd.c_str(), payload.c_str(), mHFSubscribe->getSCOStatusCallback,
-				   mScoContextList[index], &std::get<HFLS2::ScoContextData::SCOTOKEN>(*mScoContextList[index]), nullptr);
-		}
-		else
+		std::string payload = "{\"subscribe\":true, \"adapterAddress\":\"" + adapterAddr + "\"}";
+		if (callService(HFLS2::APIName::SCOSTATUS, adapterAddr, lunaCmd, payload, mHFSubscribe->getSCOStatusCallback))
+			return true;
+		scheduleSCOStatusRetry();
+		return false;
+	}
+
+	bool subscribed = true;
+	for (auto &remoteAddr : remotes->second)
+	{
+		if (mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddr, remoteAddr) != HfpHFContextTable::INVALIDHANDLE)
+			continue;
+
+		BT_DEBUG("Subscribing %s", remoteAddr.c_str());
+		std::string payload = "{\"subscribe\":true, \"adapterAddress\":\"" + adapterAddr + "\", \"address\":\"" + remoteAddr + "\"}";
+		if (!callService(HFLS2::APIName::SCOSTATUS, adapterAddr, remoteAddr, lunaCmd, payload, mHFSubscribe->getSCOStatusCallback))
 		{
-			BT_DEBUG("subscrption failed as index is invalid");
+			scheduleSCOStatusRetry();
+			subscribed = false;
 		}
 	}
+	return subscribed;
+}
+
+void HfpHFRole::fallBackToDeviceSCOStatus(const std::string &adapterAddr)
+{
+	// bluetooth2 refused the adapter wide subscription or does not name
+	// the AG in its replies, so hfp/getStatus is subscribed per AG with the
+	// address in the request as it used to be
+	BT_WARNING("MSGID_SCO_SUBSCRIPTION", 0, "Subscribing SCO status per AG on adapter %s", adapterAddr.c_str());
+	mScoPerDeviceAdapters.insert(adapterAddr);
+	unsubscribeService(mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddr, ""));
+	subscribeSCOStatus(adapterAddr);
+}
+
+void HfpHFRole::scheduleSCOStatusRetry()
+{
+	if (mScoRetrySource)
+		return;
+
+	BT_DEBUG("Retrying SCO status subscriptions in %u s", mScoRetrySec);
+	mScoRetrySource = g_timeout_add_seconds(mScoRetrySec, handleSCOStatusRetry, this);
+	mScoRetrySec = std::min(mScoRetrySec * 2, MAXSCORETRYSEC);
+}
+
+gboolean HfpHFRole::handleSCOStatusRetry(gpointer userData)
+{
+	HfpHFRole *role = static_cast<HfpHFRole*>(userData);
+	role->mScoRetrySource = 0;
+
+	std::vector<std::string> adapters;
+	for (auto &remotes : role->mScoRemoteMap)
+		adapters.push_back(remotes.first);
+	for (auto &adapterAddr : adapters)
+		role->subscribeSCOStatus(adapterAddr);
+
+	return FALSE;
 }
 
 void HfpHFRole::sendResponseToClient(const std::string &remoteAddr, bool returnValue)
 {
-	auto responseMessageIter = mResponseMessage.find(remoteAddr);
-	if (responseMessageIter != mResponseMessage.end())
-	{
-		LS::Message response = responseMessageIter->second;
-		pbnjson::JValue responseObj = pbnjson::Object();
-		responseObj.put("returnValue", returnValue);
-		LSUtils::postToClient(response, responseObj);
-		mResponseMessage.erase(remoteAddr);
-	}
+	mPendingRequests.complete(remoteAddr, returnValue);
 }
 
 /**
@@ -326,6 +417,10 @@ As for a successful call
  */
 bool HfpHFRole::answerCall(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { answerCall(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(address, string), PROP(adapterAddress, string))REQUIRED_1(address));
@@ -340,7 +435,7 @@ bool HfpHFRole::answerCall(LSMessage &message)
 	{
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -362,7 +457,7 @@ bool HfpHFRole::answerCall(LSMessage &message)
 			}
 		}
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -429,6 +524,10 @@ As for a successful call
  */
 bool HfpHFRole::terminateCall(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { terminateCall(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_3(PROP(address, string), PROP(adapterAddress, string), PROP(index, integer))REQUIRED_2(address, index));
@@ -451,7 +550,7 @@ bool HfpHFRole::terminateCall(LSMessage &message)
 
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -473,7 +572,7 @@ bool HfpHFRole::terminateCall(LSMessage &message)
 			}
 		}
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -546,6 +645,10 @@ As for a successful call
  */
 bool HfpHFRole::releaseHeldCalls(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { releaseHeldCalls(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	std::string param = "";
@@ -561,7 +664,7 @@ bool HfpHFRole::releaseHeldCalls(LSMessage &message)
 	{
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -583,7 +686,7 @@ bool HfpHFRole::releaseHeldCalls(LSMessage &message)
 			}
 		}
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -651,6 +754,10 @@ As for a successful call
  */
 bool HfpHFRole::releaseActiveCalls(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { releaseActiveCalls(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	std::string param = "";
@@ -666,7 +773,7 @@ bool HfpHFRole::releaseActiveCalls(LSMessage &message)
 	{
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -688,7 +795,7 @@ bool HfpHFRole::releaseActiveCalls(LSMessage &message)
 			}
 		}
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -758,6 +865,10 @@ As for a successful call
  */
 bool HfpHFRole::holdActiveCalls(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { holdActiveCalls(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(address, string), PROP(adapterAddress, string))REQUIRED_1(address));
@@ -772,7 +883,7 @@ bool HfpHFRole::holdActiveCalls(LSMessage &message)
 	{
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -794,7 +905,7 @@ bool HfpHFRole::holdActiveCalls(LSMessage &message)
 			}
 		}
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -869,6 +980,10 @@ As for a successful call
  */
 bool HfpHFRole::mergeCall(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { mergeCall(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(address, string), PROP(adapterAddress, string))REQUIRED_1(address));
@@ -884,7 +999,7 @@ bool HfpHFRole::mergeCall(LSMessage &message)
 
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -906,7 +1021,7 @@ bool HfpHFRole::mergeCall(LSMessage &message)
 			}
 		}
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -978,6 +1093,10 @@ As for a successful call
  */
 bool HfpHFRole::setVolume(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { setVolume(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_3(PROP(address, string),PROP(volume, integer), PROP(adapterAddress, string))REQUIRED_2(address, volume));
@@ -993,7 +1112,7 @@ bool HfpHFRole::setVolume(LSMessage &message)
 		std::string volume = mHFLS2Call->getParam(localResult, "volume");
 #ifdef MULTI_SESSION_SUPPORT
 		std::string adapterAddress;
-		auto displayIndex = LSUtils::getDisplaySetIdIndex(message, this->getService());
+		auto displayIndex = mSessionResolver->getDisplaySetId(message);
 		if (displayIndex == LSUtils::DisplaySetId::HOST)
 		{
 			adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -1014,13 +1133,12 @@ bool HfpHFRole::setVolume(LSMessage &message)
 		if (iVolume < 0 || iVolume > 15)
 		{
 			LSUtils::respondWithError(request, BT_ERR_VOLUME_PARAM_ERROR);
-			mResponseMessage.erase(remoteAddr);
 			return true;
 		}
 
 		int vol = ((float) iVolume / 15.0) * 100;
 
-		auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+		auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 		if (!modem)
 		{
 			LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -1069,6 +1187,10 @@ As for a successful call
  */
 bool HfpHFRole::call(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { call(held); }))
+		return true;
+#endif
 	LS::Message request(&message);
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_4(PROP(address, string),PROP(adapterAddress, string),PROP(number, string),PROP(memoryDialing,integer))
@@ -1089,7 +1211,7 @@ bool HfpHFRole::call(LSMessage &message)
 		{
 #ifdef MULTI_SESSION_SUPPORT
 			std::string adapterAddress;
-			auto index = LSUtils::getDisplaySetIdIndex(message, this->getService());
+			auto index = mSessionResolver->getDisplaySetId(message);
 			if (index == LSUtils::DisplaySetId::HOST)
 			{
 				adapterAddress = mHFLS2Call->getParam(localResult, "adapterAddress");
@@ -1112,7 +1234,7 @@ bool HfpHFRole::call(LSMessage &message)
 				}
 			}
 
-			auto modem = mHfpOfonoManager->getModem(adapterAddress, remoteAddr);
+			auto modem = mHfpOfonoManager ? mHfpOfonoManager->getModem(adapterAddress, remoteAddr) : nullptr;
 			if (!modem)
 			{
 				LSUtils::respondWithError(request, BT_ERR_DEVICE_NOT_CONNECTED);
@@ -1170,6 +1292,10 @@ As for a successful call
  */
 bool HfpHFRole::setVoiceRecognition(LSMessage &message)
 {
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { setVoiceRecognition(held); }))
+		return true;
+#endif
 	std::string remoteAddr = "";
 	const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(address, string),PROP(enabled, boolean))REQUIRED_2(address, enabled));
 	LS2ParamList paramList =
@@ -1183,26 +1309,195 @@ bool HfpHFRole::setVoiceRecognition(LSMessage &message)
 		bool bEnabled = false;
 		if (enabled.compare("1") == 0)
 			bEnabled = true;
-		if (mHFDevice->getBVRAStatus() != bEnabled)
+		LS::Message request(&message);
+		if (mHFDevice->getBVRAStatus() == bEnabled)
 		{
-			handleSendAT(remoteAddr, "set", "BVRA", enabled);
-			mHFDevice->updateBVRAStatus(bEnabled);
+			pbnjson::JValue responseObj = pbnjson::Object();
+			responseObj.put("returnValue", true);
+			LSUtils::postToClient(request, responseObj);
+			return true;
 		}
-		sendResponseToClient(remoteAddr, true);
+
+		// Answered by the OK/ERROR of the AG, the state is assumed until
+		// then and put back if the AG refuses or does not answer
+		mPendingRequests.enqueue(remoteAddr, "BVRA", request, [this, bEnabled](bool success) {
+			if (!success && mHFDevice->getBVRAStatus() == bEnabled)
+				mHFDevice->updateBVRAStatus(!bEnabled);
+		});
+		handleSendAT(remoteAddr, "set", "BVRA", enabled);
+		mHFDevice->updateBVRAStatus(bEnabled);
+	}
+	return true;
+}
+
+/**
+Calls that have ended on the AGs of this device, newest first.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+address | No | String | Only calls of the AG with this address are reported. All AGs by default.
+adapterAddress | No | String | Only calls on this adapter are reported. All adapters by default.
+before | No | Number | next of the previous page. Only calls older than that are reported.
+limit | No | Number | Maximum number of calls reported, 20 by default and at most 50.
+
+@par Returns(Call)
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | Yes | Boolean | If the method succeeds, returnValue will contain true.
+                              If the method fails, returnValue will contain false.
+calls | Yes | Object array | One entry per call, see below.
+next | No | Number | Value of before for the next page. Left out once the oldest stored call was reported.
+errorText | No | String | errorText contains the error text if the method fails. The method will return errorText only if it fails.
+errorCode | No | Number | errorCode contains the error code if the method fails. The method will return errorCode only if it fails.
+
+Each call has
+
+Name | Required | Type | Description
+-----|--------|------|----------
+sequence | Yes | Number | Number of the call in the history, counting up.
+number | Yes | String | call number
+direction | No | String | "outgoing" or "incoming", left out if the AG did not report it.
+address | Yes | String | The address (bdaddr) of the AG.
+adapterAddress | Yes | String | The address of the local adapter.
+startTime | Yes | Number | When the call showed up, in ms since the epoch.
+answerTime | No | Number | When the call became active, in ms since the epoch. Left out for calls never answered.
+endTime | Yes | Number | When the call was released, in ms since the epoch.
+scoMs | Yes | Number | Time the call audio was routed to this device, in ms.
+
+@par Returns(Subscription)
+
+Not applicable.
+ */
+bool HfpHFRole::getCallHistory(LSMessage &message)
+{
+	LS::Message request(&message);
+	pbnjson::JValue requestObj;
+	int parseError = 0;
+
+	const std::string schema = STRICT_SCHEMA(PROPS_4(PROP(address, string), PROP(adapterAddress, string),
+	                                                 PROP(before, integer), PROP(limit, integer)));
+
+	if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+	{
+		if (JSON_PARSE_SCHEMA_ERROR == parseError)
+			LSUtils::respondWithError(request, BT_ERR_SCHEMA_VALIDATION_FAIL);
+		else
+			LSUtils::respondWithError(request, BT_ERR_BAD_JSON);
+		return true;
+	}
+
+	std::string remoteAddr = requestObj.hasKey("address") ? requestObj["address"].asString() : "";
+	std::string adapterAddr = requestObj.hasKey("adapterAddress") ? requestObj["adapterAddress"].asString() : "";
+	int64_t before = requestObj.hasKey("before") ? requestObj["before"].asNumber<int64_t>() : 0;
+	int64_t limit = requestObj.hasKey("limit") ? requestObj["limit"].asNumber<int64_t>() : 20;
+	if (limit <= 0 || limit > (int64_t) MAXCALLHISTORYPAGE)
+		limit = MAXCALLHISTORYPAGE;
+
+	uint64_t next = 0;
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	responseObj.put("calls", mCallHistory.getCalls(remoteAddr, adapterAddr, before > 0 ? before : 0, limit, next));
+	if (next)
+		responseObj.put("next", (int64_t) next);
+	LSUtils::postToClient(request, responseObj);
+	return true;
+}
+
+/**
+Deletes calls from the call history. Without parameters the whole history
+is deleted. Calls of an AG are also deleted when it is unpaired.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+address | No | String | Only calls of the AG with this address are deleted. All AGs by default.
+adapterAddress | No | String | Only calls on this adapter are deleted. All adapters by default.
+
+@par Returns(Call)
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | Yes | Boolean | If the method succeeds, returnValue will contain true.
+                              If the method fails, returnValue will contain false.
+deleted | Yes | Number | Number of calls deleted.
+errorText | No | String | errorText contains the error text if the method fails. The method will return errorText only if it fails.
+errorCode | No | Number | errorCode contains the error code if the method fails. The method will return errorCode only if it fails.
+
+@par Returns(Subscription)
+
+Not applicable.
+ */
+bool HfpHFRole::deleteCallHistory(LSMessage &message)
+{
+	LS::Message request(&message);
+	pbnjson::JValue requestObj;
+	int parseError = 0;
+
+	const std::string schema = STRICT_SCHEMA(PROPS_2(PROP(address, string), PROP(adapterAddress, string)));
+
+	if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+	{
+		if (JSON_PARSE_SCHEMA_ERROR == parseError)
+			LSUtils::respondWithError(request, BT_ERR_SCHEMA_VALIDATION_FAIL);
+		else
+			LSUtils::respondWithError(request, BT_ERR_BAD_JSON);
+		return true;
 	}
+
+	std::string remoteAddr = requestObj.hasKey("address") ? requestObj["address"].asString() : "";
+	std::string adapterAddr = requestObj.hasKey("adapterAddress") ? requestObj["adapterAddress"].asString() : "";
+
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	responseObj.put("deleted", (int64_t) mCallHistory.purge(remoteAddr, adapterAddr));
+	LSUtils::postToClient(request, responseObj);
 	return true;
 }
 
+void HfpHFRole::recordCallHistory(const std::string &remoteAddr, const std::string &adapterAddr, const std::string &phoneNumber,
+                                  const HfpHFCallStatus &callStatus)
+{
+	mCallHistory.append(remoteAddr, adapterAddr, phoneNumber, callStatus);
+}
+
 bool HfpHFRole::sendCLCC(const std::string &remoteAddr)
 {
+	mPendingRequests.enqueue(remoteAddr, "CLCC");
 	return handleSendAT(remoteAddr, "action", "CLCC");
 }
 
 void HfpHFRole::sendNREC(const std::string &remoteAddr)
 {
+	mPendingRequests.enqueue(remoteAddr, "NREC");
 	handleSendAT(remoteAddr, "set", "NREC", "0");
 }
 
+pbnjson::JValue HfpHFRole::getLoopStatus() const
+{
+	pbnjson::JValue statusObj = pbnjson::Object();
+	statusObj.put("atCommands", mPendingRequests.getStatus());
+
+	pbnjson::JValue subscriptionsObj = pbnjson::Array();
+	for (auto &subscription : mGetStatusSubscriptions)
+	{
+		pbnjson::JValue subscriptionObj = pbnjson::Object();
+		subscriptionObj.put("filter", subscription.first);
+		subscriptionObj.put("subscribers", subscription.second.subscribers->getMetrics());
+		subscriptionsObj.append(subscriptionObj);
+	}
+	statusObj.put("statusSubscriptions", subscriptionsObj);
+
+	pbnjson::JValue deviceEntriesObj = pbnjson::Object();
+	deviceEntriesObj.put("processed", (int64_t) mProcessedDeviceEntries);
+	deviceEntriesObj.put("skipped", (int64_t) mSkippedDeviceEntries);
+	statusObj.put("deviceEntries", deviceEntriesObj);
+	return statusObj;
+}
+
 bool HfpHFRole::handleSendAT(const std::string &remoteAddr, const std::string &type, const std::string &command)
 {
 	return handleSendAT(remoteAddr, type, command, "");
@@ -1241,7 +1536,7 @@ bool HfpHFRole::parseLSMessage(LSMessage &message, const HfpHFLS2Data &ls2Data,
 		{
 #ifdef MULTI_SESSION_SUPPORT
 			std::string adapterAddress;
-			auto index = LSUtils::getDisplaySetIdIndex(message, this->getService());
+			auto index = mSessionResolver->getDisplaySetId(message);
 			if (index == LSUtils::DisplaySetId::HOST)
 			{
 				adapterAddress = mHFLS2Call->getParam(result, "adapterAddress");
@@ -1264,20 +1559,62 @@ bool HfpHFRole::parseLSMessage(LSMessage &message, const HfpHFLS2Data &ls2Data,
 
 void HfpHFRole::handleSubscribeFunc(LS::Message &request)
 {
+	HfpHFStatusFilter filter(getStatusScope(*request.get()));
+	pbnjson::JValue requestObj;
+	LSUtils::parsePayload(request.getPayload(), requestObj);
+	if (!filter.parse(requestObj))
+	{
+		LSUtils::respondWithError(request, BT_ERR_FIELDS_PARAM_INVALID);
+		return;
+	}
+
+	refreshStatus();
+
+	// sinceVersion tells what the client has read, which is what lets a
+	// stalled subscriber be told from a slow one
+	if (requestObj.hasKey("sinceVersion"))
+	{
+		unsigned long long sinceVersion = requestObj["sinceVersion"].asNumber<int64_t>();
+		for (auto &subscription : mGetStatusSubscriptions)
+			subscription.second.subscribers->acknowledge(request, sinceVersion);
+	}
+
 	bool subscribed = false;
 	if (request.isSubscription())
 	{
-		if (mGetStatusSubscription == nullptr)
-		{
-			mGetStatusSubscription = new LS::SubscriptionPoint;
-			mGetStatusSubscription->setServiceHandle(getService());
-		}
-
-		BT_DEBUG("Register subscription");
-		mGetStatusSubscription->subscribe(request);
+		auto &subscription = mGetStatusSubscriptions[filter.getKey()];
+		if (subscription.subscribers == nullptr)
+		{
+			subscription.filter = filter;
+			subscription.postedContent = getStatusContent(filter);
+			subscription.subscribers = new HfpHFStatusSubscribers(mLSHandle, [this, filter]() -> const std::string& {
+				return getStatusSnapshot(filter, true);
+			});
+			// Released from the loop rather than from within its own
+			// cancel notification
+			subscription.subscribers->setEmptyFunc([this]() {
+				if (!mStatusPruneSource)
+					mStatusPruneSource = g_idle_add(handleStatusPrune, this);
+			});
+		}
+
+		BT_DEBUG("Register subscription for %s", filter.getKey().c_str());
+		subscription.subscribers->subscribe(request, mStatusVersion, requestObj.hasKey("sinceVersion"));
 		subscribed = true;
 	}
-	notifySubscribersStatusChanged(subscribed, request);
+
+	if (requestObj.hasKey("sinceVersion") && requestObj["sinceVersion"].asNumber<int64_t>() == (int64_t) mStatusVersion)
+	{
+		pbnjson::JValue responseObj = pbnjson::Object();
+		responseObj.put("returnValue", true);
+		responseObj.put("subscribed", subscribed);
+		responseObj.put("unchanged", true);
+		responseObj.put("statusVersion", (int64_t) mStatusVersion);
+		LSUtils::postToClient(request, responseObj);
+		return;
+	}
+
+	request.respond(getStatusSnapshot(filter, subscribed).c_str());
 }
 
 bool HfpHFRole::handleOneReplyFunc(LS::Message &request, const std::string &remoteAddr)
@@ -1288,7 +1625,6 @@ bool HfpHFRole::handleOneReplyFunc(LS::Message &request, const std::string &remo
 		LSUtils::respondWithError(request, errorCode);
 		return false;
 	}
-	mResponseMessage.insert(std::make_pair(remoteAddr, request));
 	return true;
 }
 
@@ -1300,7 +1636,6 @@ bool HfpHFRole::handleOneReplyFunc(LS::Message &request, const std::string &remo
 		LSUtils::respondWithError(request, errorCode);
 		return false;
 	}
-	mResponseMessage.insert(std::make_pair(remoteAddr, request));
 	return true;
 }
 
@@ -1315,183 +1650,305 @@ void HfpHFRole::handleAdapterGetStatus(LSMessage* reply)
 	if (!replyObj.hasKey("adapters"))
 		return;
 
+	// Collect the adapters which are usable right now, keyed by address, so
+	// that additions, removals, power changes and renames all fall out of
+	// one comparison with the known adapters
+	std::unordered_map<std::string, std::pair<std::string, std::string>> availableAdapters; //address to (name, interface)
 	auto adaptersObjArray = replyObj["adapters"];
 	BT_DEBUG("Size %zu existing adapter %zu", adaptersObjArray.arraySize(),mAdapterMap.size());
-	if(adaptersObjArray.arraySize() < mAdapterMap.size())
+	for (int i = 0; i < adaptersObjArray.arraySize(); i++)
 	{
-		BT_DEBUG("Removing Adapter");
-		auto itr = mAdapterMap.begin();
-		while(itr != mAdapterMap.end())
-		{
-			bool found = false;
-			for(int i = 0; i < adaptersObjArray.arraySize();i++)
-			{
-				auto adapterObj = adaptersObjArray[i];
-				if (!adapterObj.hasKey("adapterAddress") || !adapterObj.hasKey("interfaceName"))
-					continue;
+		auto adapterObj = adaptersObjArray[i];
+		if (!adapterObj.hasKey("adapterAddress") || !adapterObj.hasKey("interfaceName"))
+			continue;
 
-				auto adapterAaddress = adapterObj["adapterAddress"].asString();
-				if(itr->first ==  adapterAaddress)
-				{
-					found = true;
-					break;
-				}
-			}
+		auto powered = adapterObj["powered"].asBool();
+		auto adapterAddress = adapterObj["adapterAddress"].asString();
+		auto interfaceName = adapterObj["interfaceName"].asString();
+		if (adapterAddress.empty() || interfaceName.empty() || adapterObj["name"].asString().empty() || !powered)
+			continue;
 
-			if(!found)
-			{
-				BT_DEBUG("Removing Adapter %s from map", itr->second.c_str());
-				unsubscribeService(itr->first);
-				mAdapterInterfaceMap.erase(itr->first);
-				itr = mAdapterMap.erase(itr);
-			}
-			else
-			{
-				itr++;
-			}
-		}
+#ifdef MULTI_SESSION_SUPPORT
+		auto adapterName = adapterObj["name"].asString();
+#else
+		auto adapterName = interfaceName;
+#endif
+		availableAdapters[adapterAddress] = std::make_pair(adapterName, interfaceName);
 	}
-	else if (adaptersObjArray.arraySize() > mAdapterMap.size())
+
+	auto itr = mAdapterMap.begin();
+	while (itr != mAdapterMap.end())
 	{
-		for (int i = 0; i < adaptersObjArray.arraySize(); i++)
+		if (availableAdapters.find(itr->first) != availableAdapters.end())
 		{
-			BT_DEBUG("New Adapter");
-			auto adapterObj = adaptersObjArray[i];
-			if (!adapterObj.hasKey("adapterAddress") || !adapterObj.hasKey("interfaceName"))
-				continue;
+			itr++;
+			continue;
+		}
 
-			auto powered = adapterObj["powered"].asBool();
+		// Everything learned through the adapter goes with it, AGs on it
+		// are reported as gone
+		std::string adapterAddr = itr->first;
+		BT_DEBUG("Removing Adapter %s from map", itr->second.c_str());
+		unsubscribeService(adapterAddr);
+		unsubscribeScoServicebyAdapterAddress(adapterAddr);
+		mScoPerDeviceAdapters.erase(adapterAddr);
+		for (auto &fingerprint : mDeviceFingerprints[adapterAddr])
+			mPendingRequests.cancel(fingerprint.first, BT_ERR_ADAPTER_IS_NOT_AVAILABLE);
+		mPendingDeviceStatus.erase(adapterAddr);
+		mDeviceFingerprints.erase(adapterAddr);
+		mPairedDevices.erase(adapterAddr);
+		mHFDevice->removeAllDevicebyAdapterAddress(adapterAddr);
+		mAdapterInterfaceMap.erase(adapterAddr);
+		itr = mAdapterMap.erase(itr);
+		notifySubscribersStatusChanged(true, adapterAddr, "");
+	}
 
-			if(adapterObj["adapterAddress"].asString().empty() || adapterObj["interfaceName"].asString().empty() || adapterObj["name"].asString().empty() || !powered)
-				continue;
+	for (auto &adapter : availableAdapters)
+	{
+		const std::string &adapterAddress = adapter.first;
+		const std::string &adapterName = adapter.second.first;
+		const std::string &interfaceName = adapter.second.second;
+
+		auto knownAdapter = mAdapterMap.find(adapterAddress);
+		if (knownAdapter == mAdapterMap.end())
+		{
+			BT_DEBUG("Adding Adapter %s", adapterName.c_str());
+			enableScoRouting(interfaceName);
+			mAdapterMap.insert(std::make_pair(adapterAddress, adapterName));
+			mAdapterInterfaceMap[adapterAddress] = interfaceName;
+			subscribeGetDeviceStatus(adapterAddress, true);
+			continue;
+		}
 
-			auto adapterAaddress = adapterObj["adapterAddress"].asString();
-#ifdef MULTI_SESSION_SUPPORT
-			auto adapterName = adapterObj["name"].asString();
-#else
-			auto adapterName = adapterObj["interfaceName"].asString();
-#endif
-			auto itr = mAdapterMap.find(adapterAaddress.c_str());
-			if(itr == mAdapterMap.end() && !adapterName.empty() && !adapterAaddress.empty())
-			{
-				BT_DEBUG("Adding Adapter %s powered %d",adapterName.c_str(), powered);
-				//Enable SCO routing
-				std::string hciInterface =  adapterObj["interfaceName"].asString();
-				std::size_t found =  hciInterface.find("hci");
-				if (found != std::string::npos)
-				{
-					std::string hcitool = "hcitool";
-					std::string hcicmd = "0x3F 0x01C 0x01 0x02 0x00 0x01 0x01 &";
-					std::string hcidevice = hciInterface;
-					std::string cmd = hcitool +  " -i " + hcidevice + std::string(" cmd ") + hcicmd;
-					system(cmd.c_str());
-				}
-				mAdapterMap.insert(std::make_pair(adapterAaddress,adapterName));
-				mAdapterInterfaceMap.insert(std::make_pair(adapterAaddress, adapterObj["interfaceName"].asString()));
-				subscribeGetDeviceStatus(adapterAaddress,true);
-			}
+		if (knownAdapter->second != adapterName)
+		{
+			BT_DEBUG("Renaming Adapter %s to %s", knownAdapter->second.c_str(), adapterName.c_str());
+			knownAdapter->second = adapterName;
+			// Display sets find their adapter by name
+			notifySubscribersStatusChanged(true);
+		}
+
+		auto &knownInterface = mAdapterInterfaceMap[adapterAddress];
+		if (knownInterface != interfaceName)
+		{
+			BT_DEBUG("Adapter %s moved to %s", adapterAddress.c_str(), interfaceName.c_str());
+			knownInterface = interfaceName;
+			enableScoRouting(interfaceName);
 		}
 	}
 	BT_DEBUG(" Exit");
 }
 
+void HfpHFRole::enableScoRouting(const std::string &interfaceName)
+{
+	bool sent = mHciCommand->enableScoRouting(interfaceName, [interfaceName](bool success) {
+		if (success)
+			BT_INFO("INFO_SCO_ROUTING", 0, "SCO routing enabled on %s", interfaceName.c_str());
+		else
+			BT_ERROR("MSGID_SCO_ROUTING_FAILED", 0, "Failed to enable SCO routing on %s", interfaceName.c_str());
+	});
+
+	if (!sent)
+		BT_ERROR("MSGID_SCO_ROUTING_FAILED", 0, "Failed to send SCO routing command to %s", interfaceName.c_str());
+}
+
 
 void HfpHFRole::handleGetStatus(LSMessage* reply, const std::string &adapterAddr)
+{
+	// Call control shares the luna handle with bluetooth2 replies, so a
+	// device/getStatus storm only keeps the latest list per adapter here.
+	// Lists are applied from a default priority source, below the handle
+	mPendingDeviceStatus[adapterAddr] = LS::Message(reply);
+	if (!mDeviceStatusSource)
+		mDeviceStatusSource = g_idle_add_full(G_PRIORITY_DEFAULT, handleDeviceStatusDispatch, this, nullptr);
+}
+
+gboolean HfpHFRole::handleDeviceStatusDispatch(gpointer userData)
+{
+	HfpHFRole *role = static_cast<HfpHFRole*>(userData);
+
+	role->mDeviceStatusSource = 0;
+	std::unordered_map<std::string, LS::Message> pendingDeviceStatus;
+	pendingDeviceStatus.swap(role->mPendingDeviceStatus);
+	for (auto &pending : pendingDeviceStatus)
+		role->applyDeviceStatus(pending.second, pending.first);
+	return FALSE;
+}
+
+void HfpHFRole::applyDeviceStatus(LS::Message &replyMsg, const std::string &adapterAddr)
 {
 	BT_DEBUG("");
-	LS::Message replyMsg(reply);
-	pbnjson::JValue replyObj;
+	HFReply::DeviceStatus deviceStatus;
 
-	if (!mHFLS2Call->parseSubscriptionData(replyMsg, replyObj))
+	if (!mHFReplyParser->parseDeviceStatus(replyMsg, deviceStatus))
 		return;
-	if (!replyObj.hasKey("devices"))
+	if (!deviceStatus.hasDevices)
 		return;
 
-	auto devicesObjArray = replyObj["devices"];
-	if (devicesObjArray.arraySize() == 0)
+	endStaleStatus(adapterAddr);
+	updatePairedDevices(adapterAddr, deviceStatus);
+
+	auto &fingerprints = mDeviceFingerprints[adapterAddr];
+	if (deviceStatus.devices.empty())
 	{
 		unsubscribeScoServicebyAdapterAddress(adapterAddr);
 		mHFDevice->removeAllDevicebyAdapterAddress(adapterAddr);
-		notifySubscribersStatusChanged(true);
+		fingerprints.clear();
+		notifySubscribersStatusChanged(true, adapterAddr);
+		return;
 	}
 
-	for (int i = 0; i < devicesObjArray.arraySize(); i++)
+	// bluetooth2 posts the whole device list on any change of any paired
+	// device, so only entries whose HFP_AG state differs from the last
+	// update are applied
+	DeviceFingerprintMap currentFingerprints;
+	for (auto &device : deviceStatus.devices)
 	{
-		auto deviceObj = devicesObjArray[i];
-		if (!deviceObj.hasKey("address") || !deviceObj.hasKey("connectedRoles"))
+		if (!device.hasAddress || !device.hasConnectedRoles)
 			continue;
 		// Sometimes its coming empty , hence not considering
 		//auto adapterAddress = replyObj["adapterAddress"].asString();
-		auto address = deviceObj["address"].asString();
-		auto connectedRoles = deviceObj["connectedRoles"];
-		bool bFound = false;
-		for (int n = 0; n < connectedRoles.arraySize(); n++)
+		auto knownDevice = fingerprints.find(device.address);
+		if (knownDevice != fingerprints.end() && knownDevice->second == device.hfpAGConnected)
 		{
-			std::string profile = connectedRoles[n].asString();
-			if (profile != "HFP_AG")
-				continue;
+			mSkippedDeviceEntries++;
+			currentFingerprints[device.address] = device.hfpAGConnected;
+			continue;
+		}
 
-			bFound = true;
-			if (mHFDevice->createDeviceInfo(address,adapterAddr))
-			{
-				//A new device is created, so fetch its properties
-				if (mHfpOfonoManager) {
-					auto modem = mHfpOfonoManager->getModem(adapterAddr, address);
-					if (modem)
-					{
-						BT_DEBUG("modem found for device:%s  for adapter %s", address.c_str(),adapterAddr.c_str());
-						modem->notifyProperties();
-					}
+		// An entry that could not be applied is left out, so the next
+		// update applies it again
+		mProcessedDeviceEntries++;
+		if (updateDeviceConnection(device.address, adapterAddr, device.hfpAGConnected))
+			currentFingerprints[device.address] = device.hfpAGConnected;
+	}
+
+	for (auto &knownDevice : fingerprints)
+	{
+		if (!knownDevice.second || currentFingerprints.find(knownDevice.first) != currentFingerprints.end())
+			continue;
+
+		mProcessedDeviceEntries++;
+		if (!updateDeviceConnection(knownDevice.first, adapterAddr, false))
+			currentFingerprints[knownDevice.first] = true;
+	}
+	fingerprints.swap(currentFingerprints);
+
+	BT_DEBUG("device entries processed: %lu, skipped: %lu", mProcessedDeviceEntries, mSkippedDeviceEntries);
+}
+
+void HfpHFRole::updatePairedDevices(const std::string &adapterAddr, const HFReply::DeviceStatus &deviceStatus)
+{
+	std::unordered_set<std::string> pairedDevices;
+	for (auto &device : deviceStatus.devices)
+	{
+		if (device.hasAddress && device.paired)
+			pairedDevices.insert(device.address);
+	}
+
+	// A device that was paired and is no longer, or has left the list of
+	// a still present adapter, was unpaired, its calls go with it
+	auto &knownDevices = mPairedDevices[adapterAddr];
+	for (auto &remoteAddr : knownDevices)
+	{
+		if (pairedDevices.find(remoteAddr) == pairedDevices.end())
+			mCallHistory.purge(remoteAddr, adapterAddr);
+	}
+	knownDevices.swap(pairedDevices);
+}
+
+bool HfpHFRole::updateDeviceConnection(const std::string &remoteAddr, const std::string &adapterAddr, bool connected)
+{
+	if (connected)
+	{
+		if (!mHfpOfonoManager && mOfonoAvailable)
+			createOfonoManager();
+
+		if (mHFDevice->createDeviceInfo(remoteAddr, adapterAddr))
+		{
+			//A new device is created, so fetch its properties
+			if (mHfpOfonoManager) {
+				auto modem = mHfpOfonoManager->getModem(adapterAddr, remoteAddr);
+				if (modem)
+				{
+					BT_DEBUG("modem found for device:%s  for adapter %s", remoteAddr.c_str(),adapterAddr.c_str());
+					modem->notifyProperties();
 				}
 			}
-
-			BT_DEBUG("Add device:%s  for adapter %s", address.c_str(),adapterAddr.c_str());
-			subscribeGetSCOStatus(address,adapterAddr, true);
-			break;
 		}
 
-		if (!bFound)
+		if (!mHFDevice->isDeviceAvailable(remoteAddr, adapterAddr))
 		{
-			if (mHFDevice->removeDeviceInfo(address, adapterAddr))
-			{
-				subscribeGetSCOStatus(address,adapterAddr, false);
-				notifySubscribersStatusChanged(true);
-			}
+			BT_ERROR("MSGID_DEVICE_INFO_FAILED", 0, "No device info for %s on adapter %s", remoteAddr.c_str(), adapterAddr.c_str());
+			return false;
 		}
+
+		BT_DEBUG("Add device:%s  for adapter %s", remoteAddr.c_str(),adapterAddr.c_str());
+		return subscribeGetSCOStatus(remoteAddr,adapterAddr, true);
 	}
+
+	if (mHFDevice->removeDeviceInfo(remoteAddr, adapterAddr))
+	{
+		mPendingRequests.cancel(remoteAddr, BT_ERR_DEVICE_NOT_CONNECTED);
+		subscribeGetSCOStatus(remoteAddr,adapterAddr, false);
+		notifySubscribersStatusChanged(true, adapterAddr, remoteAddr);
+	}
+	return true;
 }
 
 void HfpHFRole::handleReceiveResult(LSMessage* reply)
 {
 	LS::Message replyMsg(reply);
-	pbnjson::JValue replyObj;
+	HFReply::ReceiveResult receiveResult;
 
-	if (!mHFLS2Call->parseSubscriptionData(replyMsg, replyObj))
+	if (!mHFReplyParser->parseReceiveResult(replyMsg, receiveResult))
 		return;
 
-	std::string address = replyObj["address"].asString();
-	std::string resultCode = replyObj["resultCode"].asString();
-	if (!resultCode.empty())
-		mHFDevice->updateStatus(address, resultCode);
+	if (!receiveResult.resultCode.empty())
+		mHFDevice->updateStatus(receiveResult.address, receiveResult.resultCode);
 }
 
-void HfpHFRole::handleGetSCOStatus(LSMessage* reply, const std::string &remoteAddr)
+void HfpHFRole::handleGetSCOStatus(LSMessage* reply, const std::string &adapterAddr, const std::string &remoteAddr)
 {
 	BT_DEBUG("");
-	if (remoteAddr.empty())
+	LS::Message replyMsg(reply);
+	HFReply::SCOStatus scoStatus;
+
+	if (!mHFReplyParser->parseSCOStatus(replyMsg, scoStatus))
 		return;
 
-	LS::Message replyMsg(reply);
-	pbnjson::JValue replyObj;
+	if (!scoStatus.returnValue)
+	{
+		BT_WARNING("MSGID_SCO_SUBSCRIPTION", 0, "SCO status subscription failed for %s on adapter %s",
+		           remoteAddr.c_str(), adapterAddr.c_str());
+		if (remoteAddr.empty())
+		{
+			fallBackToDeviceSCOStatus(adapterAddr);
+			return;
+		}
+		unsubscribeService(mContextTable->find(HFLS2::APIName::SCOSTATUS, adapterAddr, remoteAddr));
+		scheduleSCOStatusRetry();
+		return;
+	}
+	mScoRetrySec = 1;
 
-	if (!mHFLS2Call->parseSubscriptionData(replyMsg, replyObj))
+	if (scoStatus.address.empty())
+	{
+		if (remoteAddr.empty())
+		{
+			fallBackToDeviceSCOStatus(adapterAddr);
+			return;
+		}
+		scoStatus.address = remoteAddr;
+	}
+
+	auto remotes = mScoRemoteMap.find(adapterAddr);
+	if (remotes == mScoRemoteMap.end() || remotes->second.find(scoStatus.address) == remotes->second.end())
 		return;
 
-	auto scoStatus = replyObj["sco"].asBool();
-	auto adapterAddress = replyObj["adapterAddress"].asString();
-	BT_DEBUG("addr: %s, sco: %d adapter %s", remoteAddr.c_str(), scoStatus ,adapterAddress.c_str());
-	if ((!adapterAddress.empty())&&(mHFDevice->updateSCOStatus(remoteAddr, adapterAddress, scoStatus)))
-		notifySubscribersStatusChanged(true);
+	BT_DEBUG("addr: %s, sco: %d adapter %s", scoStatus.address.c_str(), scoStatus.sco ,adapterAddr.c_str());
+	if (mHFDevice->updateSCOStatus(scoStatus.address, adapterAddr, scoStatus.sco))
+		notifySubscribersStatusChanged(true, adapterAddr, scoStatus.address);
 }
 
 /**
@@ -1503,6 +1960,17 @@ Name | Required | Type | Description
 -----|--------|------|----------
 subscribed | No | Boolean | To be informed of changes to the state, set subscribe to true.
                             Otherwise, set subscribe to false. The default valus of subscribe is false.
+adapters | No | String array | Only AGs connected to one of these adapters are reported. All adapters by default.
+devices | No | String array | Only AGs with one of these addresses are reported. All AGs by default.
+fields | No | String array | Fields reported for each AG, any of address, adapterAddress, signal, battery, sco, volume,
+                             ring, operatorName, networkStatus and calls. address is always reported. Without calls an AG
+                             is a single entry without number, callStatus, direction and index. All fields by default.
+version | No | Number | Response format. 1 (default) reports one audioGateways entry per call with the AG fields
+                       repeated in each. 2 reports one entry per AG with its calls nested in a "calls" array.
+sinceVersion | No | Number | statusVersion of the last status the client has. If nothing changed since, the reply
+                            only contains returnValue, subscribed, unchanged and statusVersion. A subscription made
+                            with sinceVersion is paused after 8 updates until the client calls again with sinceVersion
+                            to acknowledge what it has read.
 
 @par Returns(Call)
 
@@ -1514,6 +1982,10 @@ returnValue | Yes | Boolean | If the method succeeds, returnValue will contain t
                               in the Error Codes Reference table of this method. See the Error Code Reference table for more information.
 subscribed | Yes | String | If the subscription was set for this method, subscribed will contain true.
                            If the subscription was not set for this method, subscribed will contain false.
+statusVersion | Yes | Number | Version of the reported status, bumped whenever the status changes.
+unchanged | No | Boolean | True if the status still is the one of sinceVersion, audioGateways is then left out.
+stale | No | Boolean | True while the status is the one stored before the service restarted and live data
+                       has not come in yet.
 errorText | No | String | errorText contains the error text if the method fails. The method will return errorText only if it fails.
                           See the Error Codes Reference of this method for more details.
 errorCode | No | Number | errorCode contains the error code if the method fails. The method will return errorCode only if it fails.
@@ -1538,7 +2010,13 @@ As for a successful call
  **/
 bool HfpHFRole::getStatus(LSMessage &message)
 {
-	const std::string schema = STRICT_SCHEMA(PROPS_1(PROP(subscribe, boolean)));
+#ifdef MULTI_SESSION_SUPPORT
+	if (!mSessionResolver->resolve(message, [this](LSMessage &held) { getStatus(held); }))
+		return true;
+#endif
+	const std::string schema = STRICT_SCHEMA(PROPS_6(PROP(subscribe, boolean), PROP_WITH_VAL_2(version, integer, 1, 2),
+	                                                 PROP(sinceVersion, integer), ARRAY(adapters, string),
+	                                                 ARRAY(devices, string), ARRAY(fields, string)));
 	std::string remoteAddr = "";
 	LS2ParamList paramList;
 	LS2Result localResult;
@@ -1550,35 +2028,361 @@ bool HfpHFRole::getStatus(LSMessage &message)
 
 void HfpHFRole::notifySubscribersStatusChanged(bool subscribed)
 {
-	if (mGetStatusSubscription != nullptr)
+	notifySubscribersStatusChanged(subscribed, "", "");
+}
+
+void HfpHFRole::notifySubscribersStatusChanged(bool subscribed, const std::string &adapterAddr, const std::string &remoteAddr)
+{
+	markStatusDirty(adapterAddr, remoteAddr);
+
+	// Committed changes are stored even when nobody is subscribed
+	if (mGetStatusSubscriptions.empty() && !mStatusStore.isOpen())
+		return;
+
+	// Rebuilding and posting waits for an idle loop so that call control
+	// is not queued behind a burst of updates, but only for so long
+	gint64 now = g_get_monotonic_time();
+	if (!mStatusDirtySince)
+		mStatusDirtySince = now;
+
+	if (now - mStatusDirtySince >= MAXSTATUSDEFERMS * 1000)
 	{
-		LS::Message request;
-		notifySubscribersStatusChanged(subscribed, request);
+		flushStatusChanges();
+		return;
 	}
+
+	if (!mStatusFlushSource)
+		mStatusFlushSource = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, handleStatusFlush, this, nullptr);
+	// A loop that never goes idle still flushes in time
+	if (!mStatusBackstopSource)
+		mStatusBackstopSource = g_timeout_add(MAXSTATUSDEFERMS, handleStatusBackstop, this);
 }
 
-void HfpHFRole::notifySubscribersStatusChanged(bool subscribed, LS::Message &request)
+gboolean HfpHFRole::handleStatusFlush(gpointer userData)
 {
-	if (subscribed && mHFDevice->isDeviceConnecting())
+	HfpHFRole *role = static_cast<HfpHFRole*>(userData);
+
+	role->mStatusFlushSource = 0;
+	role->flushStatusChanges();
+	return FALSE;
+}
+
+gboolean HfpHFRole::handleStatusBackstop(gpointer userData)
+{
+	HfpHFRole *role = static_cast<HfpHFRole*>(userData);
+
+	role->mStatusBackstopSource = 0;
+	role->flushStatusChanges();
+	return FALSE;
+}
+
+void HfpHFRole::flushStatusChanges()
+{
+	if (mStatusFlushSource)
+	{
+		g_source_remove(mStatusFlushSource);
+		mStatusFlushSource = 0;
+	}
+	if (mStatusBackstopSource)
+	{
+		g_source_remove(mStatusBackstopSource);
+		mStatusBackstopSource = 0;
+	}
+
+	// Changes are held while an AG connects and tried again shortly
+	if (mHFDevice->isDeviceConnecting())
+	{
+		mStatusBackstopSource = g_timeout_add(MAXSTATUSDEFERMS, handleStatusBackstop, this);
 		return;
+	}
 
-	pbnjson::JValue devicesObj = pbnjson::Array();
-	pbnjson::JValue remoteObj = pbnjson::Object();
+	mStatusDirtySince = 0;
+	refreshStatus();
+
+	for (auto &iter : mGetStatusSubscriptions)
+	{
+		StatusSubscription &subscription = iter.second;
+		if (!subscription.pending)
+			continue;
+
+		subscription.pending = false;
+
+		// A change of a field or call the filter leaves out projects to
+		// what was posted already
+		std::string content = getStatusContent(subscription.filter);
+		if (content == subscription.postedContent)
+			continue;
+
+		subscription.postedContent = content;
+		subscription.subscribers->post(mStatusVersion);
+	}
+}
+
+void HfpHFRole::pruneStatusSubscriptions()
+{
+	for (auto iter = mGetStatusSubscriptions.begin(); iter != mGetStatusSubscriptions.end();)
+	{
+		if (!iter->second.subscribers->empty())
+		{
+			++iter;
+			continue;
+		}
+
+		BT_DEBUG("Dropping subscription for %s", iter->first.c_str());
+		delete iter->second.subscribers;
+		mStatusSnapshots.erase(iter->first + "/subscribed");
+		iter = mGetStatusSubscriptions.erase(iter);
+	}
+}
+
+gboolean HfpHFRole::handleStatusPrune(gpointer userData)
+{
+	HfpHFRole *role = static_cast<HfpHFRole*>(userData);
+
+	role->mStatusPruneSource = 0;
+	role->pruneStatusSubscriptions();
+	return FALSE;
+}
+
+void HfpHFRole::markStatusDirty(const std::string &adapterAddr, const std::string &remoteAddr)
+{
+	mDirtyStatus.insert(std::make_pair(adapterAddr, remoteAddr));
+
+	// Only the subscribers whose scope and filter can see the change are
+	// considered for a new payload
+	for (auto &iter : mGetStatusSubscriptions)
+	{
+		StatusSubscription &subscription = iter.second;
+		if (!adapterAddr.empty() && !isAdapterVisible(subscription.filter, adapterAddr))
+			continue;
+		if (!remoteAddr.empty() && !subscription.filter.matchesDevice(remoteAddr))
+			continue;
+
+		subscription.pending = true;
+	}
+}
+
+void HfpHFRole::refreshStatus()
+{
+	std::set<std::pair<std::string, std::string>> dirtyStatus;
+	dirtyStatus.swap(mDirtyStatus);
+
+	bool changed = false;
+	if (dirtyStatus.find(std::make_pair(std::string(), std::string())) != dirtyStatus.end())
+	{
+		changed = updateStatusFragment("", "");
+	}
+	else
+	{
+		for (auto &dirty : dirtyStatus)
+			changed |= updateStatusFragment(dirty.first, dirty.second);
+	}
+
+	bool stale = !mStaleFragments.empty();
+	if (stale != mStatusStale)
+	{
+		mStatusStale = stale;
+		changed = true;
+	}
+
+	if (changed)
+	{
+		mStatusVersion++;
+		BT_DEBUG("Status version %llu", mStatusVersion);
+		mStatusStore.save(mStatusFragments, mStatusVersion);
+	}
+}
+
+void HfpHFRole::loadStoredStatus()
+{
+	if (!mStatusStore.load(mStatusFragments, mStatusVersion))
+		return;
+
+	for (auto &adapterFragments : mStatusFragments)
+	{
+		for (auto &fragment : adapterFragments.second)
+			mStaleFragments[adapterFragments.first].insert(fragment.first);
+	}
+	mStatusStale = !mStaleFragments.empty();
+	if (!mStatusStale)
+		return;
+
+	// Versions carry on from the stored status so that sinceVersion of a
+	// client stays meaningful across a restart
+	BT_INFO("INFO_STATUS_RESTORED", 0, "Serving stored status version %llu of %zu adapters until live data is in",
+	        mStatusVersion, mStaleFragments.size());
+	StartupTrace::getInstance().mark("statusRestored");
+	mStaleTimeoutSource = g_timeout_add_seconds(MAXSTATUSSTALESEC, handleStaleTimeout, this);
+}
+
+void HfpHFRole::endStaleStatus(const std::string &adapterAddr)
+{
+	if (mStaleFragments.erase(adapterAddr) == 0)
+		return;
+
+	// AGs of the adapter that live data did not bring back are dropped now
+	notifySubscribersStatusChanged(true, adapterAddr);
+
+	if (mStaleFragments.empty() && mStaleTimeoutSource)
+	{
+		g_source_remove(mStaleTimeoutSource);
+		mStaleTimeoutSource = 0;
+	}
+}
+
+gboolean HfpHFRole::handleStaleTimeout(gpointer userData)
+{
+	HfpHFRole *role = static_cast<HfpHFRole*>(userData);
+
+	role->mStaleTimeoutSource = 0;
+	BT_INFO("INFO_STATUS_STALE_EXPIRED", 0, "No live status for %zu stored adapters", role->mStaleFragments.size());
+	role->mStaleFragments.clear();
+	role->notifySubscribersStatusChanged(true);
+	return FALSE;
+}
+
+const std::string& HfpHFRole::getStatusSnapshot(const HfpHFStatusFilter &filter, bool subscribed)
+{
+	std::string key = filter.getKey() + (subscribed ? "/subscribed" : "");
+	auto snapshot = mStatusSnapshots.find(key);
+	if (snapshot != mStatusSnapshots.end() && snapshot->second.first == mStatusVersion)
+		return snapshot->second.second;
+
+	// Snapshots of one-off filters are dropped once too many pile up
+	if (snapshot == mStatusSnapshots.end() && mStatusSnapshots.size() >= MAXSTATUSSNAPSHOTS)
+		mStatusSnapshots.clear();
+
+	auto &entry = mStatusSnapshots[key];
+	entry.first = mStatusVersion;
+	entry.second.clear();
+	LSUtils::generatePayload(buildStatusPayload(filter, subscribed), entry.second);
+	return entry.second;
+}
+
+int HfpHFRole::getStatusScope(LSMessage &message)
+{
+#ifdef MULTI_SESSION_SUPPORT
+	auto displayIndex = mSessionResolver->getDisplaySetId(message);
+	if (displayIndex != LSUtils::DisplaySetId::HOST)
+		return displayIndex;
+#endif
+	return HOSTSTATUSSCOPE;
+}
+
+bool HfpHFRole::isAdapterVisible(const HfpHFStatusFilter &filter, const std::string &adapterAddr) const
+{
+#ifdef MULTI_SESSION_SUPPORT
+	// A display set without its adapter sees nothing rather than everything
+	if (filter.getScope() != HOSTSTATUSSCOPE &&
+	    getAdapterAddress(static_cast<LSUtils::DisplaySetId>(filter.getScope())) != adapterAddr)
+		return false;
+#endif
+	return filter.matchesAdapter(adapterAddr);
+}
+
+bool HfpHFRole::updateStatusFragment(const std::string &adapterAddr, const std::string &remoteAddr)
+{
+	auto inRange = [&adapterAddr, &remoteAddr](const std::string &adapter, const std::string &remote) {
+		return (adapterAddr.empty() || adapter == adapterAddr) && (remoteAddr.empty() || remote == remoteAddr);
+	};
+
+	bool changed = false;
 	HFDeviceList localList = mHFDevice->getDeviceInfoList();
 	for (auto adapterList : localList)
 	{
-		for(auto localDevice : adapterList.second)
-			buildGetStatusResp(localDevice.first, *localDevice.second,adapterList.first, devicesObj);
+		for (auto localDevice : adapterList.second)
+		{
+			if (!inRange(adapterList.first, localDevice.first))
+				continue;
+
+			auto staleFragments = mStaleFragments.find(adapterList.first);
+			if (staleFragments != mStaleFragments.end())
+				staleFragments->second.erase(localDevice.first);
+
+			pbnjson::JValue AGObj = buildGetStatusResp(localDevice.first, *localDevice.second, adapterList.first);
+			auto &fragments = mStatusFragments[adapterList.first];
+			auto fragment = fragments.find(localDevice.first);
+			if (fragment != fragments.end() && fragment->second == AGObj)
+				continue;
+
+			fragments[localDevice.first] = AGObj;
+			changed = true;
+		}
+	}
+
+	// Drop the AGs which are gone
+	for (auto adapterFragments = mStatusFragments.begin(); adapterFragments != mStatusFragments.end();)
+	{
+		auto adapterList = localList.find(adapterFragments->first);
+		auto staleFragments = mStaleFragments.find(adapterFragments->first);
+		auto &fragments = adapterFragments->second;
+		for (auto fragment = fragments.begin(); fragment != fragments.end();)
+		{
+			bool stale = staleFragments != mStaleFragments.end() &&
+			             staleFragments->second.find(fragment->first) != staleFragments->second.end();
+			if (!stale && inRange(adapterFragments->first, fragment->first) &&
+			    (adapterList == localList.end() || adapterList->second.find(fragment->first) == adapterList->second.end()))
+			{
+				fragment = fragments.erase(fragment);
+				changed = true;
+			}
+			else
+			{
+				fragment++;
+			}
+		}
+
+		if (fragments.empty())
+			adapterFragments = mStatusFragments.erase(adapterFragments);
+		else
+			adapterFragments++;
+	}
+
+	return changed;
+}
+
+pbnjson::JValue HfpHFRole::buildStatusDevices(const HfpHFStatusFilter &filter)
+{
+	pbnjson::JValue devicesObj = pbnjson::Array();
+	for (auto &adapterFragments : mStatusFragments)
+	{
+		if (!isAdapterVisible(filter, adapterFragments.first))
+			continue;
+
+		for (auto &fragment : adapterFragments.second)
+		{
+			if (!filter.matchesDevice(fragment.first))
+				continue;
+
+			// v2 is built natively, v1 clients get it flattened
+			if (filter.getVersion() >= 2)
+				devicesObj.append(filter.project(fragment.second));
+			else
+				HfpHFStatusFilter::flatten(filter.project(fragment.second), devicesObj);
+		}
 	}
+	return devicesObj;
+}
+
+std::string HfpHFRole::getStatusContent(const HfpHFStatusFilter &filter)
+{
+	// Everything of a payload but its version
+	std::string content = buildStatusDevices(filter).stringify();
+	return mStatusStale ? "stale " + content : content;
+}
+
+pbnjson::JValue HfpHFRole::buildStatusPayload(const HfpHFStatusFilter &filter, bool subscribed)
+{
 	pbnjson::JValue responseObj = pbnjson::Object();
-	responseObj.put("audioGateways", devicesObj);
+	if (filter.getVersion() >= 2)
+		responseObj.put("version", filter.getVersion());
+	responseObj.put("statusVersion", (int64_t) mStatusVersion);
+	if (mStatusStale)
+		responseObj.put("stale", true);
+	responseObj.put("audioGateways", buildStatusDevices(filter));
 	responseObj.put("returnValue", true);
 	responseObj.put("subscribed", subscribed);
-
-	if (subscribed)
-		LSUtils::postToSubscriptionPoint(mGetStatusSubscription, responseObj);
-	else
-		LSUtils::postToClient(request, responseObj);
+	return responseObj;
 }
 
 void HfpHFRole::setVolumeToAudio(const std::string &remoteAddr)
@@ -1607,80 +2411,42 @@ void HfpHFRole::setVolumeToAudio(const std::string &remoteAddr, const std::strin
 	LSCallOneReply(mLSHandle, lscall.c_str(), payload.c_str(), nullptr, nullptr, nullptr, nullptr);
 }
 
-void HfpHFRole::buildGetStatusResp(const std::string &remoteAddr, const HfpDeviceInfo &localDevice, const std::string &adapterAddr, pbnjson::JValue &AGObj)
+pbnjson::JValue HfpHFRole::buildGetStatusResp(const std::string &remoteAddr, const HfpDeviceInfo &localDevice, const std::string &adapterAddr)
 {
-
-	auto printDeviceStatus = [&](pbnjson::JValue &resObj, const std::string &addr, const HfpDeviceInfo &device){
-		resObj.put("address", addr);
-		resObj.put("adapterAddress", adapterAddr);
-		resObj.put("signal", device.getDeviceStatus(CIND::DeviceStatus::SIGNAL));
-		resObj.put("battery", device.getDeviceStatus(CIND::DeviceStatus::BATTCHG));
-		bool scoStatus = false;
-		if (device.getAudioStatus(SCO::DeviceStatus::CONNECTED) ==  HFGeneral::Status::STATUSTRUE)
-			scoStatus = true;
-		resObj.put("sco", scoStatus);
-		resObj.put("volume", device.getAudioStatus(SCO::DeviceStatus::VOLUME));
-		resObj.put("ring",device.getRING());
-		resObj.put("operatorName",device.getNetworkOperatorName());
-		resObj.put("networkStatus",device.getNetworkRegistrationStatus());
-	};
-
+	pbnjson::JValue callsObj = pbnjson::Array();
 	for (auto iterCallStatus : localDevice.getCallStatusList())
 	{
-		pbnjson::JValue responseObj = pbnjson::Object();
-		responseObj.put("number", iterCallStatus.first);
-		responseObj.put("callStatus", iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::STATUS));
-		responseObj.put("direction", iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::DIRECTION));
+		pbnjson::JValue callObj = pbnjson::Object();
+		callObj.put("number", iterCallStatus.first);
+		callObj.put("callStatus", iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::STATUS));
+		callObj.put("direction", iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::DIRECTION));
 		if (!iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::INDEX).empty())
 		{
-			responseObj.put("index", std::stoi(iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::INDEX)));
+			callObj.put("index", std::stoi(iterCallStatus.second->getCallStatus(CLCC::DeviceStatus::INDEX)));
 		}
 		else
 		{
 			BT_DEBUG("Index is empty!!");
-			responseObj.put("index", 0);
+			callObj.put("index", 0);
 		}
-
-		printDeviceStatus(responseObj, remoteAddr, localDevice);
-		AGObj.append(responseObj);
+		callsObj.append(callObj);
 	}
-	if (localDevice.getCallStatusList().empty())
-	{
-		pbnjson::JValue responseObj = pbnjson::Object();
-		printDeviceStatus(responseObj, remoteAddr, localDevice);
-		AGObj.append(responseObj);
-	}
-}
-
-int HfpHFRole::findContextIndex(HFLS2::APIName apiName)
-{
-	for (int i = 0; i < mContextList.size(); i++)
-	{
-		if (std::get<HFLS2::ContextData::APINAME>(*mContextList[i]) == apiName)
-			return i;
-	}
-	return HFLS2::INVALIDINDEX;
-}
 
-int HfpHFRole::findContextIndex(const std::string &remoteAddr)
-{
-	for (int i = 0; i < mContextList.size(); i++)
-	{
-		if (std::get<HFLS2::ContextData::ADDRESS>(*mContextList[i]).compare(remoteAddr) == 0)
-			return i;
-	}
-	return HFLS2::INVALIDINDEX;
-}
-
-int HfpHFRole::findScoContextIndex(const std::string &remoteAddr, const std::string &adapterAddr)
-{
-	for (int i = 0; i < mScoContextList.size(); i++)
-	{
-		if ((std::get<HFLS2::ScoContextData::REMOTEADDRESS>(*mScoContextList[i]).compare(remoteAddr) == 0)&&
-			(std::get<HFLS2::ScoContextData::ADAPTERADDRESS>(*mScoContextList[i]).compare(adapterAddr) == 0))
-			return i;
-	}
-	return HFLS2::INVALIDINDEX;
+	pbnjson::JValue AGObj = pbnjson::Object();
+	AGObj.put("address", remoteAddr);
+	AGObj.put("adapterAddress", adapterAddr);
+	AGObj.put("signal", localDevice.getDeviceStatus(CIND::DeviceStatus::SIGNAL));
+	AGObj.put("battery", localDevice.getDeviceStatus(CIND::DeviceStatus::BATTCHG));
+	bool scoStatus = false;
+	if (localDevice.getAudioStatus(SCO::DeviceStatus::CONNECTED) ==  HFGeneral::Status::STATUSTRUE)
+		scoStatus = true;
+	AGObj.put("sco", scoStatus);
+	AGObj.put("volume", localDevice.getAudioStatus(SCO::DeviceStatus::VOLUME));
+	AGObj.put("ring", localDevice.getRING());
+	AGObj.put("operatorName", localDevice.getNetworkOperatorName());
+	AGObj.put("networkStatus", localDevice.getNetworkRegistrationStatus());
+	AGObj.put("calls", callsObj);
+	return AGObj;
 }
 
 std::string HfpHFRole::getDefaultAdapterAddress() const
@@ -17,24 +17,53 @@
 #ifndef HFPHFROLE_H_
 #define HFPHFROLE_H_
 
+#include <set>
 #include <unordered_map>
-#include <tuple>
+#include <unordered_set>
 
 #include "hfprole.h"
 #include "hfphfls2call.h"
 #include "hfphfdevicestatus.h"
+#include "hfphfcontexttable.h"
+#include "hfphfpendingrequests.h"
+#include "hfphfstatusfilter.h"
+#include "hfphfstatussubscribers.h"
+#include "hfphfstatusstore.h"
+#include "hfphfcallhistory.h"
 #include "dbusutils.h"
+#include "sessionresolver.h"
 #include "ls2utils.h"
 
 class HfpDeviceInfo;
 class HfpHFDeviceStatus;
 class HfpHFLS2Data;
+class HfpHFReplyParser;
+class HfpHciCommand;
 class HfpHFSubscribe;
 class HfpHFRole;
 class HfpOfonoManager;
 
-using LSContext = std::tuple<HFLS2::APIName, std::string, HfpHFRole*, LSMessageToken>;
-using LSScoContext = std::tuple<HFLS2::APIName, std::string, std::string , HfpHFRole*, LSMessageToken>;
+namespace HFReply
+{
+	struct DeviceStatus;
+}
+
+using DeviceFingerprintMap = std::unordered_map<std::string, bool>; // remote address to HFP_AG connected
+
+static const size_t MAXSTATUSSNAPSHOTS = 32;
+static const gint64 MAXSTATUSDEFERMS = 250;
+static const guint MAXSTATUSSTALESEC = 10;
+static const guint MAXSCORETRYSEC = 32;
+static const size_t MAXCALLHISTORYPAGE = 50;
+
+// getStatus subscribers sharing one filter
+struct StatusSubscription
+{
+	HfpHFStatusFilter filter;
+	HfpHFStatusSubscribers *subscribers = nullptr;
+	bool pending = false;
+	std::string postedContent; //projected status last posted, without its version
+};
 
 
 class HfpHFRole : public HfpRole
@@ -54,17 +83,24 @@ public:
 	bool setVolume(LSMessage &message);
 	bool call(LSMessage &message);
 	bool setVoiceRecognition(LSMessage &message);
+	bool getCallHistory(LSMessage &message);
+	bool deleteCallHistory(LSMessage &message);
+	pbnjson::JValue getLoopStatus() const;
 
 	bool sendCLCC(const std::string &remoteAddr);
 	void sendNREC(const std::string &remoteAddr);
 	void sendResponseToClient(const std::string &remoteAddr, bool returnValue);
 	void notifySubscribersStatusChanged(bool subscribed);
+	void notifySubscribersStatusChanged(bool subscribed, const std::string &adapterAddr, const std::string &remoteAddr = "");
+	void flushStatusChanges();
+	void recordCallHistory(const std::string &remoteAddr, const std::string &adapterAddr, const std::string &phoneNumber,
+	                       const HfpHFCallStatus &callStatus);
 	void setVolumeToAudio(const std::string &remoteAddr);
 	void setVolumeToAudio(const std::string &remoteAddr, const std::string &adapterAddress);
 	void handleAdapterGetStatus(LSMessage* reply);
 	void handleGetStatus(LSMessage* reply, const std::string &adapterAddr);
 	void handleReceiveResult(LSMessage* reply);
-	void handleGetSCOStatus(LSMessage* reply, const std::string &remoteAddr);
+	void handleGetSCOStatus(LSMessage* reply, const std::string &adapterAddr, const std::string &remoteAddr);
 	void subscribeService();
 	void unsubscribeServiceAll();
 	void unsubscribeScoServicebyAdapterAddress(const std::string &adapterAddr);
@@ -72,18 +108,42 @@ public:
 	std::unordered_map<std::string ,std::string> & getAdapterMap() { return mAdapterInterfaceMap; }
 
 private:
-	void buildGetStatusResp(const std::string &remoteAddr, const HfpDeviceInfo &localDevice, const std::string &adapterAddr, pbnjson::JValue &AGObj);
-	void notifySubscribersStatusChanged(bool subscribed, LS::Message &request);
+	pbnjson::JValue buildGetStatusResp(const std::string &remoteAddr, const HfpDeviceInfo &localDevice, const std::string &adapterAddr);
+	int getStatusScope(LSMessage &message);
+	bool isAdapterVisible(const HfpHFStatusFilter &filter, const std::string &adapterAddr) const;
+	static gboolean handleDeviceStatusDispatch(gpointer userData);
+	void applyDeviceStatus(LS::Message &replyMsg, const std::string &adapterAddr);
+	static gboolean handleStatusFlush(gpointer userData);
+	static gboolean handleStatusBackstop(gpointer userData);
+	static gboolean handleStatusPrune(gpointer userData);
+	void pruneStatusSubscriptions();
+	void markStatusDirty(const std::string &adapterAddr, const std::string &remoteAddr);
+	void refreshStatus();
+	bool updateStatusFragment(const std::string &adapterAddr, const std::string &remoteAddr);
+	const std::string& getStatusSnapshot(const HfpHFStatusFilter &filter, bool subscribed);
+	pbnjson::JValue buildStatusDevices(const HfpHFStatusFilter &filter);
+	std::string getStatusContent(const HfpHFStatusFilter &filter);
+	pbnjson::JValue buildStatusPayload(const HfpHFStatusFilter &filter, bool subscribed);
+	void loadStoredStatus();
+	void endStaleStatus(const std::string &adapterAddr);
+	static gboolean handleStaleTimeout(gpointer userData);
 
+	bool callService(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &lunaCmd,
+	                 const std::string &payload, LSFilterFunc callback);
+	bool callService(HFLS2::APIName apiName, const std::string &adapterAddr, const std::string &remoteAddr,
+	                 const std::string &lunaCmd, const std::string &payload, LSFilterFunc callback);
 	void unsubscribeService(HFLS2::APIName apiName);
-	void unsubscribeService(const std::string &remoteAddr);
-	void unsubscribeService(int index);
-	void unsubscribeScoService(const std::string &remoteAddr, const std::string &adapterAddr);
-	void subscribeGetSCOStatus(const std::string &remoteAddr, const std::string& adapterAddress, bool connected);
+	void unsubscribeService(const std::string &adapterAddr);
+	void unsubscribeService(HfpHFContextTable::Handle handle);
+	bool subscribeGetSCOStatus(const std::string &remoteAddr, const std::string& adapterAddress, bool connected);
+	bool subscribeSCOStatus(const std::string &adapterAddr);
+	void fallBackToDeviceSCOStatus(const std::string &adapterAddr);
+	void scheduleSCOStatusRetry();
+	static gboolean handleSCOStatusRetry(gpointer userData);
 	void subscribeGetDeviceStatus(const std::string &adapterAddr, bool available);
-	int findContextIndex(HFLS2::APIName apiName);
-	int findContextIndex(const std::string &remoteAddr);
-	int findScoContextIndex(const std::string &remoteAddr, const std::string &adapterAddr);
+	void enableScoRouting(const std::string &interfaceName);
+	void updatePairedDevices(const std::string &adapterAddr, const HFReply::DeviceStatus &deviceStatus);
+	bool updateDeviceConnection(const std::string &remoteAddr, const std::string &adapterAddr, bool connected);
 	bool handleSendAT(const std::string &remoteAddr, const std::string &type, const std::string &command, const std::string &arguments);
 	bool handleSendAT(const std::string &remoteAddr, const std::string &type, const std::string &command);
 	bool parseLSMessage(LSMessage &message, const HfpHFLS2Data &ls2Data, std::string &remoteAddr, LS2Result &result, bool isSubscribeFunc, bool isMultiAdapterSupport = false);
@@ -98,18 +158,46 @@ private:
 #endif
 
 private:
-	LS::SubscriptionPoint* mGetStatusSubscription;
+	std::unordered_map<std::string, StatusSubscription> mGetStatusSubscriptions; //filter key to subscribers
+	StatusFragmentMap mStatusFragments;
+	std::unordered_map<std::string, std::unordered_set<std::string>> mStaleFragments; //adapter address to AGs only known from the stored status
+	HfpHFStatusStore mStatusStore;
+	HfpHFCallHistory mCallHistory;
 	LSHandle* mLSHandle;
-	std::unordered_map<std::string, LS::Message> mResponseMessage;
+	HfpHFPendingRequests mPendingRequests;
 	HfpHFDeviceStatus* mHFDevice;
 	HfpHFSubscribe* mHFSubscribe;
 	HfpHFLS2Call* mHFLS2Call;
-	std::vector<LSContext*> mContextList;
-	std::vector<LSScoContext*> mScoContextList;
+	HfpHFReplyParser* mHFReplyParser;
+	HfpHciCommand* mHciCommand;
+	HfpHFContextTable* mContextTable;
+	std::unordered_map<std::string, std::unordered_set<std::string>> mScoRemoteMap; //adapter address to AGs tracked for SCO
+	std::unordered_set<std::string> mScoPerDeviceAdapters; //adapters whose hfp/getStatus is subscribed per AG
+	guint mScoRetrySource;
+	guint mScoRetrySec;
+	std::unordered_map<std::string, LS::Message> mPendingDeviceStatus; //adapter address to latest device/getStatus not applied yet
+	guint mDeviceStatusSource;
 	HfpOfonoManager *mHfpOfonoManager;
+	bool mOfonoAvailable;
 	DBusUtils::NameWatch mNameWatch;
 	std::unordered_map<std::string ,std::string> mAdapterMap; //address to name map
 	std::unordered_map<std::string ,std::string> mAdapterInterfaceMap; //address to interface map
+	std::unordered_map<std::string, DeviceFingerprintMap> mDeviceFingerprints; //adapter address to last device/getStatus
+	std::unordered_map<std::string, std::unordered_set<std::string>> mPairedDevices; //adapter address to devices paired in the last device/getStatus
+	unsigned long mSkippedDeviceEntries;
+	unsigned long mProcessedDeviceEntries;
+	unsigned long long mStatusVersion;
+	gint64 mStatusDirtySince;
+	guint mStatusFlushSource;
+	guint mStatusBackstopSource;
+	guint mStatusPruneSource;
+	bool mStatusStale;
+	guint mStaleTimeoutSource;
+	std::set<std::pair<std::string, std::string>> mDirtyStatus; //(adapter, remote) to rebuild, empty means all
+	std::unordered_map<std::string, std::pair<unsigned long long, std::string>> mStatusSnapshots; //filter key to serialized status
+#ifdef MULTI_SESSION_SUPPORT
+	SessionResolver* mSessionResolver;
+#endif
 };
 
 #endif
@@ -0,0 +1,149 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "hfphfstatusfilter.h"
+
+// Field names accepted in "fields", which are also the keys of a v2 AG object.
+// Kept in the order v1 has always put them into an entry, projected and
+// flattened objects are built walking this list
+static const std::vector<std::pair<std::string, unsigned int>> fieldNames =
+{
+	{"address", HfpHFStatusFilter::Field::ADDRESS},
+	{"adapterAddress", HfpHFStatusFilter::Field::ADAPTERADDRESS},
+	{"signal", HfpHFStatusFilter::Field::SIGNAL},
+	{"battery", HfpHFStatusFilter::Field::BATTERY},
+	{"sco", HfpHFStatusFilter::Field::SCO},
+	{"volume", HfpHFStatusFilter::Field::VOLUME},
+	{"ring", HfpHFStatusFilter::Field::RING},
+	{"operatorName", HfpHFStatusFilter::Field::OPERATORNAME},
+	{"networkStatus", HfpHFStatusFilter::Field::NETWORKSTATUS},
+	{"calls", HfpHFStatusFilter::Field::CALLS}
+};
+
+static std::string toLower(std::string address)
+{
+	std::transform(address.begin(), address.end(), address.begin(), ::tolower);
+	return address;
+}
+
+HfpHFStatusFilter::HfpHFStatusFilter(int scope) :
+	mScope(scope),
+	mFields(Field::ALLFIELDS),
+	mVersion(1)
+{
+}
+
+bool HfpHFStatusFilter::parse(const pbnjson::JValue &requestObj)
+{
+	if (requestObj.hasKey("version"))
+		mVersion = requestObj["version"].asNumber<int>();
+
+	pbnjson::JValue adapters = requestObj["adapters"];
+	if (adapters.isArray())
+	{
+		for (int i = 0; i < adapters.arraySize(); i++)
+			mAdapters.insert(toLower(adapters[i].asString()));
+	}
+
+	pbnjson::JValue devices = requestObj["devices"];
+	if (devices.isArray())
+	{
+		for (int i = 0; i < devices.arraySize(); i++)
+			mDevices.insert(toLower(devices[i].asString()));
+	}
+
+	pbnjson::JValue fields = requestObj["fields"];
+	if (fields.isArray())
+	{
+		mFields = 0;
+		for (int i = 0; i < fields.arraySize(); i++)
+		{
+			std::string name = fields[i].asString();
+			auto field = std::find_if(fieldNames.begin(), fieldNames.end(),
+			                          [&name](const std::pair<std::string, unsigned int> &entry) { return entry.first == name; });
+			if (field == fieldNames.end())
+				return false;
+			mFields |= field->second;
+		}
+		// Entries are always identified by their AG
+		mFields |= Field::ADDRESS;
+	}
+
+	return true;
+}
+
+std::string HfpHFStatusFilter::getKey() const
+{
+	std::string key = std::to_string(mScope) + "/v" + std::to_string(mVersion) + "/" + std::to_string(mFields) + "/";
+	for (auto &adapter : mAdapters)
+		key += adapter + ",";
+	key += "/";
+	for (auto &device : mDevices)
+		key += device + ",";
+	return key;
+}
+
+bool HfpHFStatusFilter::matchesAdapter(const std::string &adapterAddr) const
+{
+	return mAdapters.empty() || mAdapters.find(toLower(adapterAddr)) != mAdapters.end();
+}
+
+bool HfpHFStatusFilter::matchesDevice(const std::string &remoteAddr) const
+{
+	return mDevices.empty() || mDevices.find(toLower(remoteAddr)) != mDevices.end();
+}
+
+pbnjson::JValue HfpHFStatusFilter::project(const pbnjson::JValue &device) const
+{
+	if (mFields == Field::ALLFIELDS)
+		return device;
+
+	pbnjson::JValue projected = pbnjson::Object();
+	for (auto &field : fieldNames)
+	{
+		if ((mFields & field.second) && device.hasKey(field.first))
+			projected.put(field.first, device[field.first]);
+	}
+	return projected;
+}
+
+void HfpHFStatusFilter::flatten(const pbnjson::JValue &device, pbnjson::JValue &entries)
+{
+	// v1 repeats the AG fields in one entry per call, an AG without calls
+	// (or without "calls" in the field mask) is a single entry
+	auto appendEntry = [&device, &entries](pbnjson::JValue entry) {
+		for (auto &field : fieldNames)
+		{
+			if (field.second != Field::CALLS && device.hasKey(field.first))
+				entry.put(field.first, device[field.first]);
+		}
+		entries.append(entry);
+	};
+
+	pbnjson::JValue calls = device["calls"];
+	if (!calls.isArray() || calls.arraySize() == 0)
+	{
+		appendEntry(pbnjson::Object());
+		return;
+	}
+
+	for (int i = 0; i < calls.arraySize(); i++)
+		appendEntry(calls[i].duplicate());
+}
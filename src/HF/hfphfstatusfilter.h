@@ -0,0 +1,74 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHFSTATUSFILTER_H_
+#define HFPHFSTATUSFILTER_H_
+
+#include <set>
+#include <string>
+
+#include <pbnjson.hpp>
+
+// getStatus subscribers of the host, display sets use their index as scope
+static const int HOSTSTATUSSCOPE = -1;
+
+/*
+ * Server side selection of hf/getStatus content.
+ *
+ * A request may name the adapters and devices it is interested in, the
+ * fields it wants for every AG and the response version. Version 2 nests
+ * the calls of an AG under it, version 1 is derived from that by
+ * flattening. Subscribers with the same filter share a subscription
+ * point, keyed by getKey().
+ */
+class HfpHFStatusFilter
+{
+public:
+	enum Field
+	{
+		ADDRESS = 1 << 0,
+		ADAPTERADDRESS = 1 << 1,
+		SIGNAL = 1 << 2,
+		BATTERY = 1 << 3,
+		SCO = 1 << 4,
+		VOLUME = 1 << 5,
+		RING = 1 << 6,
+		OPERATORNAME = 1 << 7,
+		NETWORKSTATUS = 1 << 8,
+		CALLS = 1 << 9,
+		ALLFIELDS = (1 << 10) - 1
+	};
+
+	HfpHFStatusFilter(int scope = HOSTSTATUSSCOPE);
+
+	bool parse(const pbnjson::JValue &requestObj);
+	std::string getKey() const;
+	int getScope() const { return mScope; }
+	int getVersion() const { return mVersion; }
+	bool matchesAdapter(const std::string &adapterAddr) const;
+	bool matchesDevice(const std::string &remoteAddr) const;
+	pbnjson::JValue project(const pbnjson::JValue &device) const;
+	static void flatten(const pbnjson::JValue &device, pbnjson::JValue &entries);
+
+private:
+	int mScope;
+	std::set<std::string> mAdapters;
+	std::set<std::string> mDevices;
+	unsigned int mFields;
+	int mVersion;
+};
+
+#endif //HFPHFSTATUSFILTER_H_
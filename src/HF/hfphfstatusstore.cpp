@@ -0,0 +1,237 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <string.h>
+
+#include "hfphfstatusstore.h"
+#include "logging.h"
+
+#define STATUS_STORE_MAGIC 0x53504648 //"HFPS"
+#define STATUS_STORE_FORMAT 1
+#define STATUS_STORE_SIZE (64 * 1024)
+
+static uint32_t checksum(const unsigned char *data, size_t length)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+namespace
+{
+
+class Reader
+{
+public:
+	Reader(const unsigned char *data, size_t length) : mData(data), mLength(length), mPos(0), mValid(true) { }
+
+	bool isValid() const { return mValid; }
+
+	uint8_t getByte()
+	{
+		if (mPos + 1 > mLength)
+		{
+			mValid = false;
+			return 0;
+		}
+		return mData[mPos++];
+	}
+
+	uint16_t getShort()
+	{
+		uint16_t value = getByte();
+		return value | (getByte() << 8);
+	}
+
+	std::string getString()
+	{
+		size_t length = getByte();
+		if (mPos + length > mLength)
+		{
+			mValid = false;
+			return std::string();
+		}
+		std::string value(reinterpret_cast<const char*>(mData + mPos), length);
+		mPos += length;
+		return value;
+	}
+
+private:
+	const unsigned char *mData;
+	size_t mLength;
+	size_t mPos;
+	bool mValid;
+};
+
+}
+
+HfpHFStatusStore::HfpHFStatusStore() :
+	mFile("status.snapshot", STATUS_STORE_SIZE),
+	mSaves(0),
+	mOversized(0)
+{
+}
+
+void HfpHFStatusStore::putString(const std::string &value)
+{
+	// Addresses, numbers and states all fit, operator names are cut short
+	size_t length = std::min(value.size(), (size_t) 255);
+	mBuffer.push_back((char) length);
+	mBuffer.append(value, 0, length);
+}
+
+void HfpHFStatusStore::encode(const pbnjson::JValue &AGObj)
+{
+	putString(AGObj["address"].asString());
+	putString(AGObj["adapterAddress"].asString());
+	mBuffer.push_back((char) AGObj["signal"].asNumber<int32_t>());
+	mBuffer.push_back((char) AGObj["battery"].asNumber<int32_t>());
+	mBuffer.push_back((char) AGObj["volume"].asNumber<int32_t>());
+	mBuffer.push_back((char) ((AGObj["sco"].asBool() ? 1 : 0) | (AGObj["ring"].asBool() ? 2 : 0)));
+	putString(AGObj["operatorName"].asString());
+	putString(AGObj["networkStatus"].asString());
+
+	pbnjson::JValue callsObj = AGObj["calls"];
+	size_t callCount = callsObj.arraySize();
+	if (callCount > 255)
+		callCount = 255;
+	mBuffer.push_back((char) callCount);
+	for (size_t i = 0; i < callCount; i++)
+	{
+		pbnjson::JValue callObj = callsObj[i];
+		putString(callObj["number"].asString());
+		putString(callObj["callStatus"].asString());
+		putString(callObj["direction"].asString());
+		uint16_t index = (uint16_t) callObj["index"].asNumber<int32_t>();
+		mBuffer.push_back((char) (index & 0xff));
+		mBuffer.push_back((char) (index >> 8));
+	}
+}
+
+void HfpHFStatusStore::save(const StatusFragmentMap &fragments, unsigned long long version)
+{
+	if (!mFile.isOpen())
+		return;
+
+	mBuffer.clear();
+	uint16_t count = 0;
+	mBuffer.append(2, '\0');
+	for (auto &adapterFragments : fragments)
+	{
+		for (auto &fragment : adapterFragments.second)
+		{
+			encode(fragment.second);
+			count++;
+		}
+	}
+	mBuffer[0] = (char) (count & 0xff);
+	mBuffer[1] = (char) (count >> 8);
+
+	if (mBuffer.size() > mFile.getSize() - sizeof(Header))
+	{
+		// Better no snapshot than a partial one
+		if (!mOversized++)
+			BT_WARNING("MSGID_STATUS_STORE_OVERSIZED", 0, "Status of %u AGs takes %zu bytes, not stored", count, mBuffer.size());
+		return;
+	}
+
+	Header *header = reinterpret_cast<Header*>(mFile.getData());
+	uint32_t sequence = header->magic == STATUS_STORE_MAGIC ? header->sequence : 0;
+
+	header->sequence = sequence | 1;
+	__sync_synchronize();
+	memcpy(mFile.getData() + sizeof(Header), mBuffer.data(), mBuffer.size());
+	header->magic = STATUS_STORE_MAGIC;
+	header->format = STATUS_STORE_FORMAT;
+	header->headerSize = sizeof(Header);
+	header->length = mBuffer.size();
+	header->checksum = checksum(reinterpret_cast<const unsigned char*>(mBuffer.data()), mBuffer.size());
+	header->statusVersion = version;
+	__sync_synchronize();
+	header->sequence = (sequence | 1) + 1;
+
+	mFile.markDirty();
+	mSaves++;
+	BT_DEBUG("Stored status version %llu, %u AGs in %zu bytes, %lu saves", version, count, mBuffer.size(), mSaves);
+}
+
+bool HfpHFStatusStore::load(StatusFragmentMap &fragments, unsigned long long &version)
+{
+	if (!mFile.isOpen() || mFile.isCreated())
+		return false;
+
+	const Header *header = reinterpret_cast<const Header*>(mFile.getData());
+	if (header->magic != STATUS_STORE_MAGIC || header->format != STATUS_STORE_FORMAT ||
+	    header->headerSize != sizeof(Header) || header->length > mFile.getSize() - sizeof(Header))
+		return false;
+
+	const unsigned char *payload = mFile.getData() + sizeof(Header);
+	if ((header->sequence & 1) || checksum(payload, header->length) != header->checksum)
+	{
+		BT_WARNING("MSGID_STATUS_STORE_CORRUPT", 0, "Dropping incomplete status snapshot in %s", mFile.getPath().c_str());
+		return false;
+	}
+
+	Reader reader(payload, header->length);
+	uint16_t count = reader.getShort();
+	StatusFragmentMap loaded;
+	for (uint16_t i = 0; i < count && reader.isValid(); i++)
+	{
+		std::string address = reader.getString();
+		std::string adapterAddress = reader.getString();
+
+		pbnjson::JValue AGObj = pbnjson::Object();
+		AGObj.put("address", address);
+		AGObj.put("adapterAddress", adapterAddress);
+		AGObj.put("signal", (int32_t) (int8_t) reader.getByte());
+		AGObj.put("battery", (int32_t) (int8_t) reader.getByte());
+		int32_t volume = (int8_t) reader.getByte();
+		uint8_t flags = reader.getByte();
+		AGObj.put("sco", (flags & 1) != 0);
+		AGObj.put("volume", volume);
+		AGObj.put("ring", (flags & 2) != 0);
+		AGObj.put("operatorName", reader.getString());
+		AGObj.put("networkStatus", reader.getString());
+
+		pbnjson::JValue callsObj = pbnjson::Array();
+		uint8_t callCount = reader.getByte();
+		for (uint8_t j = 0; j < callCount && reader.isValid(); j++)
+		{
+			pbnjson::JValue callObj = pbnjson::Object();
+			callObj.put("number", reader.getString());
+			callObj.put("callStatus", reader.getString());
+			callObj.put("direction", reader.getString());
+			callObj.put("index", (int32_t) reader.getShort());
+			callsObj.append(callObj);
+		}
+		AGObj.put("calls", callsObj);
+
+		loaded[adapterAddress][address] = AGObj;
+	}
+
+	if (!reader.isValid())
+		return false;
+
+	fragments.swap(loaded);
+	version = header->statusVersion;
+	return true;
+}
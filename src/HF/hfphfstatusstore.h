@@ -0,0 +1,70 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHFSTATUSSTORE_H_
+#define HFPHFSTATUSSTORE_H_
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include <pbnjson.hpp>
+
+#include "mappedfile.h"
+
+typedef std::unordered_map<std::string, std::unordered_map<std::string, pbnjson::JValue>> StatusFragmentMap; //adapter address to AG entries by remote address
+
+/*
+ * The last committed getStatus state, kept in a mapped file so that a
+ * restarted service has something to answer with before bluetooth2 and
+ * oFono have reported again.
+ *
+ * AG entries are packed into a compact binary record behind a header with
+ * a sequence number and a checksum. The sequence is odd while a record is
+ * written, so a record torn by a crash is never loaded.
+ */
+class HfpHFStatusStore
+{
+public:
+	HfpHFStatusStore();
+
+	bool isOpen() const { return mFile.isOpen(); }
+	bool load(StatusFragmentMap &fragments, unsigned long long &version);
+	void save(const StatusFragmentMap &fragments, unsigned long long version);
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint16_t format;
+		uint16_t headerSize;
+		uint32_t sequence;
+		uint32_t length;
+		uint32_t checksum;
+		uint32_t reserved;
+		uint64_t statusVersion;
+	};
+
+	void encode(const pbnjson::JValue &AGObj);
+	void putString(const std::string &value);
+
+	MappedFile mFile;
+	std::string mBuffer;
+	unsigned long mSaves;
+	unsigned long mOversized;
+};
+
+#endif //HFPHFSTATUSSTORE_H_
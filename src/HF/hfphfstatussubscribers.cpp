@@ -0,0 +1,277 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+
+#include "hfphfstatussubscribers.h"
+#include "ls2utils.h"
+#include "logging.h"
+
+#define MAX_BACKOFF_MS 5000
+#define MAXUNACKEDSENDS 8
+
+static std::string getSender(const LS::Message &message)
+{
+	const char *sender = LSMessageGetSender(message.get());
+	return sender ? sender : "";
+}
+
+static std::string getSenderName(const LS::Message &message)
+{
+	const char *name = LSMessageGetSenderServiceName(message.get());
+	if (name == nullptr)
+		name = LSMessageGetApplicationID(message.get());
+	if (name == nullptr)
+		name = LSMessageGetSender(message.get());
+	return name ? name : "";
+}
+
+HfpHFStatusSubscribers::HfpHFStatusSubscribers(LSHandle *handle, PayloadFunc payloadFunc, unsigned int intervalMs,
+                                               unsigned long long resyncThreshold) :
+	mLSHandle(handle),
+	mPayloadFunc(payloadFunc),
+	mIntervalMs(intervalMs),
+	mResyncThreshold(resyncThreshold),
+	mFlushSource(0)
+{
+	LSError lserror;
+	LSErrorInit(&lserror);
+	if (!LSCallCancelNotificationAdd(mLSHandle, handleCancel, this, &lserror))
+	{
+		BT_ERROR("MSGID_SUBSCRIPTION_CANCEL_NOTIFICATION_FAILED", 0, "Failed to watch cancelled subscriptions: %s", lserror.message);
+		LSErrorFree(&lserror);
+	}
+}
+
+HfpHFStatusSubscribers::~HfpHFStatusSubscribers()
+{
+	if (mFlushSource)
+		g_source_remove(mFlushSource);
+
+	LSCallCancelNotificationRemove(mLSHandle, handleCancel, this, nullptr);
+}
+
+void HfpHFStatusSubscribers::subscribe(LS::Message &request, unsigned long long version, bool acknowledged)
+{
+	const char *token = LSMessageGetUniqueToken(request.get());
+	if (token == nullptr)
+		return;
+
+	gint64 now = g_get_monotonic_time();
+	mSubscribers[token] = {request, version, version, 0, 0, now + mIntervalMs * 1000, 0, acknowledged, version, 0, false,
+	                       0, 0, 0, 0, 0};
+}
+
+void HfpHFStatusSubscribers::acknowledge(LS::Message &request, unsigned long long version)
+{
+	std::string sender = getSender(request);
+	bool resumed = false;
+	for (auto &iter : mSubscribers)
+	{
+		Subscriber &subscriber = iter.second;
+		if (!subscriber.acknowledged || getSender(subscriber.message) != sender)
+			continue;
+
+		if (version > subscriber.ackedVersion)
+			subscriber.ackedVersion = version;
+		subscriber.unacked = 0;
+		if (subscriber.paused)
+		{
+			BT_INFO("INFO_STATUS_RESUMED", 0, "Resuming status for %s at version %llu",
+			        getSenderName(subscriber.message).c_str(), version);
+			subscriber.paused = false;
+			resumed = true;
+		}
+	}
+
+	if (resumed)
+		flush();
+}
+
+void HfpHFStatusSubscribers::post(unsigned long long version)
+{
+	gint64 now = g_get_monotonic_time();
+	for (auto &iter : mSubscribers)
+	{
+		Subscriber &subscriber = iter.second;
+		if (subscriber.sentVersion >= version)
+			continue;
+
+		// Latest value wins, a version that was not sent yet is replaced
+		if (subscriber.pendingSince)
+			subscriber.collapsed++;
+		else
+			subscriber.pendingSince = now;
+		subscriber.pendingVersion = version;
+		subscriber.unsentPosts++;
+	}
+
+	flush();
+}
+
+pbnjson::JValue HfpHFStatusSubscribers::getMetrics() const
+{
+	gint64 now = g_get_monotonic_time();
+	pbnjson::JValue subscribersObj = pbnjson::Array();
+	for (auto &iter : mSubscribers)
+	{
+		const Subscriber &subscriber = iter.second;
+		pbnjson::JValue subscriberObj = pbnjson::Object();
+		subscriberObj.put("sender", getSenderName(subscriber.message));
+		subscriberObj.put("sent", (int64_t) subscriber.sent);
+		subscriberObj.put("collapsed", (int64_t) subscriber.collapsed);
+		subscriberObj.put("resyncs", (int64_t) subscriber.resyncs);
+		subscriberObj.put("failures", (int64_t) subscriber.failures);
+		if (subscriber.acknowledged)
+		{
+			subscriberObj.put("ackedVersion", (int64_t) subscriber.ackedVersion);
+			subscriberObj.put("unacked", (int64_t) subscriber.unacked);
+			subscriberObj.put("paused", subscriber.paused);
+		}
+		subscriberObj.put("postsBehind", (int64_t) subscriber.unsentPosts);
+		subscriberObj.put("lagMs", (int64_t) (subscriber.pendingSince ? (now - subscriber.pendingSince) / 1000 : 0));
+		subscriberObj.put("maxLagMs", (int64_t) subscriber.maxLagMs);
+		subscribersObj.append(subscriberObj);
+	}
+	return subscribersObj;
+}
+
+void HfpHFStatusSubscribers::flush()
+{
+	gint64 now = g_get_monotonic_time();
+	gint64 nextFlush = 0;
+	for (auto &iter : mSubscribers)
+	{
+		Subscriber &subscriber = iter.second;
+		if (!subscriber.pendingSince || subscriber.paused)
+			continue;
+
+		// Nothing more goes to a client that does not read what it gets
+		if (subscriber.acknowledged && subscriber.unacked >= MAXUNACKEDSENDS)
+		{
+			BT_WARNING("MSGID_STATUS_SUBSCRIBER_STALLED", 0, "Pausing status for %s: %u sends since version %llu",
+			           getSenderName(subscriber.message).c_str(), subscriber.unacked, subscriber.ackedVersion);
+			subscriber.paused = true;
+			continue;
+		}
+
+		if (now >= subscriber.nextSend && send(subscriber, now))
+			continue;
+
+		if (!nextFlush || subscriber.nextSend < nextFlush)
+			nextFlush = subscriber.nextSend;
+	}
+
+	if (nextFlush)
+		scheduleFlush(nextFlush - now);
+}
+
+bool HfpHFStatusSubscribers::send(Subscriber &subscriber, gint64 now)
+{
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	// A subscriber that fell behind is told to resync rather than being
+	// walked through the states it missed. The global version also moves
+	// for changes outside its filter, so only what was posted to it counts
+	unsigned long long behind = subscriber.unsentPosts;
+	bool resync = behind > mResyncThreshold || subscriber.backoffMs > 0;
+	bool sent = true;
+	if (resync)
+	{
+		pbnjson::JValue markerObj = pbnjson::Object();
+		markerObj.put("returnValue", true);
+		markerObj.put("subscribed", true);
+		markerObj.put("resync", true);
+		markerObj.put("statusVersion", (int64_t) subscriber.pendingVersion);
+		std::string marker;
+		LSUtils::generatePayload(markerObj, marker);
+		sent = LSMessageRespond(subscriber.message.get(), marker.c_str(), &lserror);
+	}
+
+	if (sent)
+		sent = LSMessageRespond(subscriber.message.get(), mPayloadFunc().c_str(), &lserror);
+
+	if (!sent)
+	{
+		subscriber.failures++;
+		subscriber.backoffMs = subscriber.backoffMs ? std::min(subscriber.backoffMs * 2, (unsigned int) MAX_BACKOFF_MS) : mIntervalMs * 2;
+		subscriber.nextSend = now + subscriber.backoffMs * 1000;
+		BT_ERROR("MSGID_STATUS_DELIVERY_FAILED", 0, "Failed to post status to %s, retrying in %u ms: %s",
+		         getSenderName(subscriber.message).c_str(), subscriber.backoffMs, lserror.message);
+		LSErrorFree(&lserror);
+		return false;
+	}
+
+	gint64 lagMs = (now - subscriber.pendingSince) / 1000;
+	if (lagMs > subscriber.maxLagMs)
+		subscriber.maxLagMs = lagMs;
+	if (resync)
+	{
+		subscriber.resyncs++;
+		BT_INFO("INFO_STATUS_RESYNC", 0, "Resync %s: %llu posts behind, lag %lld ms, %lu collapsed, %lu failures",
+		        getSenderName(subscriber.message).c_str(), behind, (long long) lagMs, subscriber.collapsed, subscriber.failures);
+	}
+
+	subscriber.sent++;
+	if (subscriber.acknowledged)
+		subscriber.unacked++;
+	subscriber.sentVersion = subscriber.pendingVersion;
+	subscriber.unsentPosts = 0;
+	subscriber.pendingSince = 0;
+	subscriber.backoffMs = 0;
+	subscriber.nextSend = now + mIntervalMs * 1000;
+	return true;
+}
+
+void HfpHFStatusSubscribers::scheduleFlush(gint64 delayUs)
+{
+	if (mFlushSource)
+		g_source_remove(mFlushSource);
+
+	mFlushSource = g_timeout_add(delayUs > 0 ? (delayUs + 999) / 1000 : 0, handleFlush, this);
+}
+
+gboolean HfpHFStatusSubscribers::handleFlush(gpointer userData)
+{
+	HfpHFStatusSubscribers *subscribers = static_cast<HfpHFStatusSubscribers*>(userData);
+
+	subscribers->mFlushSource = 0;
+	subscribers->flush();
+	return FALSE;
+}
+
+bool HfpHFStatusSubscribers::handleCancel(LSHandle *handle, const char *uniqueToken, void *context)
+{
+	HfpHFStatusSubscribers *subscribers = static_cast<HfpHFStatusSubscribers*>(context);
+	if (subscribers == nullptr || uniqueToken == nullptr)
+		return true;
+
+	auto iter = subscribers->mSubscribers.find(uniqueToken);
+	if (iter == subscribers->mSubscribers.end())
+		return true;
+
+	Subscriber &subscriber = iter->second;
+	BT_DEBUG("Subscriber %s gone: %lu sent, %lu collapsed, %lu resyncs, %lu failures, max lag %lld ms",
+	         getSenderName(subscriber.message).c_str(), subscriber.sent, subscriber.collapsed,
+	         subscriber.resyncs, subscriber.failures, (long long) subscriber.maxLagMs);
+	subscribers->mSubscribers.erase(iter);
+
+	// Last thing done here, the callee may release the subscribers
+	if (subscribers->mSubscribers.empty() && subscribers->mEmptyFunc)
+		subscribers->mEmptyFunc();
+	return true;
+}
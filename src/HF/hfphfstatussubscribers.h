@@ -0,0 +1,99 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPHFSTATUSSUBSCRIBERS_H_
+#define HFPHFSTATUSSUBSCRIBERS_H_
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <glib.h>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.hpp>
+
+/*
+ * getStatus subscribers of one filter, with delivery tracked per subscriber.
+ *
+ * A subscriber is handed at most one payload per interval. Versions posted
+ * in between collapse into the latest one, which is fetched only when it is
+ * sent, so nothing but a version number is queued per subscriber. When more
+ * than the resync threshold of posts to a subscriber were collapsed, or a
+ * response to it fails and it is backed off, it gets a resync marker ahead
+ * of the latest payload to tell it that intermediate states were dropped.
+ * Only posts count, versions changing what the filter does not show do not
+ * put a subscriber behind.
+ *
+ * A posted response only says that the bus took it, not that the client
+ * read it. A subscriber that subscribed with sinceVersion acknowledges what
+ * it has read by calling again with sinceVersion, and is paused after
+ * MAXUNACKEDSENDS payloads without one, so a stalled client stops being
+ * fed and shows up as paused in the metrics.
+ */
+class HfpHFStatusSubscribers
+{
+public:
+	typedef std::function<const std::string&()> PayloadFunc;
+	typedef std::function<void()> EmptyFunc;
+
+	HfpHFStatusSubscribers(LSHandle *handle, PayloadFunc payloadFunc, unsigned int intervalMs = 100,
+	                       unsigned long long resyncThreshold = 16);
+	~HfpHFStatusSubscribers();
+
+	void subscribe(LS::Message &request, unsigned long long version, bool acknowledged);
+	void acknowledge(LS::Message &request, unsigned long long version);
+	void post(unsigned long long version);
+	bool empty() const { return mSubscribers.empty(); }
+	void setEmptyFunc(EmptyFunc func) { mEmptyFunc = func; }
+	pbnjson::JValue getMetrics() const;
+
+private:
+	struct Subscriber
+	{
+		LS::Message message;
+		unsigned long long sentVersion;
+		unsigned long long pendingVersion;
+		unsigned long long unsentPosts;
+		gint64 pendingSince;
+		gint64 nextSend;
+		unsigned int backoffMs;
+		bool acknowledged;
+		unsigned long long ackedVersion;
+		unsigned int unacked;
+		bool paused;
+		unsigned long sent;
+		unsigned long collapsed;
+		unsigned long resyncs;
+		unsigned long failures;
+		gint64 maxLagMs;
+	};
+
+	void flush();
+	bool send(Subscriber &subscriber, gint64 now);
+	void scheduleFlush(gint64 delayUs);
+	static gboolean handleFlush(gpointer userData);
+	static bool handleCancel(LSHandle *handle, const char *uniqueToken, void *context);
+
+	LSHandle *mLSHandle;
+	PayloadFunc mPayloadFunc;
+	EmptyFunc mEmptyFunc;
+	unsigned int mIntervalMs;
+	unsigned long long mResyncThreshold;
+	std::unordered_map<std::string, Subscriber> mSubscribers; //unique token to subscriber
+	guint mFlushSource;
+};
+
+#endif //HFPHFSTATUSSUBSCRIBERS_H_
@@ -17,47 +17,61 @@
 #include "logging.h"
 #include "hfphfsubscribe.h"
 #include "hfphfrole.h"
+#include "loopmonitor.h"
 
 bool HfpHFSubscribe::getStatusCallback(LSHandle* handle, LSMessage* reply, void* context)
 {
+	LOOP_MONITOR_SCOPE();
 	if (context == nullptr)
 		return true;
 
-	LSContext* lsContext = static_cast<LSContext*>(context);
+	HfpHFContextTable* contextTable = static_cast<HfpHFContextTable*>(context);
+	HfpHFContextTable::Context* lsContext = contextTable->resolve(reply);
+	if (lsContext == nullptr)
+		return true;
 
-	HfpHFRole* selfHfpHFRole = std::get<HFLS2::ContextData::OBJECT>(*lsContext);
-	std::string adapterAddr = std::get<HFLS2::ContextData::ADDRESS>(*lsContext);
+	HfpHFRole* selfHfpHFRole = contextTable->getRole();
+	std::string adapterAddr = lsContext->adapterAddress;
 	selfHfpHFRole->handleGetStatus(reply,adapterAddr);
 	return true;
 }
 
 bool HfpHFSubscribe::receiveResultCallback(LSHandle* handle, LSMessage* reply, void* context)
 {
+	LOOP_MONITOR_SCOPE();
 	if (context == nullptr)
 		return true;
 
-	LSContext* lsContext = static_cast<LSContext*>(context);
+	HfpHFContextTable* contextTable = static_cast<HfpHFContextTable*>(context);
+	if (contextTable->resolve(reply) == nullptr)
+		return true;
 
-	HfpHFRole* selfHfpHFRole = std::get<HFLS2::ContextData::OBJECT>(*lsContext);
+	HfpHFRole* selfHfpHFRole = contextTable->getRole();
 	selfHfpHFRole->handleReceiveResult(reply);
 	return true;
 }
 
 bool HfpHFSubscribe::getSCOStatusCallback(LSHandle* handle, LSMessage* reply, void* context)
 {
+	LOOP_MONITOR_SCOPE();
 	if (context == nullptr)
 		return true;
 
-	LSScoContext* lsScoContext = static_cast<LSScoContext*>(context);
+	HfpHFContextTable* contextTable = static_cast<HfpHFContextTable*>(context);
+	HfpHFContextTable::Context* lsContext = contextTable->resolve(reply);
+	if (lsContext == nullptr)
+		return true;
 
-	HfpHFRole* selfHfpHFRole = std::get<HFLS2::ScoContextData::SCOOBJECT>(*lsScoContext);
-	std::string remoteAddr = std::get<HFLS2::ScoContextData::REMOTEADDRESS>(*lsScoContext);
-	selfHfpHFRole->handleGetSCOStatus(reply, remoteAddr);
+	HfpHFRole* selfHfpHFRole = contextTable->getRole();
+	std::string adapterAddr = lsContext->adapterAddress;
+	std::string remoteAddr = lsContext->remoteAddress;
+	selfHfpHFRole->handleGetSCOStatus(reply, adapterAddr, remoteAddr);
 	return true;
 }
 
 bool HfpHFSubscribe::registerService(LSHandle* sh, const char* serviceName, bool connected, void* ctx)
 {
+	LOOP_MONITOR_SCOPE();
 	HfpHFRole* selfHfpHFRole = static_cast<HfpHFRole*>(ctx);
 	if (selfHfpHFRole == nullptr)
 		return true;
@@ -72,12 +86,15 @@ bool HfpHFSubscribe::registerService(LSHandle* sh, const char* serviceName, bool
 
 bool HfpHFSubscribe::getAdapterStatusCallback(LSHandle* handle, LSMessage* reply, void* context)
 {
+	LOOP_MONITOR_SCOPE();
 	if (context == nullptr)
 		return true;
 
-	LSContext* lsContext = static_cast<LSContext*>(context);
+	HfpHFContextTable* contextTable = static_cast<HfpHFContextTable*>(context);
+	if (contextTable->resolve(reply) == nullptr)
+		return true;
 
-	HfpHFRole* selfHfpHFRole = std::get<HFLS2::ContextData::OBJECT>(*lsContext);
+	HfpHFRole* selfHfpHFRole = contextTable->getRole();
 	selfHfpHFRole->handleAdapterGetStatus(reply);
 	return true;
 }
@@ -16,62 +16,54 @@
 
 #include "hfpofonocallvolume.h"
 #include "hfpofonomodem.h"
+#include "hfpofonoclient.h"
 #include <glib.h>
 #include <gio/gio.h>
 #include <string>
 #include "logging.h"
-
-extern "C" {
-#include "ofono-interface.h"
-}
+#include "loopmonitor.h"
 
 HfpOfonoCallVolume::HfpOfonoCallVolume(const std::string &objectPath, HfpOfonoModem *modem)
     : mModem(modem)
     , mObjectPath(objectPath)
-    , mOfonoCallVolumeProxy(nullptr)
+    , mOfonoClient(modem->getOfonoClient())
+    , mPropertiesCallId(0)
     , mMicrophoneVolume(0)
     , mSpeakerVolume(0)
 {
-	GError* error = nullptr;
-	mOfonoCallVolumeProxy = ofono_call_volume_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", mObjectPath.c_str(), NULL, &error);
-	if (error)
-	{
-		BT_ERROR("MSGID_FAILED_TO_CREATE_OFONO_HANDSFREE_PROXY", 0, "Failed to create dbus proxy for ofono handsfree on path %s: %s",
-			  objectPath.c_str(), error->message);
-		g_error_free(error);
-		return;
-	}
-
 	getCallVolumeProperties();
 
-	g_signal_connect(G_OBJECT(mOfonoCallVolumeProxy), "property-changed", G_CALLBACK(handleCallVolumePropertyChanged), this);
+	mPropertyChangedIds = mOfonoClient->subscribeProperties(OFONO::CALLVOLUME, mObjectPath, {"SpeakerVolume"},
+	                                                       [this](GVariant *parameters) { handleCallVolumePropertyChanged(parameters); });
 }
 
 HfpOfonoCallVolume::~HfpOfonoCallVolume()
 {
-	if (mOfonoCallVolumeProxy)
-		g_object_unref(mOfonoCallVolumeProxy);
+	mOfonoClient->cancel(mPropertiesCallId);
+	mOfonoClient->unsubscribe(mPropertyChangedIds);
 }
 
 void HfpOfonoCallVolume::getCallVolumeProperties()
 {
-	GError *error = 0;
-	GVariant *out;
+	mOfonoClient->cancel(mPropertiesCallId);
+	mPropertiesCallId = mOfonoClient->call(mObjectPath, OFONO::CALLVOLUME, "GetProperties", NULL, G_VARIANT_TYPE("(a{sv})"),
+	                                       [this](GVariant *reply, GError *error) { handleCallVolumeProperties(reply, error); });
+}
 
-	ofono_call_volume_call_get_properties_sync(mOfonoCallVolumeProxy, &out, NULL, &error);
+void HfpOfonoCallVolume::handleCallVolumeProperties(GVariant *out, GError *error)
+{
+	mPropertiesCallId = 0;
 	if (error)
 	{
 		BT_ERROR("MSGID_OBJECT_MANAGER_CREATION_FAILED", 0, "Failed to call: %s", error->message);
-		g_error_free(error);
 		return;
 	}
 
 	g_autoptr(GVariantIter) iter = NULL;
-	g_variant_get(out, "a{sv}", &iter);
+	g_variant_get(out, "(a{sv})", &iter);
 	gchar *name;
 	GVariant *valueVar;
 	std::string key;
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(mOfonoCallVolumeProxy));
 
 	while (g_variant_iter_loop (iter, "{sv}", &name, &valueVar))
 	{
@@ -79,33 +71,28 @@ void HfpOfonoCallVolume::getCallVolumeProperties()
 
 		if (key == "SpeakerVolume" && (g_variant_classify(valueVar) == G_VARIANT_CLASS_BYTE))
 		{
-			BT_DEBUG("SpeakerVolume property changed for device %s", objectPath);
+			BT_DEBUG("SpeakerVolume property changed for device %s", mObjectPath.c_str());
 			speakerVolumeChanged(g_variant_get_byte (valueVar));
 			break;
 		}
 	}
 }
 
-void HfpOfonoCallVolume::handleCallVolumePropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData)
+void HfpOfonoCallVolume::handleCallVolumePropertyChanged(GVariant *parameters)
 {
-	HfpOfonoCallVolume *pThis = static_cast<HfpOfonoCallVolume*>(userData);
-	if (!pThis)
-		return;
-
-	GVariant *va = g_variant_get_child_value(v, 0);
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(proxy));
+	LOOP_MONITOR_SCOPE();
+	const gchar *name = nullptr;
+	GVariant *va = nullptr;
+	g_variant_get(parameters, "(&sv)", &name, &va);
 
 	std::string key = name;
-	if (key == "MicrophoneVolume" && (g_variant_classify(va) == G_VARIANT_CLASS_BYTE))
+	if (key == "SpeakerVolume" && (g_variant_classify(va) == G_VARIANT_CLASS_BYTE))
 	{
-		BT_DEBUG("MicrophoneVolume property changed for device %s", objectPath);
-		//pThis->BatteryChargeLevelChanged(g_variant_get_byte (va));
-	}
-	else if (key == "SpeakerVolume" && (g_variant_classify(va) == G_VARIANT_CLASS_BYTE))
-	{
-		BT_DEBUG("SpeakerVolume property changed for device %s", objectPath);
-		pThis->speakerVolumeChanged(g_variant_get_byte (va));
+		BT_DEBUG("SpeakerVolume property changed for device %s", mObjectPath.c_str());
+		speakerVolumeChanged(g_variant_get_byte (va));
 	}
+
+	g_variant_unref(va);
 }
 
 void HfpOfonoCallVolume::microphoneVolumeChanged(int volume)
@@ -145,7 +132,8 @@ bool HfpOfonoCallVolume::setVolume(int volume, const std::string &propertyName)
 
 	GError *error = 0;
 
-	ofono_call_volume_call_set_property_sync(mOfonoCallVolumeProxy, propertyName.c_str(), g_variant_new_variant(valueVar), NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::CALLVOLUME, "SetProperty", g_variant_new("(sv)", propertyName.c_str(), valueVar),
+	                                     NULL, &error);
 
 	if (error)
 	{
@@ -154,5 +142,7 @@ bool HfpOfonoCallVolume::setVolume(int volume, const std::string &propertyName)
 		return false;
 	}
 
+	g_variant_unref(reply);
+
 	return true;
 }
@@ -18,11 +18,11 @@
 #define OFONO_CALLVOLUME_H
 
 #include <string>
+#include <vector>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#include <glib.h>
 
+class HfpOfonoClient;
 class HfpOfonoModem;
 
 class HfpOfonoCallVolume
@@ -39,12 +39,15 @@ public:
 	bool setMicrophoneVolume (int volume);
 	bool setSpeakerVolume(int volume);
 	bool setVolume(int volume, const std::string &propertyName);
-	static void handleCallVolumePropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData);
+	void handleCallVolumeProperties(GVariant *out, GError *error);
+	void handleCallVolumePropertyChanged(GVariant *parameters);
 
 private:
 	HfpOfonoModem* mModem;
 	std::string mObjectPath;
-	OfonoCallVolume* mOfonoCallVolumeProxy;
+	HfpOfonoClient *mOfonoClient;
+	std::vector<guint> mPropertyChangedIds;
+	guint mPropertiesCallId;
 
 	int mMicrophoneVolume;
 	int mSpeakerVolume;
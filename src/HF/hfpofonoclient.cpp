@@ -0,0 +1,255 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <vector>
+
+#include "hfpofonoclient.h"
+#include "logging.h"
+#include "loopmonitor.h"
+
+HfpOfonoClient::HfpOfonoClient(GDBusConnection *connection) :
+	mConnection(connection),
+	mNextHandlerId(1),
+	mNextCallId(1),
+	mDeliveredSignals(0),
+	mUnroutedSignals(0)
+{
+}
+
+HfpOfonoClient::~HfpOfonoClient()
+{
+	BT_INFO("OFONO_SIGNALS", 0, "%lu signals delivered on %zu match rules, %lu without a handler",
+	        mDeliveredSignals, mSignals.size(), mUnroutedSignals);
+
+	// Replies still on their way find the call detached from the client,
+	// and nobody waits for the client to become idle any more
+	mIdleFuncs.clear();
+	while (!mPendingCalls.empty())
+		cancel(mPendingCalls.begin()->first);
+
+	for (auto &signal : mSignals)
+		g_dbus_connection_signal_unsubscribe(mConnection, signal.second->subscriptionId);
+
+	if (mConnection)
+		g_object_unref(mConnection);
+}
+
+GVariant* HfpOfonoClient::call(const std::string &objectPath, const char *interface, const char *method, GVariant *parameters,
+                               const GVariantType *replyType, GError **error)
+{
+	return g_dbus_connection_call_sync(mConnection, OFONO::SERVICE, objectPath.c_str(), interface, method, parameters,
+	                                   replyType, G_DBUS_CALL_FLAGS_NONE, -1, NULL, error);
+}
+
+guint HfpOfonoClient::call(const std::string &objectPath, const char *interface, const char *method, GVariant *parameters,
+                           const GVariantType *replyType, ReplyFunc func)
+{
+	PendingCall *pendingCall = new PendingCall();
+	pendingCall->client = this;
+	pendingCall->callId = mNextCallId++;
+	pendingCall->cancellable = g_cancellable_new();
+	pendingCall->func = func;
+	mPendingCalls[pendingCall->callId] = pendingCall;
+
+	g_dbus_connection_call(mConnection, OFONO::SERVICE, objectPath.c_str(), interface, method, parameters,
+	                       replyType, G_DBUS_CALL_FLAGS_NONE, -1, pendingCall->cancellable, handleReply, pendingCall);
+
+	return pendingCall->callId;
+}
+
+void HfpOfonoClient::cancel(guint callId)
+{
+	auto iter = mPendingCalls.find(callId);
+	if (iter == mPendingCalls.end())
+		return;
+
+	// The call itself is freed by handleReply, which runs for cancelled
+	// calls as well
+	PendingCall *pendingCall = iter->second;
+	pendingCall->client = nullptr;
+	pendingCall->func = nullptr;
+	g_cancellable_cancel(pendingCall->cancellable);
+	mPendingCalls.erase(iter);
+
+	runIdleFuncs();
+}
+
+void HfpOfonoClient::notifyWhenIdle(std::function<void()> func)
+{
+	if (mPendingCalls.empty())
+	{
+		func();
+		return;
+	}
+
+	mIdleFuncs.push_back(func);
+}
+
+void HfpOfonoClient::runIdleFuncs()
+{
+	if (!mPendingCalls.empty() || mIdleFuncs.empty())
+		return;
+
+	std::vector<std::function<void()>> idleFuncs;
+	idleFuncs.swap(mIdleFuncs);
+	for (auto &idleFunc : idleFuncs)
+		idleFunc();
+}
+
+void HfpOfonoClient::handleReply(GObject *source, GAsyncResult *result, gpointer userData)
+{
+	LOOP_MONITOR_SCOPE();
+	PendingCall *pendingCall = static_cast<PendingCall*>(userData);
+	GError *error = nullptr;
+	GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+
+	HfpOfonoClient *client = pendingCall->client;
+	if (client)
+	{
+		client->mPendingCalls.erase(pendingCall->callId);
+		pendingCall->func(reply, error);
+	}
+
+	if (error)
+		g_error_free(error);
+	if (reply)
+		g_variant_unref(reply);
+	g_object_unref(pendingCall->cancellable);
+	delete pendingCall;
+
+	// Replies may start new calls, so waiters only run once nothing is left
+	if (client)
+		client->runIdleFuncs();
+}
+
+guint HfpOfonoClient::subscribe(const char *interface, const char *signalName, const std::string &objectPath, SignalFunc func,
+                                const char *arg0)
+{
+	std::string key = std::string(interface) + "." + signalName;
+	if (arg0)
+		key += std::string("/") + arg0;
+
+	auto iter = mSignals.find(key);
+	if (iter == mSignals.end())
+	{
+		std::unique_ptr<Signal> signal(new Signal());
+		signal->client = this;
+		signal->key = key;
+		signal->dispatching = 0;
+		signal->delivered = 0;
+		signal->subscriptionId = g_dbus_connection_signal_subscribe(mConnection, OFONO::SERVICE, interface, signalName,
+		                                                            NULL, arg0, G_DBUS_SIGNAL_FLAGS_NONE,
+		                                                            handleSignal, signal.get(), NULL);
+		BT_DEBUG("Subscribed to %s, %zu match rules", key.c_str(), mSignals.size() + 1);
+		iter = mSignals.insert(std::make_pair(key, std::move(signal))).first;
+	}
+
+	guint handlerId = mNextHandlerId++;
+	Signal *signal = iter->second.get();
+	signal->handlers[objectPath][handlerId] = func;
+	mHandlers[handlerId] = std::make_pair(signal, objectPath);
+
+	return handlerId;
+}
+
+std::vector<guint> HfpOfonoClient::subscribeProperties(const char *interface, const std::string &objectPath,
+                                                       const std::vector<const char*> &properties, SignalFunc func)
+{
+	std::vector<guint> handlerIds;
+	for (auto property : properties)
+		handlerIds.push_back(subscribe(interface, "PropertyChanged", objectPath, func, property));
+
+	return handlerIds;
+}
+
+void HfpOfonoClient::unsubscribe(std::vector<guint> &handlerIds)
+{
+	for (auto handlerId : handlerIds)
+		unsubscribe(handlerId);
+
+	handlerIds.clear();
+}
+
+void HfpOfonoClient::unsubscribe(guint handlerId)
+{
+	auto iter = mHandlers.find(handlerId);
+	if (iter == mHandlers.end())
+		return;
+
+	Signal *signal = iter->second.first;
+	auto pathHandlers = signal->handlers.find(iter->second.second);
+	if (pathHandlers != signal->handlers.end())
+	{
+		pathHandlers->second.erase(handlerId);
+		if (pathHandlers->second.empty())
+			signal->handlers.erase(pathHandlers);
+	}
+	mHandlers.erase(iter);
+
+	// A signal being dispatched is released by the dispatcher once done
+	if (signal->handlers.empty() && !signal->dispatching)
+		release(signal);
+}
+
+void HfpOfonoClient::release(Signal *signal)
+{
+	g_dbus_connection_signal_unsubscribe(mConnection, signal->subscriptionId);
+	BT_DEBUG("Released %s after %lu signals, %zu match rules left", signal->key.c_str(), signal->delivered, mSignals.size() - 1);
+	mSignals.erase(signal->key);
+}
+
+void HfpOfonoClient::handleSignal(GDBusConnection *connection, const gchar *sender, const gchar *objectPath,
+                                  const gchar *interface, const gchar *signalName, GVariant *parameters, gpointer userData)
+{
+	Signal *signal = static_cast<Signal*>(userData);
+	if (signal == nullptr || objectPath == nullptr)
+		return;
+
+	signal->delivered++;
+	signal->client->mDeliveredSignals++;
+
+	auto pathHandlers = signal->handlers.find(objectPath);
+	if (pathHandlers == signal->handlers.end())
+	{
+		signal->client->mUnroutedSignals++;
+		return;
+	}
+
+	// Handlers may delete objects, and with them other handlers of this
+	// path, so every handler is looked up again before it is run
+	std::vector<guint> handlerIds;
+	for (auto &handler : pathHandlers->second)
+		handlerIds.push_back(handler.first);
+
+	signal->dispatching++;
+	for (auto handlerId : handlerIds)
+	{
+		pathHandlers = signal->handlers.find(objectPath);
+		if (pathHandlers == signal->handlers.end())
+			break;
+
+		auto handler = pathHandlers->second.find(handlerId);
+		if (handler == pathHandlers->second.end())
+			continue;
+
+		SignalFunc func = handler->second;
+		func(parameters);
+	}
+	signal->dispatching--;
+
+	if (signal->handlers.empty() && !signal->dispatching)
+		signal->client->release(signal);
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HFPOFONOCLIENT_H_
+#define HFPOFONOCLIENT_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+namespace OFONO
+{
+	const char SERVICE[] = "org.ofono";
+	const char MANAGER[] = "org.ofono.Manager";
+	const char MODEM[] = "org.ofono.Modem";
+	const char VOICECALLMANAGER[] = "org.ofono.VoiceCallManager";
+	const char VOICECALL[] = "org.ofono.VoiceCall";
+	const char HANDSFREE[] = "org.ofono.Handsfree";
+	const char NETWORKREGISTRATION[] = "org.ofono.NetworkRegistration";
+	const char CALLVOLUME[] = "org.ofono.CallVolume";
+}
+
+/*
+ * Plain method calls and signal routing for oFono on one bus connection.
+ *
+ * Objects do not get a proxy of their own. Every signal type is subscribed
+ * once on the bus, whatever number of modems and calls listen for it, and
+ * the client hands each signal to the handlers registered for its object
+ * path.
+ *
+ * PropertyChanged is subscribed per property name with an arg0 match, so
+ * the bus daemon drops changes of properties nobody here consumes before
+ * they reach the service.
+ *
+ * Property and object fetches go through the asynchronous call so a slow
+ * or restarting oFono does not hold up the main loop. Their replies are
+ * dropped once the caller cancels them, which every object does when it
+ * is deleted.
+ */
+class HfpOfonoClient
+{
+public:
+	typedef std::function<void(GVariant *parameters)> SignalFunc;
+	typedef std::function<void(GVariant *reply, GError *error)> ReplyFunc;
+
+	HfpOfonoClient(GDBusConnection *connection);
+	~HfpOfonoClient();
+
+	HfpOfonoClient(const HfpOfonoClient&) = delete;
+	HfpOfonoClient& operator = (const HfpOfonoClient&) = delete;
+
+	GVariant* call(const std::string &objectPath, const char *interface, const char *method, GVariant *parameters,
+	               const GVariantType *replyType, GError **error);
+	guint call(const std::string &objectPath, const char *interface, const char *method, GVariant *parameters,
+	           const GVariantType *replyType, ReplyFunc func);
+	void cancel(guint callId);
+	void notifyWhenIdle(std::function<void()> func);
+	guint subscribe(const char *interface, const char *signal, const std::string &objectPath, SignalFunc func,
+	                const char *arg0 = nullptr);
+	std::vector<guint> subscribeProperties(const char *interface, const std::string &objectPath,
+	                                       const std::vector<const char*> &properties, SignalFunc func);
+	void unsubscribe(guint handlerId);
+	void unsubscribe(std::vector<guint> &handlerIds);
+	size_t getMatchRuleCount() const { return mSignals.size(); }
+	size_t getHandlerCount() const { return mHandlers.size(); }
+	size_t getPendingCallCount() const { return mPendingCalls.size(); }
+
+private:
+	struct Signal
+	{
+		HfpOfonoClient *client;
+		std::string key;
+		guint subscriptionId;
+		int dispatching;
+		unsigned long delivered;
+		std::unordered_map<std::string, std::map<guint, SignalFunc>> handlers; //object path to handlers
+	};
+
+	struct PendingCall
+	{
+		HfpOfonoClient *client; //cleared once the call is cancelled
+		guint callId;
+		GCancellable *cancellable;
+		ReplyFunc func;
+	};
+
+	void release(Signal *signal);
+	void runIdleFuncs();
+	static void handleReply(GObject *source, GAsyncResult *result, gpointer userData);
+	static void handleSignal(GDBusConnection *connection, const gchar *sender, const gchar *objectPath,
+	                         const gchar *interface, const gchar *signalName, GVariant *parameters, gpointer userData);
+
+	GDBusConnection *mConnection;
+	guint mNextHandlerId;
+	guint mNextCallId;
+	unsigned long mDeliveredSignals;
+	unsigned long mUnroutedSignals;
+	std::unordered_map<std::string, std::unique_ptr<Signal>> mSignals; //interface.signal to bus subscription
+	std::unordered_map<guint, std::pair<Signal*, std::string>> mHandlers; //handler id to signal and object path
+	std::unordered_map<guint, PendingCall*> mPendingCalls;
+	std::vector<std::function<void()>> mIdleFuncs;
+};
+
+#endif //HFPOFONOCLIENT_H_
@@ -16,59 +16,50 @@
 
 #include "hfpofonohandsfree.h"
 #include "hfpofonomodem.h"
+#include "hfpofonoclient.h"
 #include <glib.h>
 #include <gio/gio.h>
 #include <string>
 #include "logging.h"
-
-extern "C" {
-#include "ofono-interface.h"
-}
+#include "loopmonitor.h"
 
 HfpOfonoHandsfree::HfpOfonoHandsfree(const std::string &objectPath, HfpOfonoModem *modem)
     : mModem(modem)
     , mObjectPath(objectPath)
-    , mOfonoHandsfreeProxy(nullptr)
+    , mOfonoClient(modem->getOfonoClient())
+    , mPropertiesCallId(0)
     , mBatteryChargeLevel(0)
 {
-	GError* error = nullptr;
-	mOfonoHandsfreeProxy = ofono_handsfree_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", mObjectPath.c_str(), NULL, &error);
-	if (error)
-	{
-		BT_ERROR("MSGID_FAILED_TO_CREATE_OFONO_HANDSFREE_PROXY", 0, "Failed to create dbus proxy for ofono handsfree on path %s: %s",
-			  objectPath.c_str(), error->message);
-		g_error_free(error);
-		return;
-	}
-
 	getHandsfreeProperties();
 
-	g_signal_connect(G_OBJECT(mOfonoHandsfreeProxy), "property-changed", G_CALLBACK(handleHandsfreePropertyChanged), this);
+	mPropertyChangedIds = mOfonoClient->subscribeProperties(OFONO::HANDSFREE, mObjectPath, {"BatteryChargeLevel"},
+	                                                       [this](GVariant *parameters) { handleHandsfreePropertyChanged(parameters); });
 }
 
 HfpOfonoHandsfree::~HfpOfonoHandsfree()
 {
-	if (mOfonoHandsfreeProxy)
-		g_object_unref(mOfonoHandsfreeProxy);
+	mOfonoClient->cancel(mPropertiesCallId);
+	mOfonoClient->unsubscribe(mPropertyChangedIds);
 }
 
 void HfpOfonoHandsfree::getHandsfreeProperties()
 {
-	GError *error = 0;
-	GVariant *out;
-
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(mOfonoHandsfreeProxy));
+	mOfonoClient->cancel(mPropertiesCallId);
+	mPropertiesCallId = mOfonoClient->call(mObjectPath, OFONO::HANDSFREE, "GetProperties", NULL, G_VARIANT_TYPE("(a{sv})"),
+	                                       [this](GVariant *reply, GError *error) { handleHandsfreeProperties(reply, error); });
+}
 
-	ofono_handsfree_call_get_properties_sync(mOfonoHandsfreeProxy, &out, NULL, &error);
+void HfpOfonoHandsfree::handleHandsfreeProperties(GVariant *out, GError *error)
+{
+	mPropertiesCallId = 0;
 	if (error)
 	{
 		BT_ERROR("MSGID_OBJECT_MANAGER_CREATION_FAILED", 0, "Failed to call: %s", error->message);
-		g_error_free(error);
 		return;
 	}
 
 	g_autoptr(GVariantIter) iter = NULL;
-	g_variant_get(out, "a{sv}", &iter);
+	g_variant_get(out, "(a{sv})", &iter);
 	gchar *name;
 	GVariant *valueVar;
 	std::string key;
@@ -79,28 +70,28 @@ void HfpOfonoHandsfree::getHandsfreeProperties()
 
 		if (key == "BatteryChargeLevel" && (g_variant_classify(valueVar) == G_VARIANT_CLASS_BYTE))
 		{
-			BT_DEBUG("BatteryChargeLevel property changed for device %s", objectPath);
+			BT_DEBUG("BatteryChargeLevel property changed for device %s", mObjectPath.c_str());
 			BatteryChargeLevelChanged(g_variant_get_byte (valueVar));
 			break;
 		}
 	}
 }
 
-void HfpOfonoHandsfree::handleHandsfreePropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData)
+void HfpOfonoHandsfree::handleHandsfreePropertyChanged(GVariant *parameters)
 {
-	HfpOfonoHandsfree *pThis = static_cast<HfpOfonoHandsfree*>(userData);
-	if (!pThis)
-		return;
-
-	GVariant *va = g_variant_get_child_value(v, 0);
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(proxy));
+	LOOP_MONITOR_SCOPE();
+	const gchar *name = nullptr;
+	GVariant *va = nullptr;
+	g_variant_get(parameters, "(&sv)", &name, &va);
 
 	std::string key = name;
 	if (key == "BatteryChargeLevel" && (g_variant_classify(va) == G_VARIANT_CLASS_BYTE))
 	{
-		BT_DEBUG("BatteryChargeLevel property changed for device %s", objectPath);
-		pThis->BatteryChargeLevelChanged(g_variant_get_byte (va));
+		BT_DEBUG("BatteryChargeLevel property changed for device %s", mObjectPath.c_str());
+		BatteryChargeLevelChanged(g_variant_get_byte (va));
 	}
+
+	g_variant_unref(va);
 }
 
 void HfpOfonoHandsfree::BatteryChargeLevelChanged(int batteryChargeLevel)
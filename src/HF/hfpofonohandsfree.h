@@ -18,11 +18,11 @@
 #define OFONO_HANDSFREE_H
 
 #include <string>
+#include <vector>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#include <glib.h>
 
+class HfpOfonoClient;
 class HfpOfonoModem;
 
 class HfpOfonoHandsfree
@@ -36,12 +36,15 @@ public:
 	void getHandsfreeProperties();
 	int getBatteryChargeLevel() const { return mBatteryChargeLevel; }
 
-	static void handleHandsfreePropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData);
+	void handleHandsfreeProperties(GVariant *out, GError *error);
+	void handleHandsfreePropertyChanged(GVariant *parameters);
 
 private:
 	HfpOfonoModem* mModem;
 	std::string mObjectPath;
-	OfonoHandsfree* mOfonoHandsfreeProxy;
+	HfpOfonoClient *mOfonoClient;
+	std::vector<guint> mPropertyChangedIds;
+	guint mPropertiesCallId;
 
 	int mBatteryChargeLevel;
 	void BatteryChargeLevelChanged(int batteryChargeLevel);
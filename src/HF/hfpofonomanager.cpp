@@ -16,93 +16,240 @@
 
 #include "hfpofonomanager.h"
 #include "hfpofonomodem.h"
+#include "hfpofonoclient.h"
 #include "hfphfrole.h"
 #include "logging.h"
+#include "loopmonitor.h"
 #include <glib.h>
 #include <gio/gio.h>
+#include <algorithm>
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#define GETMODEMS_RETRY_MIN_MS  100
+#define GETMODEMS_RETRY_MAX_MS  5000
 
 HfpOfonoManager::HfpOfonoManager(const std::string& objectPath, HfpHFRole *role) :
 mHfpHFRole(role),
 mObjectPath(objectPath),
-mOfonoManagerProxy(nullptr)
+mOfonoClient(nullptr),
+mModemAddedId(0),
+mModemRemovedId(0),
+mGetModemsId(0),
+mRetrySource(0),
+mRetryMs(GETMODEMS_RETRY_MIN_MS),
+mAttaching(false),
+mStale(false),
+mStaleSince(0),
+mAttachStart(0)
 {
 	BT_DEBUG("ofonoManager instance created");
 	GError *error = nullptr;
-	mOfonoManagerProxy = ofono_manager_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", "/", NULL, &error);
+	GDBusConnection *connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
 	if (error)
 	{
-		BT_ERROR("MSGID_FAILED_TO_CREATE_OFONO_MANAGER_PROXY", 0, "Failed to create dbus proxy for ofono manager on path %s: %s",
+		BT_ERROR("MSGID_FAILED_TO_CREATE_OFONO_MANAGER_PROXY", 0, "Failed to connect to the system bus for ofono manager on path %s: %s",
 			  objectPath.c_str(), error->message);
 		g_error_free(error);
 		return;
 	}
 
-	getModemsFromOfonoManager();
+	mOfonoClient = new HfpOfonoClient(connection);
 
-	g_signal_connect(G_OBJECT(mOfonoManagerProxy), "modem-added", G_CALLBACK(handleModemAdded), this);
-	g_signal_connect(G_OBJECT(mOfonoManagerProxy), "modem-removed", G_CALLBACK(handleModemRemoved), this);
+	mModemAddedId = mOfonoClient->subscribe(OFONO::MANAGER, "ModemAdded", mObjectPath,
+	                                        [this](GVariant *parameters) { handleModemAdded(parameters); });
+	mModemRemovedId = mOfonoClient->subscribe(OFONO::MANAGER, "ModemRemoved", mObjectPath,
+	                                          [this](GVariant *parameters) { handleModemRemoved(parameters); });
+
+	mAttachStart = g_get_monotonic_time();
+	getModemsFromOfonoManager();
 }
 
 HfpOfonoManager::~HfpOfonoManager()
 {
-	if (mOfonoManagerProxy)
-		g_object_unref(mOfonoManagerProxy);
+	if (mRetrySource)
+		g_source_remove(mRetrySource);
 
+	// Modems drop their signal handlers, so they go before the client
 	mModemsMap.clear();
+
+	if (mOfonoClient)
+	{
+		mOfonoClient->cancel(mGetModemsId);
+		mOfonoClient->unsubscribe(mModemAddedId);
+		mOfonoClient->unsubscribe(mModemRemovedId);
+		delete mOfonoClient;
+	}
 }
 
-void HfpOfonoManager::handleModemAdded(OfonoManager *object, const gchar *path, GVariant *properties, void *userData)
+void HfpOfonoManager::handleModemAdded(GVariant *parameters)
 {
-	HfpOfonoManager *pThis = static_cast<HfpOfonoManager*>(userData);
-	if (!pThis)
-		return;
+	LOOP_MONITOR_SCOPE();
+	const gchar *path = nullptr;
+	GVariant *properties = nullptr;
+	g_variant_get(parameters, "(&o@a{sv})", &path, &properties);
 
-	std::unique_ptr<HfpOfonoModem> modem (new HfpOfonoModem(path, pThis->mHfpHFRole));
-	pThis->mModemsMap[path] = std::move(modem);
+	// A restarted oFono announces the modems it had before again
+	auto it = mModemsMap.find(path);
+	if (it != mModemsMap.end())
+	{
+		it->second->reattach(properties);
+	}
+	else
+	{
+		std::unique_ptr<HfpOfonoModem> modem (new HfpOfonoModem(path, mHfpHFRole, mOfonoClient, properties));
+		mModemsMap[path] = std::move(modem);
+	}
+	g_variant_unref(properties);
 }
 
-void HfpOfonoManager::handleModemRemoved(OfonoManager *object, const gchar *path, void *userData)
+void HfpOfonoManager::handleModemRemoved(GVariant *parameters)
 {
-	HfpOfonoManager *pThis = static_cast<HfpOfonoManager*>(userData);
-	if (!pThis)
-		return;
+	LOOP_MONITOR_SCOPE();
+	const gchar *path = nullptr;
+	g_variant_get(parameters, "(&o)", &path);
 
-	pThis->mModemsMap.erase(path);
+	mModemsMap.erase(path);
 	BT_DEBUG("OfonoModemManager  handleObjectRemoved in ofono %s", path);
 }
 
 void HfpOfonoManager::getModemsFromOfonoManager()
 {
-	GVariant *modems = nullptr;
-	GError *error = nullptr;
-	ofono_manager_call_get_modems_sync(mOfonoManagerProxy, &modems, NULL, &error);
+	mAttaching = true;
+	mOfonoClient->cancel(mGetModemsId);
+	mGetModemsId = mOfonoClient->call(mObjectPath, OFONO::MANAGER, "GetModems", NULL, G_VARIANT_TYPE("(a(oa{sv}))"),
+	                                  [this](GVariant *reply, GError *error) { handleGetModems(reply, error); });
+}
+
+void HfpOfonoManager::handleGetModems(GVariant *modems, GError *error)
+{
+	mGetModemsId = 0;
 	if (error)
 	{
-		BT_DEBUG("Not able to get modems");
-		g_error_free(error);
+		// oFono may own its name before it answers, the modems are only
+		// known for sure once GetModems went through
+		BT_WARNING("MSGID_OFONO_GET_MODEMS_FAILED", 0, "Not able to get modems, retrying in %u ms: %s",
+		           mRetryMs, error->message);
+		scheduleGetModemsRetry();
+		return;
 	}
+	mRetryMs = GETMODEMS_RETRY_MIN_MS;
 
 	g_autoptr(GVariantIter) iter1 = NULL;
-	g_variant_get (modems, "a(oa{sv})", &iter1);
+	g_variant_get (modems, "(a(oa{sv}))", &iter1);
 
 	const gchar *objectPath;
-	g_autoptr(GVariantIter) iter2 = NULL;
+	GVariant *properties = NULL;
+	std::unordered_set<std::string> present;
+	int kept = 0;
+	int added = 0;
+	int removed = 0;
 
-	while (g_variant_iter_loop (iter1, "(&oa{sv})", &objectPath, &iter2))
+	while (g_variant_iter_loop (iter1, "(&o@a{sv})", &objectPath, &properties))
 	{
-		const gchar *key;
-		g_autoptr(GVariant) value = NULL;
+		present.insert(objectPath);
+
+		auto it = mModemsMap.find(objectPath);
+		if (it != mModemsMap.end())
+		{
+			it->second->reattach(properties);
+			kept++;
+			continue;
+		}
 
-		std::unique_ptr<HfpOfonoModem> modem (new HfpOfonoModem(objectPath, mHfpHFRole));
+		std::unique_ptr<HfpOfonoModem> modem (new HfpOfonoModem(objectPath, mHfpHFRole, mOfonoClient, properties));
 		mModemsMap.insert(std::make_pair(objectPath, std::move(modem)));
+		added++;
+	}
+
+	// Modems the previous oFono had and this one does not take their calls
+	// with them
+	for (auto it = mModemsMap.begin(); it != mModemsMap.end();)
+	{
+		if (present.find(it->first) != present.end())
+		{
+			it++;
+			continue;
+		}
+
+		it->second->removeVoiceCalls();
+		it = mModemsMap.erase(it);
+		removed++;
 	}
+
+	BT_DEBUG("Modems from oFono: %d kept, %d added, %d removed", kept, added, removed);
+
+	// Ready once the properties and calls of every modem are in as well
+	mOfonoClient->notifyWhenIdle([this]() { handleReady(); });
+}
+
+void HfpOfonoManager::handleReady()
+{
+	// Calls cancelled because oFono went away leave the client idle too
+	if (!mAttaching)
+		return;
+
+	mAttaching = false;
+	gint64 now = g_get_monotonic_time();
+	if (mStale)
+		BT_INFO("OFONO_REATTACHED", 0, "Reattached to oFono in %lld ms after %lld ms without it, %zu modems",
+		        (long long) ((now - mAttachStart) / 1000), (long long) ((mAttachStart - mStaleSince) / 1000), mModemsMap.size());
+	else
+	{
+		BT_INFO("OFONO_ATTACHED", 0, "Attached to oFono in %lld ms, %zu modems",
+		        (long long) ((now - mAttachStart) / 1000), mModemsMap.size());
+		StartupTrace::getInstance().mark("ofonoAttached");
+	}
+
+	mStale = false;
+}
+
+void HfpOfonoManager::markStale()
+{
+	if (mStale)
+		return;
+
+	BT_INFO("OFONO_STALE", 0, "oFono is gone, keeping the state of %zu modems until it is back", mModemsMap.size());
+	mStale = true;
+	mStaleSince = g_get_monotonic_time();
+	mAttaching = false;
+	if (mRetrySource)
+	{
+		g_source_remove(mRetrySource);
+		mRetrySource = 0;
+	}
+	if (mOfonoClient)
+		mOfonoClient->cancel(mGetModemsId);
+	mGetModemsId = 0;
+}
+
+void HfpOfonoManager::scheduleGetModemsRetry()
+{
+	if (mRetrySource)
+		return;
+
+	mRetrySource = g_timeout_add(mRetryMs, handleGetModemsRetry, this);
+	mRetryMs = std::min<guint>(mRetryMs * 2, GETMODEMS_RETRY_MAX_MS);
+}
+
+gboolean HfpOfonoManager::handleGetModemsRetry(gpointer userData)
+{
+	HfpOfonoManager *manager = static_cast<HfpOfonoManager*>(userData);
+	manager->mRetrySource = 0;
+	manager->getModemsFromOfonoManager();
+	return FALSE;
+}
+
+void HfpOfonoManager::reattach()
+{
+	if (!mOfonoClient)
+		return;
+
+	mAttachStart = g_get_monotonic_time();
+	mRetryMs = GETMODEMS_RETRY_MIN_MS;
+	getModemsFromOfonoManager();
 }
 
 HfpOfonoModem* HfpOfonoManager::getModem(const std::string &adapterAddress, const std::string &address) const
@@ -22,11 +22,8 @@
 #include <unordered_map>
 #include <gio/gio.h>
 
-extern "C" {
-#include "ofono-interface.h"
-}
-
 class HfpOfonoModem;
+class HfpOfonoClient;
 class HfpHFRole;
 
 class HfpOfonoManager
@@ -39,14 +36,31 @@ public:
 	HfpOfonoManager& operator = (const HfpOfonoManager&) = delete;
 
 	void getModemsFromOfonoManager();
+	void markStale();
+	void reattach();
+	bool isStale() const { return mStale; }
 	HfpOfonoModem * getModem(const std::string &adapterAddress, const std::string &address) const;
-	static void handleModemAdded(OfonoManager *object, const gchar *path, GVariant *properties, void *userData);
-	static void handleModemRemoved(OfonoManager *object, const gchar *path, void *userData);
+	void handleGetModems(GVariant *modems, GError *error);
+	void handleModemAdded(GVariant *parameters);
+	void handleModemRemoved(GVariant *parameters);
 
 private:
+	void handleReady();
+	void scheduleGetModemsRetry();
+	static gboolean handleGetModemsRetry(gpointer userData);
+
 	HfpHFRole *mHfpHFRole;
 	std::string mObjectPath;
-	OfonoManager *mOfonoManagerProxy;
+	HfpOfonoClient *mOfonoClient;
+	guint mModemAddedId;
+	guint mModemRemovedId;
+	guint mGetModemsId;
+	guint mRetrySource;
+	guint mRetryMs;
+	bool mAttaching;
+	bool mStale;
+	gint64 mStaleSince;
+	gint64 mAttachStart;
 	std::unordered_map <std::string, std::unique_ptr <HfpOfonoModem>> mModemsMap;
 };
 
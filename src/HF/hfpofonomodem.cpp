@@ -29,20 +29,14 @@
 #include "hfpofonohandsfree.h"
 #include "hfpofononetworkregistration.h"
 #include "hfpofonocallvolume.h"
+#include "hfpofonoclient.h"
+#include "loopmonitor.h"
 
-extern "C" {
-#include "ofono-interface.h"
-}
-
-const char interfaceVoiceCallManager[] = "org.ofono.VoiceCallManager";
-const char interfaceCallVolume[] = "org.ofono.CallVolume";
-const char interfaceHandsfree[] = "org.ofono.Handsfree";
-const char interfaceNetworkRegistration[] = "org.ofono.NetworkRegistration";
-
-HfpOfonoModem::HfpOfonoModem(const std::string& objectPath, HfpHFRole *role) :
+HfpOfonoModem::HfpOfonoModem(const std::string& objectPath, HfpHFRole *role, HfpOfonoClient *client, GVariant *properties) :
 mHfpHFRole(role),
 mObjectPath(objectPath),
-mOfonoModemProxy(nullptr),
+mOfonoClient(client),
+mPropertiesCallId(0),
 mVoiceCallManager(nullptr),
 mHandsfree(nullptr),
 mNetworkRegistration(nullptr),
@@ -51,28 +45,19 @@ mEmergency(false),
 mLockDown(false),
 mOnline(false),
 mPowered(false),
+mInterfaces(0),
 mAddress("")
 {
 	BT_DEBUG("ofonoModem instance created");
-	GError *error = nullptr;
-	mOfonoModemProxy = ofono_modem_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", objectPath.c_str(), NULL, &error);
-	if (error)
-	{
-		BT_ERROR("FAILED_TO_CREATE_OFONO_MODEM_PROXY", 0, "Failed to create dbus proxy for ofono modem on path %s: %s",
-			  objectPath.c_str(), error->message);
-		g_error_free(error);
-		return;
-	}
-
-	mVoiceCallManager = new HfpOfonoVoiceCallManager(objectPath, this);
 
-	getModemProperties(mOfonoModemProxy);
-
-	mHandsfree = new HfpOfonoHandsfree(mObjectPath, this);
-	mNetworkRegistration = new HfpOfonoNetworkRegistration(mObjectPath, this);
-	mCallVolume = new HfpOfonoCallVolume(mObjectPath, this);
+	// Modems reported by GetModems and ModemAdded come with their properties
+	if (properties)
+		updateModemProperties(properties);
+	else
+		getModemProperties();
 
-	g_signal_connect(G_OBJECT(mOfonoModemProxy), "property-changed", G_CALLBACK(handleModemPropertyChanged), this);
+	mPropertyChangedIds = mOfonoClient->subscribeProperties(OFONO::MODEM, mObjectPath, {"Interfaces", "Serial"},
+	                                                       [this](GVariant *parameters) { handleModemPropertyChanged(parameters); });
 }
 
 HfpOfonoModem::~HfpOfonoModem()
@@ -89,69 +74,105 @@ HfpOfonoModem::~HfpOfonoModem()
 	if (mCallVolume)
 		delete mCallVolume;
 
-	if (mOfonoModemProxy)
-		g_object_unref(mOfonoModemProxy);
+	mOfonoClient->cancel(mPropertiesCallId);
+	mOfonoClient->unsubscribe(mPropertyChangedIds);
 
 	mFeatures.clear();
-	mInterfaces.clear();
 }
 
-void HfpOfonoModem::handleModemPropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData)
+void HfpOfonoModem::handleModemPropertyChanged(GVariant *parameters)
 {
-	GVariant *va = g_variant_get_child_value(v, 0);
-	HfpOfonoModem *pThis = static_cast<HfpOfonoModem*>(userData);
-	if (!pThis)
-		return;
-
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(proxy));
+	LOOP_MONITOR_SCOPE();
+	const gchar *name = nullptr;
+	GVariant *va = nullptr;
+	g_variant_get(parameters, "(&sv)", &name, &va);
 
 	std::string key = name;
 
 	if (key == "Interfaces")
 	{
-		BT_DEBUG("Interface property changed for device %s", objectPath);
-		g_autoptr(GVariantIter) iter2;
-		gchar *interface = nullptr;
-		pThis->mInterfaces.clear();
-		g_variant_get(va, "as", &iter2);
-		while (g_variant_iter_loop (iter2, "s", &interface))
-		{
-			pThis->mInterfaces.push_back(interface);
-		}
-
-		pThis->interfacesChanged();
-
+		BT_DEBUG("Interface property changed for device %s", mObjectPath.c_str());
+		interfacesChanged(parseInterfaces(va));
 	}
 
 	if (key == "Serial")
 	{
 		const char *serial = nullptr;
-		g_variant_get(va, "s", &serial);
+		g_variant_get(va, "&s", &serial);
 		if (serial)
-			pThis->mAddress = convertToLowerCase(serial);
+			mAddress = convertToLowerCase(serial);
 	}
+
+	g_variant_unref(va);
 }
 
-void HfpOfonoModem::getModemProperties(OfonoModem *modemProxy)
+void HfpOfonoModem::getModemProperties()
 {
-	GError *error = 0;
-	GVariant *out;
-
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(modemProxy));
+	mOfonoClient->cancel(mPropertiesCallId);
+	mPropertiesCallId = mOfonoClient->call(mObjectPath, OFONO::MODEM, "GetProperties", NULL, G_VARIANT_TYPE("(a{sv})"),
+	                                       [this](GVariant *reply, GError *error) { handleModemProperties(reply, error); });
+}
 
-	ofono_modem_call_get_properties_sync(modemProxy, &out, NULL, &error);
+void HfpOfonoModem::handleModemProperties(GVariant *out, GError *error)
+{
+	mPropertiesCallId = 0;
 	if (error)
 	{
 		BT_ERROR("MSGID_OBJECT_MANAGER_CREATION_FAILED", 0, "Failed to call: %s", error->message);
-		g_error_free(error);
 		return;
 	}
 
+	GVariant *properties = g_variant_get_child_value(out, 0);
+	updateModemProperties(properties);
+	g_variant_unref(properties);
+}
+
+void HfpOfonoModem::reattach(GVariant *properties)
+{
+	// Interfaces that come back keep their objects and with them the state
+	// already published, they only fetch their properties again. Values
+	// that did not change while oFono was away are not reported.
+	unsigned int interfaces = mInterfaces;
+
+	// Calls are not kept by a voice call manager that is going away
+	GVariant *interfacesVar = g_variant_lookup_value(properties, "Interfaces", G_VARIANT_TYPE("as"));
+	if (interfacesVar)
+	{
+		if (!(parseInterfaces(interfacesVar) & Interface::VOICECALLMANAGER))
+			removeVoiceCalls();
+		g_variant_unref(interfacesVar);
+	}
+
+	updateModemProperties(properties);
+	unsigned int kept = interfaces & mInterfaces;
+
+	BT_DEBUG("Reattached %s, kept interfaces 0x%x", mObjectPath.c_str(), kept);
+
+	if (kept & Interface::VOICECALLMANAGER)
+		mVoiceCallManager->addExistingVoiceCalls();
+	if (kept & Interface::CALLVOLUME)
+		mCallVolume->getCallVolumeProperties();
+	if (kept & Interface::HANDSFREE)
+		mHandsfree->getHandsfreeProperties();
+	if (kept & Interface::NETWORKREGISTRATION)
+		mNetworkRegistration->getNetworkRegistrationProperties();
+}
+
+void HfpOfonoModem::removeVoiceCalls()
+{
+	if (mVoiceCallManager)
+		mVoiceCallManager->removeVoiceCalls();
+}
+
+void HfpOfonoModem::updateModemProperties(GVariant *properties)
+{
 	g_autoptr(GVariantIter) iter = NULL;
-	g_variant_get(out, "a{sv}", &iter);
+	g_variant_get(properties, "a{sv}", &iter);
 	gchar *name;
 	GVariant *valueVar;
 	std::string key;
+	bool hasInterfaces = false;
+	unsigned int interfaces = 0;
 
 	while (g_variant_iter_loop (iter, "{sv}", &name, &valueVar))
 	{
@@ -159,17 +180,8 @@ void HfpOfonoModem::getModemProperties(OfonoModem *modemProxy)
 
 		if (key == "Interfaces")
 		{
-			BT_DEBUG("Interface property changed for device %s", objectPath);
-			g_autoptr(GVariantIter) iter2;
-			gchar *interface = nullptr;
-			mInterfaces.clear();
-			g_variant_get(valueVar, "as", &iter2);
-			while (g_variant_iter_loop (iter2, "s", &interface))
-			{
-				mInterfaces.push_back(interface);
-			}
-
-			interfacesChanged();
+			hasInterfaces = true;
+			interfaces = parseInterfaces(valueVar);
 		}
 
 		if (key == "Serial")
@@ -182,6 +194,14 @@ void HfpOfonoModem::getModemProperties(OfonoModem *modemProxy)
 			}
 		}
 	}
+
+	// Sub-interfaces report to the device of the modem, so they are set up
+	// once Serial is known regardless of the order of the dict
+	if (hasInterfaces)
+	{
+		BT_DEBUG("Interface property changed for device %s", mObjectPath.c_str());
+		interfacesChanged(interfaces);
+	}
 }
 
 void HfpOfonoModem::callAdded(HfpOfonoVoiceCall *voiceCall)
@@ -226,7 +246,7 @@ void HfpOfonoModem::callRemoved(HfpOfonoVoiceCall *voiceCall)
 	if (!phoneNumber.empty())
 	{
 		device->eraseCallStatus(phoneNumber);
-		mHfpHFRole->notifySubscribersStatusChanged(true);
+		mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
 	}
 
 	BT_DEBUG("callRemoved phoneNumber %s ", phoneNumber.c_str());
@@ -258,7 +278,10 @@ void HfpOfonoModem::updateState(HfpOfonoVoiceCall *voiceCall)
 		else if (callState == "incoming")
 			device->setCallStatus(phoneNumber, CLCC::DeviceStatus::DIRECTION, "incoming");
 
-		mHfpHFRole->notifySubscribersStatusChanged(true);
+		mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
+		// Incoming and waiting calls are never left waiting for an idle loop
+		if (callState == "incoming" || callState == "waiting")
+			mHfpHFRole->flushStatusChanges();
 	}
 }
 
@@ -298,50 +321,91 @@ std::string HfpOfonoModem::getAdapterAddress()
 	 return std::string();
 }
 
-bool HfpOfonoModem::isInterfacePresent(const std::string interfaceName)
+static const struct
 {
-	if (mInterfaces.empty())
-		return false;
+	const char *name;
+	HfpOfonoModem::Interface interface;
+} interfaceNames[] =
+{
+	{OFONO::VOICECALLMANAGER, HfpOfonoModem::Interface::VOICECALLMANAGER},
+	{OFONO::CALLVOLUME, HfpOfonoModem::Interface::CALLVOLUME},
+	{OFONO::HANDSFREE, HfpOfonoModem::Interface::HANDSFREE},
+	{OFONO::NETWORKREGISTRATION, HfpOfonoModem::Interface::NETWORKREGISTRATION}
+};
 
-	for (auto it = mInterfaces.begin(); it != mInterfaces.end(); it++)
+unsigned int HfpOfonoModem::parseInterfaces(GVariant *interfacesVar)
+{
+	unsigned int interfaces = 0;
+	g_autoptr(GVariantIter) iter = NULL;
+	const gchar *interface = nullptr;
+	g_variant_get(interfacesVar, "as", &iter);
+	while (g_variant_iter_loop (iter, "&s", &interface))
 	{
-		if (*it == interfaceName)
-			return true;
+		for (auto &known : interfaceNames)
+		{
+			if (g_strcmp0(known.name, interface) == 0)
+				interfaces |= known.interface;
+		}
 	}
 
-	return false;
+	return interfaces;
 }
 
-void HfpOfonoModem::interfacesChanged()
+bool HfpOfonoModem::isInterfacePresent(const std::string interfaceName)
 {
-	//Get org.ofono.VoiceCallManager properties
-	if (isInterfacePresent(interfaceVoiceCallManager) && mVoiceCallManager)
+	for (auto &known : interfaceNames)
 	{
-		mVoiceCallManager->addExistingVoiceCalls();
+		if (interfaceName == known.name)
+			return (mInterfaces & known.interface) != 0;
 	}
 
-	//Get org.ofono.CallVolume properties
-	if (isInterfacePresent(interfaceCallVolume))
+	return false;
+}
+
+void HfpOfonoModem::interfacesChanged(unsigned int interfaces)
+{
+	unsigned int added = interfaces & ~mInterfaces;
+	unsigned int removed = mInterfaces & ~interfaces;
+	mInterfaces = interfaces;
+
+	BT_DEBUG("Interfaces of %s: 0x%x, added 0x%x, removed 0x%x", mObjectPath.c_str(), interfaces, added, removed);
+
+	// Proxies are only created for interfaces the modem has and dropped
+	// with them, their constructors fetch the current properties
+	if (removed & Interface::VOICECALLMANAGER)
 	{
-		//ToDo: Volume functionality will be added
+		delete mVoiceCallManager;
+		mVoiceCallManager = nullptr;
 	}
+	if (added & Interface::VOICECALLMANAGER)
+		mVoiceCallManager = new HfpOfonoVoiceCallManager(mObjectPath, this);
 
-	//Get org.ofono.Handsfree properties
-	if (isInterfacePresent(interfaceHandsfree))
+	if (removed & Interface::CALLVOLUME)
 	{
-		if (mHandsfree)
-			mHandsfree->getHandsfreeProperties();
+		delete mCallVolume;
+		mCallVolume = nullptr;
 	}
-	else
+	if (added & Interface::CALLVOLUME)
+		mCallVolume = new HfpOfonoCallVolume(mObjectPath, this);
+
+	if (removed & Interface::HANDSFREE)
 	{
-		mAddress = "";
+		delete mHandsfree;
+		mHandsfree = nullptr;
 	}
+	if (added & Interface::HANDSFREE)
+		mHandsfree = new HfpOfonoHandsfree(mObjectPath, this);
 
-	//Get org.ofono.NetworkRegistration properties
-	if (isInterfacePresent(interfaceNetworkRegistration) && mNetworkRegistration)
+	if (removed & Interface::NETWORKREGISTRATION)
 	{
-		mNetworkRegistration->getNetworkRegistrationProperties();
+		delete mNetworkRegistration;
+		mNetworkRegistration = nullptr;
 	}
+	if (added & Interface::NETWORKREGISTRATION)
+		mNetworkRegistration = new HfpOfonoNetworkRegistration(mObjectPath, this);
+
+	if (!(mInterfaces & Interface::HANDSFREE))
+		mAddress = "";
 }
 
 void HfpOfonoModem::updateBatteryChargeLevel(int batteryChargeLevel)
@@ -361,7 +425,7 @@ void HfpOfonoModem::updateBatteryChargeLevel(int batteryChargeLevel)
 	BT_DEBUG("setDeviceStatus for BatteryChargeLevel: %d ", batteryChargeLevel);
 	device->setDeviceStatus(CIND::DeviceStatus::BATTCHG, batteryChargeLevel);
 
-	mHfpHFRole->notifySubscribersStatusChanged(true);
+	mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
 }
 
 void HfpOfonoModem::updateNetworkSignalStrength(int networkSignalStrength)
@@ -381,7 +445,7 @@ void HfpOfonoModem::updateNetworkSignalStrength(int networkSignalStrength)
 	BT_DEBUG("setDeviceStatus for networkSignalStrength: %d ", networkSignalStrength);
 	device->setDeviceStatus(CIND::DeviceStatus::SIGNAL, networkSignalStrength);
 
-	mHfpHFRole->notifySubscribersStatusChanged(true);
+	mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
 }
 
 void HfpOfonoModem::updateNetworkOperatorName(const std::string &name)
@@ -401,7 +465,7 @@ void HfpOfonoModem::updateNetworkOperatorName(const std::string &name)
 	BT_DEBUG("setDeviceStatus for NetworkOperatorName: %s ", name.c_str());
 	device->setNetworkOperatorName(name);
 
-	mHfpHFRole->notifySubscribersStatusChanged(true);
+	mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
 }
 
 void HfpOfonoModem::updateNetworkRegistrationStatus(const std::string &status)
@@ -421,7 +485,7 @@ void HfpOfonoModem::updateNetworkRegistrationStatus(const std::string &status)
 	BT_DEBUG("setDeviceStatus for NetworkRegistrationStatus: %s ", status.c_str());
 	device->setNetworkRegistrationStatus(status);
 
-	mHfpHFRole->notifySubscribersStatusChanged(true);
+	mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
 }
 
 void HfpOfonoModem::notifyProperties()
@@ -455,7 +519,7 @@ void HfpOfonoModem::updateSpeakerVolume(int volume)
 
 	mHfpHFRole->setVolumeToAudio(mAddress, getAdapterAddress());
 
-	mHfpHFRole->notifySubscribersStatusChanged(true);
+	mHfpHFRole->notifySubscribersStatusChanged(true, getAdapterAddress(), mAddress);
 }
 
 void HfpOfonoModem::updateMicrophoneVolume(int volume)
@@ -465,10 +529,16 @@ void HfpOfonoModem::updateMicrophoneVolume(int volume)
 
 bool HfpOfonoModem::setSpeakerVolume(int volume)
 {
+	if (!mCallVolume)
+		return false;
+
 	return mCallVolume->setSpeakerVolume(volume);
 }
 
 bool HfpOfonoModem::setMicrophoneVolume(int volume)
 {
+	if (!mCallVolume)
+		return false;
+
 	return mCallVolume->setMicrophoneVolume(volume);
 }
@@ -20,10 +20,9 @@
 #include <string>
 #include <vector>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#include <glib.h>
 
+class HfpOfonoClient;
 class HfpOfonoVoiceCallManager;
 class HfpHFRole;
 class HfpOfonoVoiceCall;
@@ -34,12 +33,26 @@ class HfpOfonoCallVolume;
 class HfpOfonoModem
 {
 public:
-	HfpOfonoModem(const std::string& objectPath, HfpHFRole *role);
+	// oFono interfaces of a modem the service makes use of
+	enum Interface
+	{
+		VOICECALLMANAGER = 1 << 0,
+		CALLVOLUME = 1 << 1,
+		HANDSFREE = 1 << 2,
+		NETWORKREGISTRATION = 1 << 3
+	};
+
+	HfpOfonoModem(const std::string& objectPath, HfpHFRole *role, HfpOfonoClient *client, GVariant *properties = nullptr);
 	~HfpOfonoModem();
 
 	HfpOfonoModem(const HfpOfonoModem&) = delete;
 	HfpOfonoModem& operator = (const HfpOfonoModem&) = delete;
-	void getModemProperties(OfonoModem *modemProxy);
+	void getModemProperties();
+	void handleModemProperties(GVariant *out, GError *error);
+	void updateModemProperties(GVariant *properties);
+	void reattach(GVariant *properties);
+	void removeVoiceCalls();
+	HfpOfonoClient* getOfonoClient() const { return mOfonoClient; }
 	HfpOfonoVoiceCallManager* getVoiceCallManager() const { return mVoiceCallManager; }
 	std::string getAddress() const { return mAddress; }
 	void updateState(HfpOfonoVoiceCall *call);
@@ -48,7 +61,8 @@ public:
 	std::string getAdapterAddress();
 
 	bool isInterfacePresent(const std::string interfaceName);
-	void interfacesChanged();
+	void interfacesChanged(unsigned int interfaces);
+	static unsigned int parseInterfaces(GVariant *interfacesVar);
 	void updateBatteryChargeLevel(int batteryChargeLevel);
 	void updateNetworkSignalStrength(int networkSignalStrength);
 	void updateNetworkOperatorName(const std::string &name);
@@ -59,12 +73,14 @@ public:
 	bool setMicrophoneVolume(int volume);
 	void notifyProperties();
 
-	static void handleModemPropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData);
+	void handleModemPropertyChanged(GVariant *parameters);
 
 private:
 	HfpHFRole *mHfpHFRole;
 	std::string mObjectPath;
-	OfonoModem *mOfonoModemProxy;
+	HfpOfonoClient *mOfonoClient;
+	std::vector<guint> mPropertyChangedIds;
+	guint mPropertiesCallId;
 	HfpOfonoVoiceCallManager *mVoiceCallManager;
 	HfpOfonoHandsfree* mHandsfree;
 	HfpOfonoNetworkRegistration* mNetworkRegistration;
@@ -74,7 +90,7 @@ private:
 	bool mOnline;
 	bool mPowered;
 	std::vector <std::string> mFeatures;
-	std::vector <std::string> mInterfaces;
+	unsigned int mInterfaces;
 	std::string mName;
 	std::string mAddress;
 	std::string type;
@@ -16,59 +16,50 @@
 
 #include "hfpofononetworkregistration.h"
 #include "hfpofonomodem.h"
+#include "hfpofonoclient.h"
 #include <glib.h>
 #include <gio/gio.h>
 #include <string>
 #include "logging.h"
-
-extern "C" {
-#include "ofono-interface.h"
-}
+#include "loopmonitor.h"
 
 HfpOfonoNetworkRegistration::HfpOfonoNetworkRegistration(const std::string &objectPath, HfpOfonoModem *modem)
 	: mModem(modem)
 	, mObjectPath(objectPath)
-	, mOfonoNetworkRegistrationProxy(nullptr)
+	, mOfonoClient(modem->getOfonoClient())
+	, mPropertiesCallId(0)
 	, mNetworkSignalStrength(-1)
 {
-	GError* error = nullptr;
-	mOfonoNetworkRegistrationProxy = ofono_network_registration_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", mObjectPath.c_str(), NULL, &error);
-	if (error)
-	{
-		BT_ERROR("MSGID_FAILED_TO_CREATE_OFONO_NETWORK_REGISTRATION_PROXY", 0, "Failed to create dbus proxy for ofono network registration on path %s: %s",
-			  objectPath.c_str(), error->message);
-		g_error_free(error);
-		return;
-	}
-
 	getNetworkRegistrationProperties();
 
-	g_signal_connect(G_OBJECT(mOfonoNetworkRegistrationProxy), "property-changed", G_CALLBACK(handleNetworkRegistrationPropertyChanged), this);
+	mPropertyChangedIds = mOfonoClient->subscribeProperties(OFONO::NETWORKREGISTRATION, mObjectPath, {"Strength", "Name", "Status"},
+	                                                       [this](GVariant *parameters) { handleNetworkRegistrationPropertyChanged(parameters); });
 }
 
 HfpOfonoNetworkRegistration::~HfpOfonoNetworkRegistration()
 {
-	if (mOfonoNetworkRegistrationProxy)
-		g_object_unref(mOfonoNetworkRegistrationProxy);
+	mOfonoClient->cancel(mPropertiesCallId);
+	mOfonoClient->unsubscribe(mPropertyChangedIds);
 }
 
 void HfpOfonoNetworkRegistration::getNetworkRegistrationProperties()
 {
-	GError *error = 0;
-	GVariant *out;
-
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(mOfonoNetworkRegistrationProxy));
+	mOfonoClient->cancel(mPropertiesCallId);
+	mPropertiesCallId = mOfonoClient->call(mObjectPath, OFONO::NETWORKREGISTRATION, "GetProperties", NULL, G_VARIANT_TYPE("(a{sv})"),
+	                                       [this](GVariant *reply, GError *error) { handleNetworkRegistrationProperties(reply, error); });
+}
 
-	ofono_network_registration_call_get_properties_sync(mOfonoNetworkRegistrationProxy, &out, NULL, &error);
+void HfpOfonoNetworkRegistration::handleNetworkRegistrationProperties(GVariant *out, GError *error)
+{
+	mPropertiesCallId = 0;
 	if (error)
 	{
 		BT_ERROR("MSGID_OBJECT_MANAGER_CREATION_FAILED", 0, "Failed to call: %s", error->message);
-		g_error_free(error);
 		return;
 	}
 
 	g_autoptr(GVariantIter) iter = NULL;
-	g_variant_get(out, "a{sv}", &iter);
+	g_variant_get(out, "(a{sv})", &iter);
 	gchar *name;
 	GVariant *valueVar;
 	std::string key;
@@ -77,7 +68,7 @@ void HfpOfonoNetworkRegistration::getNetworkRegistrationProperties()
 	{
 		key = name;
 
-		BT_DEBUG("%s property changed for device %s", key.c_str(), objectPath);
+		BT_DEBUG("%s property changed for device %s", key.c_str(), mObjectPath.c_str());
 		if (key == "Strength" && (g_variant_classify(valueVar) == G_VARIANT_CLASS_BYTE))
 		{
 			networkSignalStrengthChanged(g_variant_get_byte (valueVar));
@@ -100,36 +91,36 @@ void HfpOfonoNetworkRegistration::getNetworkRegistrationProperties()
 	}
 }
 
-void HfpOfonoNetworkRegistration::handleNetworkRegistrationPropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData)
+void HfpOfonoNetworkRegistration::handleNetworkRegistrationPropertyChanged(GVariant *parameters)
 {
-	HfpOfonoNetworkRegistration *pThis = static_cast<HfpOfonoNetworkRegistration*>(userData);
-	if (!pThis)
-		return;
-
-	GVariant *va = g_variant_get_child_value(v, 0);
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(proxy));
+	LOOP_MONITOR_SCOPE();
+	const gchar *name = nullptr;
+	GVariant *va = nullptr;
+	g_variant_get(parameters, "(&sv)", &name, &va);
 
 	std::string key = name;
-	BT_DEBUG("%s property changed for device %s", key.c_str(), objectPath);
+	BT_DEBUG("%s property changed for device %s", key.c_str(), mObjectPath.c_str());
 
 	if (key == "Strength" && (g_variant_classify(va) == G_VARIANT_CLASS_BYTE))
 	{
-		pThis->networkSignalStrengthChanged(g_variant_get_byte (va));
+		networkSignalStrengthChanged(g_variant_get_byte (va));
 	}
 	else if (key == "Name" && (g_variant_classify(va) == G_VARIANT_CLASS_STRING))
 	{
 		gsize len;
 		const gchar* str = g_variant_get_string (va, &len);
 		if (len > 0)
-			pThis->networkOperatorNameChanged(std::string(str, len));
+			networkOperatorNameChanged(std::string(str, len));
 	}
 	else if (key == "Status" && (g_variant_classify(va) == G_VARIANT_CLASS_STRING))
 	{
 		gsize len;
 		const gchar* str = g_variant_get_string (va, &len);
 		if (len > 0)
-			pThis->networkRegistrationStatusChanged(std::string(str, len));
+			networkRegistrationStatusChanged(std::string(str, len));
 	}
+
+	g_variant_unref(va);
 }
 
 void HfpOfonoNetworkRegistration::networkSignalStrengthChanged(int networkSignalStrength)
@@ -18,13 +18,13 @@
 #define OFONO_NETWORK_REGISTRATION_H
 
 #include <string>
+#include <vector>
 #include <unordered_map>
 #include <memory>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#include <glib.h>
 
+class HfpOfonoClient;
 class HfpOfonoModem;
 
 class HfpOfonoNetworkRegistration
@@ -38,12 +38,15 @@ public:
 	void getNetworkRegistrationProperties();
 	int getNetworkSignalStrength() const { return mNetworkSignalStrength; }
 
-	static void handleNetworkRegistrationPropertyChanged(OfonoModem *proxy, char *name, GVariant *v, void *userData);
+	void handleNetworkRegistrationProperties(GVariant *out, GError *error);
+	void handleNetworkRegistrationPropertyChanged(GVariant *parameters);
 
 private:
 	HfpOfonoModem* mModem;
 	std::string mObjectPath;
-	OfonoNetworkRegistration* mOfonoNetworkRegistrationProxy;
+	HfpOfonoClient *mOfonoClient;
+	std::vector<guint> mPropertyChangedIds;
+	guint mPropertiesCallId;
 	int mNetworkSignalStrength;
 	std::string mNetworkOperatorName;
 	std::string mNetworkRegistrationStatus;
@@ -16,49 +16,48 @@
 
 #include "hfpofonovoicecall.h"
 #include "hfpofonomodem.h"
+#include "hfpofonoclient.h"
 #include "logging.h"
+#include "loopmonitor.h"
 #include <glib.h>
 #include <gio/gio.h>
 
-extern "C" {
-#include "ofono-interface.h"
-}
-
-HfpOfonoVoiceCall::HfpOfonoVoiceCall(const std::string& objectPath, HfpOfonoModem *modem):
+HfpOfonoVoiceCall::HfpOfonoVoiceCall(const std::string& objectPath, HfpOfonoModem *modem, GVariant *properties):
 mHfpModem(modem),
 mObjectPath(objectPath),
-mOfonoVoiceCallProxy(nullptr),
+mOfonoClient(modem->getOfonoClient()),
+mPropertiesCallId(0),
 mMultiparty(false),
 mEmergency(false)
 {
 	BT_DEBUG("ofono voiceCall instance created %s", objectPath.c_str());
-	GError *error = nullptr;
-	mOfonoVoiceCallProxy = ofono_voice_call_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", objectPath.c_str(), NULL, &error);
-	if (error)
-	{
-		BT_ERROR("Failed_to_create_ofono_voice_call_proxy", 0, "Failed to create dbus proxy for ofono voice call on path %s: %s",
-			  objectPath.c_str(), error->message);
-		g_error_free(error);
-		return;
-	}
 
-	getProperties();
+	// GetCalls and CallAdded already carry the properties of the call
+	if (properties)
+		updateProperties(properties);
+	else
+		getProperties();
 
-	g_signal_connect(G_OBJECT(mOfonoVoiceCallProxy), "property-changed", G_CALLBACK(handleVoiceCallPropertyChanged), this);
+	mPropertyChangedIds = mOfonoClient->subscribeProperties(OFONO::VOICECALL, mObjectPath, {"State", "LineIdentification"},
+	                                                       [this](GVariant *parameters) { handleVoiceCallPropertyChanged(parameters); });
 }
 
 HfpOfonoVoiceCall::~HfpOfonoVoiceCall()
 {
-	if (mOfonoVoiceCallProxy)
-		g_object_unref(mOfonoVoiceCallProxy);
+	mOfonoClient->cancel(mPropertiesCallId);
+	mOfonoClient->unsubscribe(mPropertyChangedIds);
 }
 
 void HfpOfonoVoiceCall::getProperties()
 {
-	GVariant *properties = NULL;
-    GError *error = NULL;
+	mOfonoClient->cancel(mPropertiesCallId);
+	mPropertiesCallId = mOfonoClient->call(mObjectPath, OFONO::VOICECALL, "GetProperties", NULL, G_VARIANT_TYPE("(a{sv})"),
+	                                       [this](GVariant *reply, GError *error) { handleProperties(reply, error); });
+}
 
-	(void) ofono_voice_call_call_get_properties_sync(mOfonoVoiceCallProxy, &properties, NULL, &error);
+void HfpOfonoVoiceCall::handleProperties(GVariant *reply, GError *error)
+{
+	mPropertiesCallId = 0;
 	if (error)
 	{
 		BT_ERROR("Failed_to_get_ofono_voice_call_property", 0, "Failed get properties from voicecall %s: %s",
@@ -66,6 +65,16 @@ void HfpOfonoVoiceCall::getProperties()
 		return;
 	}
 
+	GVariant *properties = g_variant_get_child_value(reply, 0);
+	updateProperties(properties);
+	g_variant_unref(properties);
+
+	mHfpModem->callAdded(this);
+	mHfpModem->updateState(this);
+}
+
+void HfpOfonoVoiceCall::updateProperties(GVariant *properties)
+{
 	g_autoptr(GVariantIter) iter = NULL;
 	g_variant_get(properties, "a{sv}", &iter);
 	gchar *name;
@@ -115,48 +124,53 @@ void HfpOfonoVoiceCall::updateProperties(const std::string &key, GVariant *value
 	}
 }
 
-void HfpOfonoVoiceCall::handleVoiceCallPropertyChanged(OfonoVoiceCall *object, const gchar *name, GVariant *value, void *userData)
+void HfpOfonoVoiceCall::handleVoiceCallPropertyChanged(GVariant *parameters)
 {
-	HfpOfonoVoiceCall *pThis = static_cast<HfpOfonoVoiceCall*>(userData);
-	if (!pThis)
-		return;
+	LOOP_MONITOR_SCOPE();
+	const gchar *name = nullptr;
+	GVariant *va = nullptr;
+	g_variant_get(parameters, "(&sv)", &name, &va);
 
-	GVariant *va = g_variant_get_child_value(value, 0);
-	const char *objectPath = g_dbus_proxy_get_object_path(G_DBUS_PROXY(object));
-
-	BT_DEBUG("voice call property changed for %s", objectPath);
+	BT_DEBUG("voice call property changed for %s", mObjectPath.c_str());
 
 	std::string key = name;
 
-	pThis->updateProperties(key, va);
+	updateProperties(key, va);
+	g_variant_unref(va);
 
 	//If state changes then only update all properties to up
 	if (key == "State")
-		pThis->mHfpModem->updateState(pThis);
+		mHfpModem->updateState(this);
 }
 
 bool HfpOfonoVoiceCall::answer()
 {
 	GError *error = nullptr;
-	(void) ofono_voice_call_call_answer_sync (mOfonoVoiceCallProxy, NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::VOICECALL, "Answer", NULL, NULL, &error);
 	if (error)
 	{
 		BT_ERROR("ANSWER_CALL_FAILED", 0, "reason %s", error->message);
+		g_error_free(error);
 		return false;
 	}
 
+	g_variant_unref(reply);
+
 	return true;
 }
 
 bool HfpOfonoVoiceCall::hangup()
 {
 	GError *error = nullptr;
-	(void) ofono_voice_call_call_hangup_sync (mOfonoVoiceCallProxy, NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::VOICECALL, "Hangup", NULL, NULL, &error);
 	if (error)
 	{
 		BT_ERROR("HANGUP_CALL_FAILED", 0, "reason %s", error->message);
+		g_error_free(error);
 		return false;
 	}
 
+	g_variant_unref(reply);
+
 	return true;
 }
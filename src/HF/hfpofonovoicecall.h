@@ -20,22 +20,22 @@
 #include <string>
 #include <vector>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#include <glib.h>
 
+class HfpOfonoClient;
 class HfpOfonoModem;
 
 class HfpOfonoVoiceCall
 {
 public:
-	HfpOfonoVoiceCall(const std::string& objectPath, HfpOfonoModem *modem);
+	HfpOfonoVoiceCall(const std::string& objectPath, HfpOfonoModem *modem, GVariant *properties = nullptr);
 	~HfpOfonoVoiceCall();
 
 	HfpOfonoVoiceCall(const HfpOfonoVoiceCall&) = delete;
 	HfpOfonoVoiceCall& operator = (const HfpOfonoVoiceCall&) = delete;
 
 	void getProperties();
+	void updateProperties(GVariant *properties);
 	void updateProperties(const std::string &key, GVariant *valueVar);
 	std::string getObjectPath() const { return mObjectPath; }
 	HfpOfonoModem *getModem() const { return mHfpModem; }
@@ -43,12 +43,15 @@ public:
 	std::string getLineIdentification() const { return mLineIdentification; }
 	bool answer();
 	bool hangup();
-	static void handleVoiceCallPropertyChanged(OfonoVoiceCall *object, const gchar *name, GVariant *value, void *userData);
+	void handleProperties(GVariant *reply, GError *error);
+	void handleVoiceCallPropertyChanged(GVariant *parameters);
 
 private:
 	HfpOfonoModem *mHfpModem;
 	std::string mObjectPath;
-	OfonoVoiceCall *mOfonoVoiceCallProxy;
+	HfpOfonoClient *mOfonoClient;
+	std::vector<guint> mPropertyChangedIds;
+	guint mPropertiesCallId;
 	std::string mLineIdentification;
 	std::string mIncomingLine;
 	std::string mName;
@@ -17,64 +17,86 @@
 #include "hfpofonovoicecallmanager.h"
 #include "hfpofonovoicecall.h"
 #include "hfpofonomodem.h"
+#include "hfpofonoclient.h"
 #include <glib.h>
 #include <gio/gio.h>
 #include <string>
+#include <unordered_set>
 #include "logging.h"
-
-extern "C" {
-#include "ofono-interface.h"
-}
+#include "loopmonitor.h"
 
 HfpOfonoVoiceCallManager::HfpOfonoVoiceCallManager(const std::string &objectPath, HfpOfonoModem *modem) :
 mModem(modem),
 mObjectPath(objectPath),
-mOfonoVoiceCallManagerProxy(nullptr)
+mOfonoClient(modem->getOfonoClient()),
+mCallAddedId(0),
+mCallRemovedId(0),
+mGetCallsId(0)
 {
-	GError* error = nullptr;
-	mOfonoVoiceCallManagerProxy = ofono_voice_call_manager_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.ofono", mObjectPath.c_str(), NULL, &error);
-	if (error)
-	{
-		BT_ERROR("MSGID_FAILED_TO_CREATE_OFONO_VOICE_MANAGER_PROXY", 0, "Failed to create dbus proxy for ofono voicemanager on path %s: %s",
-			  objectPath.c_str(), error->message);
-		g_error_free(error);
-		return;
-	}
+	mCallAddedId = mOfonoClient->subscribe(OFONO::VOICECALLMANAGER, "CallAdded", mObjectPath,
+	                                       [this](GVariant *parameters) { handleCallAdded(parameters); });
+	mCallRemovedId = mOfonoClient->subscribe(OFONO::VOICECALLMANAGER, "CallRemoved", mObjectPath,
+	                                         [this](GVariant *parameters) { handleCallRemoved(parameters); });
 
 	addExistingVoiceCalls();
-
-	g_signal_connect(G_OBJECT(mOfonoVoiceCallManagerProxy), "call-added", G_CALLBACK(handleCallAdded), this);
-	g_signal_connect(G_OBJECT(mOfonoVoiceCallManagerProxy), "call-removed", G_CALLBACK(handleCallRemoved), this);
 }
 
 HfpOfonoVoiceCallManager::~HfpOfonoVoiceCallManager()
 {
-	if (mOfonoVoiceCallManagerProxy)
-		g_object_unref(mOfonoVoiceCallManagerProxy);
+	mOfonoClient->cancel(mGetCallsId);
+	mOfonoClient->unsubscribe(mCallAddedId);
+	mOfonoClient->unsubscribe(mCallRemovedId);
 }
 
 void HfpOfonoVoiceCallManager::addExistingVoiceCalls()
 {
-	GError *error = 0;
-	GVariant *voiceCalls;
+	mOfonoClient->cancel(mGetCallsId);
+	mGetCallsId = mOfonoClient->call(mObjectPath, OFONO::VOICECALLMANAGER, "GetCalls", NULL, G_VARIANT_TYPE("(a(oa{sv}))"),
+	                                 [this](GVariant *reply, GError *error) { handleGetCalls(reply, error); });
+}
 
-	ofono_voice_call_manager_call_get_calls_sync(mOfonoVoiceCallManagerProxy, &voiceCalls, NULL, &error);
+void HfpOfonoVoiceCallManager::handleGetCalls(GVariant *voiceCalls, GError *error)
+{
+	mGetCallsId = 0;
 	if (error)
 	{
 		BT_ERROR("BT_VOICE_CALL_MANAGER_ERROR", 0, "Failed to call: %s", error->message);
-		g_error_free(error);
 		return;
 	}
 
+	updateVoiceCalls(voiceCalls);
+}
+
+void HfpOfonoVoiceCallManager::updateVoiceCalls(GVariant *voiceCalls)
+{
 	g_autoptr(GVariantIter) iter1 = NULL;
-	g_variant_get (voiceCalls, "a(oa{sv})", &iter1);
+	g_variant_get (voiceCalls, "(a(oa{sv}))", &iter1);
 
 	const gchar *voiceObjectPath;
-	g_autoptr(GVariantIter) iter2 = NULL;
+	GVariant *properties = NULL;
+	std::unordered_set<std::string> present;
 
-	while (g_variant_iter_loop (iter1, "(&oa{sv})", &voiceObjectPath, &iter2))
+	while (g_variant_iter_loop (iter1, "(&o@a{sv})", &voiceObjectPath, &properties))
 	{
-		std::unique_ptr<HfpOfonoVoiceCall> call (new HfpOfonoVoiceCall(voiceObjectPath, mModem));
+		present.insert(voiceObjectPath);
+
+		// A call that is already known, e.g. from before oFono restarted,
+		// only reports what differs from the state the device still holds
+		auto it = mCallMap.find(voiceObjectPath);
+		if (it != mCallMap.end())
+		{
+			HfpOfonoVoiceCall *call = it->second.get();
+			std::string state = call->getCallState();
+			std::string lineIdentification = call->getLineIdentification();
+			call->updateProperties(properties);
+			if (call->getLineIdentification() != lineIdentification)
+				mModem->callAdded(call);
+			if (call->getCallState() != state || call->getLineIdentification() != lineIdentification)
+				mModem->updateState(call);
+			continue;
+		}
+
+		std::unique_ptr<HfpOfonoVoiceCall> call (new HfpOfonoVoiceCall(voiceObjectPath, mModem, properties));
 
 		if (mModem)
 		{
@@ -84,14 +106,36 @@ void HfpOfonoVoiceCallManager::addExistingVoiceCalls()
 			mCallMap[voiceObjectPath] = std::move(call);
 		}
 	}
+
+	for (auto it = mCallMap.begin(); it != mCallMap.end();)
+	{
+		if (present.find(it->first) != present.end())
+		{
+			it++;
+			continue;
+		}
+
+		BT_DEBUG("Call %s ended while it was not tracked", it->first.c_str());
+		mModem->callRemoved(it->second.get());
+		it = mCallMap.erase(it);
+	}
+}
+
+void HfpOfonoVoiceCallManager::removeVoiceCalls()
+{
+	for (auto &call : mCallMap)
+		mModem->callRemoved(call.second.get());
+
+	mCallMap.clear();
 }
 
 std::string HfpOfonoVoiceCallManager::dial(const std::string &phoneNumber)
 {
-	gchar *outPath = nullptr;
+	const gchar *outPath = nullptr;
 	GError *error = nullptr;
 	std::string callId = "";
-	ofono_voice_call_manager_call_dial_sync(mOfonoVoiceCallManagerProxy, phoneNumber.c_str(), "default", &outPath, NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::VOICECALLMANAGER, "Dial", g_variant_new("(ss)", phoneNumber.c_str(), "default"),
+	                                     G_VARIANT_TYPE("(o)"), &error);
 	if (error)
 	{
 		BT_ERROR("BT_DIAL_ERROR", 0, "Not able to make call error  %s", error->message);
@@ -99,7 +143,9 @@ std::string HfpOfonoVoiceCallManager::dial(const std::string &phoneNumber)
 		return std::string("");
 	}
 
+	g_variant_get(reply, "(&o)", &outPath);
 	std::string voicePath = outPath;
+	g_variant_unref(reply);
 	std::size_t found = voicePath.find_last_of("/");
 	if (found != std::string::npos)
 	{
@@ -113,7 +159,7 @@ std::string HfpOfonoVoiceCallManager::dial(const std::string &phoneNumber)
 bool HfpOfonoVoiceCallManager::holdAndAnswer()
 {
 	GError *error = nullptr;
-	ofono_voice_call_manager_call_hold_and_answer_sync(mOfonoVoiceCallManagerProxy, NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::VOICECALLMANAGER, "HoldAndAnswer", NULL, NULL, &error);
 	if (error)
 	{
 		BT_ERROR("BT_HOLD_AND_ANSWER_ERROR", 0, "Not able to hold and answer error  %s", error->message);
@@ -121,13 +167,15 @@ bool HfpOfonoVoiceCallManager::holdAndAnswer()
 		return false;
 	}
 
+	g_variant_unref(reply);
+
 	return true;
 }
 
 bool HfpOfonoVoiceCallManager::mergeCalls()
 {
 	GError *error = nullptr;
-	ofono_voice_call_manager_call_create_multiparty_sync(mOfonoVoiceCallManagerProxy, NULL, NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::VOICECALLMANAGER, "CreateMultiparty", NULL, NULL, &error);
 	if (error)
 	{
 		BT_ERROR("BT_CREATE_MUTLTI_PARTY_ERROR", 0, "Not able to mergeCalls error  %s", error->message);
@@ -135,13 +183,15 @@ bool HfpOfonoVoiceCallManager::mergeCalls()
 		return false;
 	}
 
+	g_variant_unref(reply);
+
 	return true;
 }
 
 bool HfpOfonoVoiceCallManager::releaseAndAnswer()
 {
 	GError *error = nullptr;
-	ofono_voice_call_manager_call_release_and_answer_sync(mOfonoVoiceCallManagerProxy, NULL, &error);
+	GVariant *reply = mOfonoClient->call(mObjectPath, OFONO::VOICECALLMANAGER, "ReleaseAndAnswer", NULL, NULL, &error);
 	if (error)
 	{
 		BT_ERROR("BT_RELEASE_AND_ANSWER_ERROR", 0, "Not able to releaseAndAnswer error  %s", error->message);
@@ -149,6 +199,8 @@ bool HfpOfonoVoiceCallManager::releaseAndAnswer()
 		return false;
 	}
 
+	g_variant_unref(reply);
+
 	return true;
 }
 
@@ -193,37 +245,39 @@ HfpOfonoVoiceCall* HfpOfonoVoiceCallManager::getVoiceCall(int idx)
 	return nullptr;
 }
 
-void HfpOfonoVoiceCallManager::handleCallAdded(OfonoVoiceCallManager *object, const gchar *path, GVariant *properties, void *userData)
+void HfpOfonoVoiceCallManager::handleCallAdded(GVariant *parameters)
 {
-	HfpOfonoVoiceCallManager *pThis = static_cast<HfpOfonoVoiceCallManager*>(userData);
-	if (!pThis)
-		return;
+	LOOP_MONITOR_SCOPE();
+	const gchar *path = nullptr;
+	GVariant *properties = nullptr;
+	g_variant_get(parameters, "(&o@a{sv})", &path, &properties);
 
 	BT_DEBUG("callAdded %s", path);
-	std::unique_ptr<HfpOfonoVoiceCall> call (new HfpOfonoVoiceCall(path, pThis->mModem));
+	std::unique_ptr<HfpOfonoVoiceCall> call (new HfpOfonoVoiceCall(path, mModem, properties));
+	g_variant_unref(properties);
 
-	if (pThis->mModem)
+	if (mModem)
 	{
-		pThis->mModem->callAdded(call.get());
-		pThis->mModem->updateState(call.get());
+		mModem->callAdded(call.get());
+		mModem->updateState(call.get());
 
-		pThis->mCallMap[path] = std::move(call);
+		mCallMap[path] = std::move(call);
 	}
 }
 
-void HfpOfonoVoiceCallManager::handleCallRemoved(OfonoVoiceCallManager *object, const gchar *path, void *userData)
+void HfpOfonoVoiceCallManager::handleCallRemoved(GVariant *parameters)
 {
-	BT_DEBUG("callRemoved %s", path);
-	HfpOfonoVoiceCallManager *pThis = static_cast<HfpOfonoVoiceCallManager*>(userData);
-	if (!pThis)
-		return;
+	LOOP_MONITOR_SCOPE();
+	const gchar *path = nullptr;
+	g_variant_get(parameters, "(&o)", &path);
 
-	auto it = pThis->mCallMap.find(path);
+	BT_DEBUG("callRemoved %s", path);
+	auto it = mCallMap.find(path);
 
-	if (it != pThis->mCallMap.end())
+	if (it != mCallMap.end())
 		it->second->getModem()->callRemoved(it->second.get());
 
-	pThis->mCallMap.erase(path);
+	mCallMap.erase(path);
 }
 
 bool HfpOfonoVoiceCallManager::releaseHeldCalls()
@@ -21,10 +21,9 @@
 #include <unordered_map>
 #include <memory>
 
-extern "C" {
-#include "ofono-interface.h"
-}
+#include <glib.h>
 
+class HfpOfonoClient;
 class HfpOfonoVoiceCall;
 class HfpOfonoModem;
 
@@ -37,6 +36,8 @@ public:
 	HfpOfonoVoiceCallManager& operator = (const HfpOfonoVoiceCallManager&) = delete;
 
 	void addExistingVoiceCalls();
+	void updateVoiceCalls(GVariant *voiceCalls);
+	void removeVoiceCalls();
 	std::string dial(const std::string &phoneNumber);
 	HfpOfonoVoiceCall* getVoiceCall(const std::string &state);
 	HfpOfonoVoiceCall* getVoiceCall(int index);
@@ -45,13 +46,17 @@ public:
 	bool releaseAndAnswer();
 	bool releaseHeldCalls();
 
-	static void handleCallAdded(OfonoVoiceCallManager *object, const gchar *path, GVariant *properties, void *userData);
-	static void handleCallRemoved(OfonoVoiceCallManager *object, const gchar *path, void *userData);
+	void handleGetCalls(GVariant *voiceCalls, GError *error);
+	void handleCallAdded(GVariant *parameters);
+	void handleCallRemoved(GVariant *parameters);
 
 private:
 	HfpOfonoModem* mModem;
 	std::string mObjectPath;
-	OfonoVoiceCallManager* mOfonoVoiceCallManagerProxy;
+	HfpOfonoClient *mOfonoClient;
+	guint mCallAddedId;
+	guint mCallRemovedId;
+	guint mGetCallsId;
 	std::unordered_map <std::string, std::unique_ptr <HfpOfonoVoiceCall>> mCallMap;
 };
 
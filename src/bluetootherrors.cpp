@@ -47,7 +47,10 @@ static std::map<BluetoothErrorCode, std::string> bluetoothErrorTextTable =
 	{BT_ERR_NO_WAITING_VOICE_CALL, "No waiting voice call"},
 	{BT_ERR_NO_HELD_VOICE_CALL, "No voice call on hold"},
 	{BT_ERR_MERGE_VOICE_CALL_FAILED, "Merge voice call failed"},
-	{BT_ERR_RELEASE_ACTIVE_CALLS_FAILED, "Release Active voice call failed"}
+	{BT_ERR_RELEASE_ACTIVE_CALLS_FAILED, "Release Active voice call failed"},
+	{BT_ERR_AT_RESPONSE_TIMEOUT, "No response from the device"},
+	{BT_ERR_FIELDS_PARAM_INVALID, "'fields' parameter contains an unknown field"},
+	{BT_ERR_SESSION_NOT_RESOLVED, "Session of the caller could not be resolved"}
 };
 
 const std::string retrieveErrorText(BluetoothErrorCode errorCode)
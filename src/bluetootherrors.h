@@ -47,7 +47,10 @@ enum BluetoothErrorCode
 	BT_ERR_NO_HELD_VOICE_CALL,
 	BT_ERR_MERGE_VOICE_CALL_FAILED,
 	BT_ERR_HOLD_ACTIVE_CALLS_FAILED,
-	BT_ERR_RELEASE_ACTIVE_CALLS_FAILED
+	BT_ERR_RELEASE_ACTIVE_CALLS_FAILED,
+	BT_ERR_AT_RESPONSE_TIMEOUT,
+	BT_ERR_FIELDS_PARAM_INVALID,
+	BT_ERR_SESSION_NOT_RESOLVED
 };
 
 const std::string retrieveErrorText(BluetoothErrorCode errorCode);
@@ -19,6 +19,10 @@
 #include "bluetoothhfpservice.h"
 #include "AG/hfpagrole.h"
 #include "HF/hfphfrole.h"
+#include "ls2utils.h"
+#include "loopmonitor.h"
+#include "startuptrace.h"
+#include "statejournal.h"
 #include "utils.h"
 #include "logging.h"
 #include "config.h"
@@ -28,7 +32,18 @@ BluetoothHfpService::BluetoothHfpService() :
 	mAGRole(nullptr),
 	mHFRole(nullptr)
 {
+	LS_CREATE_CATEGORY_BEGIN(BluetoothHfpService, base)
+		LS_CATEGORY_MONITORED_METHOD(getLoopStatus)
+		LS_CATEGORY_MONITORED_METHOD(getStartupTrace)
+		LS_CATEGORY_MONITORED_METHOD(flushJournal)
+	LS_CREATE_CATEGORY_END
+
+	registerCategory("/", LS_CATEGORY_TABLE_NAME(base), nullptr, nullptr);
+	setCategoryData("/", this);
+	StartupTrace::getInstance().mark("registered");
+
 	initialize();
+	StartupTrace::getInstance().mark("rolesInitialized");
 }
 
 BluetoothHfpService::~BluetoothHfpService()
@@ -64,3 +79,84 @@ void BluetoothHfpService::initialize()
 		mAGRole->initialize();
 	}
 }
+
+bool BluetoothHfpService::getLoopStatus(LSMessage &message)
+{
+	LS::Message request(&message);
+	pbnjson::JValue requestObj;
+	int parseError = 0;
+
+	const std::string schema = STRICT_SCHEMA(PROPS_1(PROP(heartbeat, boolean)));
+
+	if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+	{
+		if (JSON_PARSE_SCHEMA_ERROR == parseError)
+			LSUtils::respondWithError(request, BT_ERR_SCHEMA_VALIDATION_FAIL);
+		else
+			LSUtils::respondWithError(request, BT_ERR_BAD_JSON);
+		return true;
+	}
+
+	// The heartbeat is switched on only while someone looks into lag
+	if (requestObj.hasKey("heartbeat"))
+	{
+		if (requestObj["heartbeat"].asBool())
+			LoopMonitor::getInstance().start();
+		else
+			LoopMonitor::getInstance().stop();
+	}
+
+	pbnjson::JValue responseObj = LoopMonitor::getInstance().getStatus();
+	if (mHFRole)
+		responseObj.put("hf", mHFRole->getLoopStatus());
+	responseObj.put("returnValue", true);
+	LSUtils::postToClient(request, responseObj);
+	return true;
+}
+
+bool BluetoothHfpService::getStartupTrace(LSMessage &message)
+{
+	LS::Message request(&message);
+	pbnjson::JValue requestObj;
+	int parseError = 0;
+
+	const std::string schema = STRICT_SCHEMA("");
+
+	if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+	{
+		if (JSON_PARSE_SCHEMA_ERROR == parseError)
+			LSUtils::respondWithError(request, BT_ERR_SCHEMA_VALIDATION_FAIL);
+		else
+			LSUtils::respondWithError(request, BT_ERR_BAD_JSON);
+		return true;
+	}
+
+	pbnjson::JValue responseObj = StartupTrace::getInstance().getStatus();
+	responseObj.put("returnValue", true);
+	LSUtils::postToClient(request, responseObj);
+	return true;
+}
+
+bool BluetoothHfpService::flushJournal(LSMessage &message)
+{
+	LS::Message request(&message);
+	pbnjson::JValue requestObj;
+	int parseError = 0;
+
+	const std::string schema = STRICT_SCHEMA("");
+
+	if (!LSUtils::parsePayload(request.getPayload(), requestObj, schema, &parseError))
+	{
+		if (JSON_PARSE_SCHEMA_ERROR == parseError)
+			LSUtils::respondWithError(request, BT_ERR_SCHEMA_VALIDATION_FAIL);
+		else
+			LSUtils::respondWithError(request, BT_ERR_BAD_JSON);
+		return true;
+	}
+
+	bool flushed = StateJournal::getInstance().flush();
+	pbnjson::JValue responseObj = StateJournal::getInstance().getStatus();
+	responseObj.put("returnValue", flushed);
+	LSUtils::postToClient(request, responseObj);
+	return true;
+}
@@ -29,6 +29,10 @@ public:
 	BluetoothHfpService();
 	~BluetoothHfpService();
 
+	bool getLoopStatus(LSMessage &message);
+	bool getStartupTrace(LSMessage &message);
+	bool flushJournal(LSMessage &message);
+
 private:
 	void initialize();
 
@@ -14,7 +14,9 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 
+#include <algorithm>
 #include <map>
+#include <string>
 #include <stdint.h>
 
 #include "dbusutils.h"
@@ -48,32 +50,210 @@ void checkBus(GBusType busType, StatusCallback callback)
 	          new GlibAsyncFunctionWrapper(busGetCallback));
 }
 
-void waitForBus(GBusType busType, StatusCallback callback)
+static std::string getBusSocketPath(GBusType busType)
+{
+	const char *address = g_getenv(busType == G_BUS_TYPE_SYSTEM ? "DBUS_SYSTEM_BUS_ADDRESS" : "DBUS_SESSION_BUS_ADDRESS");
+	if (!address && busType == G_BUS_TYPE_SYSTEM)
+		address = "unix:path=/var/run/dbus/system_bus_socket";
+	if (!address)
+		return std::string();
+
+	// Only the first address is watched, abstract sockets have no file
+	std::string first(address);
+	first = first.substr(0, first.find(';'));
+	const std::string prefix = "unix:path=";
+	if (first.compare(0, prefix.size(), prefix) != 0)
+		return std::string();
+
+	return first.substr(prefix.size(), first.find(',') - prefix.size());
+}
+
+/*
+ * Waits for a bus without polling it. The directory of the bus socket is
+ * watched, which is backed by inotify, and the bus is tried again whenever
+ * the socket shows up. A bus whose socket can not be watched is retried
+ * once a second instead.
+ *
+ * The daemon binds its socket before it listens on it, so a refused
+ * connection on an existing socket is retried with a short backoff. While
+ * the socket is missing a slow retry covers events the watch may miss.
+ */
+#define BUS_RETRY_MIN_MS       5
+#define BUS_RETRY_MAX_MS       2000
+#define BUS_RETRY_FALLBACK_MS  10000
+
+class BusWaiter
 {
-	auto busStatusCallback = [busType, callback](bool available) {
-		if (!available)
+public:
+	BusWaiter(GBusType busType, StatusCallback callback) :
+		mBusType(busType),
+		mCallback(callback),
+		mMonitor(nullptr),
+		mStart(g_get_monotonic_time()),
+		mAttempts(0),
+		mChecking(false),
+		mRecheck(false),
+		mRetrySource(0),
+		mRetryMs(BUS_RETRY_MIN_MS)
+	{
+	}
+
+	~BusWaiter()
+	{
+		if (mRetrySource)
+			g_source_remove(mRetrySource);
+		if (mMonitor)
+			g_object_unref(mMonitor);
+	}
+
+	void check()
+	{
+		// Events that arrive while the bus is tried are folded into one retry
+		if (mChecking)
 		{
-			auto timeoutCallback = [busType, callback]() {
-				waitForBus(busType, callback);
-				return false;
-			};
+			mRecheck = true;
+			return;
+		}
 
-			g_timeout_add(100, glibSourceMethodWrapper,
-			              new GlibSourceFunctionWrapper(timeoutCallback));
+		if (mRetrySource)
+		{
+			g_source_remove(mRetrySource);
+			mRetrySource = 0;
+		}
+
+		mChecking = true;
+		mRecheck = false;
+		mAttempts++;
+		checkBus(mBusType, [this](bool available) {
+			mChecking = false;
+			if (available)
+			{
+				BT_DEBUG("Bus %d available after %lld ms, %d attempts", mBusType,
+				         (long long) ((g_get_monotonic_time() - mStart) / 1000), mAttempts);
+				mCallback(true);
+				delete this;
+				return;
+			}
+
+			if (mRecheck)
+				check();
+			else if (mMonitor)
+				scheduleRetry();
+			else if (!watchSocket())
+			{
+				g_timeout_add_seconds(1, glibSourceMethodWrapper, new GlibSourceFunctionWrapper([this]() {
+					check();
+					return false;
+				}));
+			}
+		});
+	}
+
+private:
+	void scheduleRetry()
+	{
+		if (mRetrySource)
 			return;
+
+		guint delayMs = BUS_RETRY_FALLBACK_MS;
+		if (g_file_test(mSocketPath.c_str(), G_FILE_TEST_EXISTS))
+		{
+			delayMs = mRetryMs;
+			mRetryMs = std::min<guint>(mRetryMs * 2, BUS_RETRY_MAX_MS);
+		}
+		else
+		{
+			mRetryMs = BUS_RETRY_MIN_MS;
 		}
 
-		callback(true);
-	};
+		mRetrySource = g_timeout_add(delayMs, handleRetry, this);
+	}
 
-	checkBus(busType, busStatusCallback);
+	static gboolean handleRetry(gpointer userData)
+	{
+		BusWaiter *waiter = static_cast<BusWaiter*>(userData);
+		waiter->mRetrySource = 0;
+		waiter->check();
+		return FALSE;
+	}
+
+	bool watchSocket()
+	{
+		std::string socketPath = getBusSocketPath(mBusType);
+		if (socketPath.empty())
+			return false;
+
+		gchar *dirName = g_path_get_dirname(socketPath.c_str());
+		gchar *baseName = g_path_get_basename(socketPath.c_str());
+		mSocketPath = socketPath;
+		mSocketName = baseName;
+
+		GFile *dir = g_file_new_for_path(dirName);
+		mMonitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL);
+		g_object_unref(dir);
+		g_free(dirName);
+		g_free(baseName);
+
+		if (!mMonitor)
+			return false;
+
+		g_signal_connect(mMonitor, "changed", G_CALLBACK(handleSocketChanged), this);
+
+		// The socket may have been created before the watch was in place
+		check();
+		return true;
+	}
+
+	static void handleSocketChanged(GFileMonitor *monitor, GFile *file, GFile *otherFile, GFileMonitorEvent event,
+	                                gpointer userData)
+	{
+		BusWaiter *waiter = static_cast<BusWaiter*>(userData);
+		if (event != G_FILE_MONITOR_EVENT_CREATED)
+			return;
+
+		gchar *baseName = g_file_get_basename(file);
+		bool isSocket = waiter->mSocketName == baseName;
+		g_free(baseName);
+
+		if (isSocket)
+			waiter->check();
+	}
+
+	GBusType mBusType;
+	StatusCallback mCallback;
+	GFileMonitor *mMonitor;
+	std::string mSocketPath;
+	std::string mSocketName;
+	gint64 mStart;
+	int mAttempts;
+	bool mChecking;
+	bool mRecheck;
+	guint mRetrySource;
+	guint mRetryMs;
+};
+
+void waitForBus(GBusType busType, StatusCallback callback)
+{
+	if (!callback)
+		return;
+
+	BusWaiter *waiter = new BusWaiter(busType, callback);
+	waiter->check();
 }
 
 NameWatch::NameWatch(GBusType busType, const std::string &name) :
-    mWatch(0)
+    mWatch(0),
+    mAlive(std::make_shared<bool>(true))
 {
-	mWatch = g_bus_watch_name(busType, name.c_str(), G_BUS_NAME_WATCHER_FLAGS_NONE,
-	                          handleNameAppeared, handleNameDisappeared, this, NULL);
+	// Watching a name needs the bus, the owner is reported once it is there
+	std::weak_ptr<bool> alive = mAlive;
+	waitForBus(busType, [this, alive, busType, name](bool available) {
+		if (alive.expired())
+			return;
+
+		mWatch = g_bus_watch_name(busType, name.c_str(), G_BUS_NAME_WATCHER_FLAGS_NONE,
+		                          handleNameAppeared, handleNameDisappeared, this, NULL);
+	});
 }
 
 NameWatch::~NameWatch()
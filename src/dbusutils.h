@@ -18,6 +18,7 @@
 #define DBUSCONNECTION_H
 
 #include <functional>
+#include <memory>
 #include <string>
 
 #include <glib.h>
@@ -30,6 +31,7 @@ namespace DBusUtils
 	typedef std::function<void(bool)> StatusCallback;
 
 	void checkBus(GBusType busType, StatusCallback callback);
+	// Calls back once the bus can be connected to, without polling it
 	void waitForBus(GBusType busType, StatusCallback callback);
 
 	class NameWatch
@@ -43,6 +45,7 @@ namespace DBusUtils
 	private:
 		uint32_t mWatch;
 		StatusCallback mCallback;
+		std::shared_ptr<bool> mAlive;
 
 		static void handleNameAppeared(GDBusConnection *conn, const gchar *name, const gchar *nameOwner, gpointer user_data);
 		static void handleNameDisappeared(GDBusConnection *conn, const gchar *name, gpointer user_data);
@@ -0,0 +1,182 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cmath>
+#include <cstdlib>
+
+#include "jsonsaxparser.h"
+
+JsonSaxParser::JsonSaxParser()
+{
+}
+
+JsonSaxParser::~JsonSaxParser()
+{
+}
+
+void JsonSaxParser::bindString(const std::string &path, StringHandler handler)
+{
+	mStringHandlers[path] = handler;
+}
+
+void JsonSaxParser::bindNumber(const std::string &path, NumberHandler handler)
+{
+	mNumberHandlers[path] = handler;
+}
+
+void JsonSaxParser::bindBoolean(const std::string &path, BooleanHandler handler)
+{
+	mBooleanHandlers[path] = handler;
+}
+
+void JsonSaxParser::bindObject(const std::string &path, ContainerHandler handler)
+{
+	mObjectHandlers[path] = handler;
+}
+
+void JsonSaxParser::bindArray(const std::string &path, ContainerHandler handler)
+{
+	mArrayHandlers[path] = handler;
+}
+
+bool JsonSaxParser::parse(const std::string &payload)
+{
+	mContainers.clear();
+	mPath.clear();
+
+	return pbnjson::JParser::parse(payload, pbnjson::JSchema::AllSchema());
+}
+
+void JsonSaxParser::openContainer(bool isArray)
+{
+	// All elements of an array share one path, members get theirs per key
+	mContainers.push_back({mPath.length(), isArray});
+	if (isArray)
+		mPath += "[]";
+}
+
+void JsonSaxParser::closeContainer()
+{
+	if (mContainers.empty())
+		return;
+
+	// Back to the path of the container, which also is the path of the
+	// next element when the parent is an array
+	mPath.resize(mContainers.back().pathLength);
+	mContainers.pop_back();
+}
+
+bool JsonSaxParser::jsonObjectOpen()
+{
+	auto handler = mObjectHandlers.find(mPath);
+	if (handler != mObjectHandlers.end())
+		handler->second();
+
+	openContainer(false);
+	return true;
+}
+
+bool JsonSaxParser::jsonObjectKey(const std::string &key)
+{
+	if (mContainers.empty())
+		return true;
+
+	std::size_t pathLength = mContainers.back().pathLength;
+	mPath.resize(pathLength);
+	if (pathLength)
+		mPath += '.';
+	mPath += key;
+	return true;
+}
+
+bool JsonSaxParser::jsonObjectClose()
+{
+	closeContainer();
+	return true;
+}
+
+bool JsonSaxParser::jsonArrayOpen()
+{
+	auto handler = mArrayHandlers.find(mPath);
+	if (handler != mArrayHandlers.end())
+		handler->second();
+
+	openContainer(true);
+	return true;
+}
+
+bool JsonSaxParser::jsonArrayClose()
+{
+	closeContainer();
+	return true;
+}
+
+bool JsonSaxParser::jsonString(const std::string &s)
+{
+	auto handler = mStringHandlers.find(mPath);
+	if (handler != mStringHandlers.end())
+		handler->second(s);
+
+	return true;
+}
+
+bool JsonSaxParser::jsonNumber(const std::string &n)
+{
+	auto handler = mNumberHandlers.find(mPath);
+	if (handler != mNumberHandlers.end())
+		handler->second(std::strtoll(n.c_str(), nullptr, 10));
+
+	return true;
+}
+
+bool JsonSaxParser::jsonNumber(int64_t number)
+{
+	auto handler = mNumberHandlers.find(mPath);
+	if (handler != mNumberHandlers.end())
+		handler->second(number);
+
+	return true;
+}
+
+bool JsonSaxParser::jsonNumber(double &number, ConversionResultFlags asFloat)
+{
+	// Numbers that do not parse as an int64 come here. They are only handed
+	// out when they convert exactly, a lossy, fractional or out of range
+	// value is skipped as if it was not bound
+	if (asFloat != CONV_OK || number != std::trunc(number) ||
+	    number < -9223372036854775808.0 || number >= 9223372036854775808.0)
+		return true;
+
+	auto handler = mNumberHandlers.find(mPath);
+	if (handler != mNumberHandlers.end())
+		handler->second(static_cast<int64_t>(number));
+
+	return true;
+}
+
+bool JsonSaxParser::jsonBoolean(bool truth)
+{
+	auto handler = mBooleanHandlers.find(mPath);
+	if (handler != mBooleanHandlers.end())
+		handler->second(truth);
+
+	return true;
+}
+
+bool JsonSaxParser::jsonNull()
+{
+	return true;
+}
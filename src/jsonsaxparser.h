@@ -0,0 +1,88 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef JSONSAXPARSER_H_
+#define JSONSAXPARSER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <pbnjson.hpp>
+
+/*
+ * Selective JSON reader built on the pbnjson SAX interface.
+ *
+ * Handlers are bound to a value path, where object members are joined
+ * with '.' and array elements are written as "[]", for example
+ * "devices[].address" or "lines[].calls[].id". Only bound values are
+ * handed out; everything else is skipped without building a DOM.
+ */
+class JsonSaxParser : public pbnjson::JParser
+{
+public:
+	typedef std::function<void(const std::string &)> StringHandler;
+	typedef std::function<void(int64_t)> NumberHandler;
+	typedef std::function<void(bool)> BooleanHandler;
+	typedef std::function<void()> ContainerHandler;
+
+	JsonSaxParser();
+	~JsonSaxParser();
+
+	void bindString(const std::string &path, StringHandler handler);
+	void bindNumber(const std::string &path, NumberHandler handler);
+	void bindBoolean(const std::string &path, BooleanHandler handler);
+	void bindObject(const std::string &path, ContainerHandler handler);
+	void bindArray(const std::string &path, ContainerHandler handler);
+
+	bool parse(const std::string &payload);
+
+protected:
+	bool jsonObjectOpen() override;
+	bool jsonObjectKey(const std::string &key) override;
+	bool jsonObjectClose() override;
+	bool jsonArrayOpen() override;
+	bool jsonArrayClose() override;
+	bool jsonString(const std::string &s) override;
+	bool jsonNumber(const std::string &n) override;
+	bool jsonNumber(int64_t number) override;
+	bool jsonNumber(double &number, ConversionResultFlags asFloat) override;
+	bool jsonBoolean(bool truth) override;
+	bool jsonNull() override;
+	NumberType conversionToUse() const override { return JNUM_CONV_NATIVE; }
+
+private:
+	void openContainer(bool isArray);
+	void closeContainer();
+
+	struct Container
+	{
+		std::size_t pathLength; //length of the path of the container itself
+		bool isArray;
+	};
+
+	std::unordered_map<std::string, StringHandler> mStringHandlers;
+	std::unordered_map<std::string, NumberHandler> mNumberHandlers;
+	std::unordered_map<std::string, BooleanHandler> mBooleanHandlers;
+	std::unordered_map<std::string, ContainerHandler> mObjectHandlers;
+	std::unordered_map<std::string, ContainerHandler> mArrayHandlers;
+	std::vector<Container> mContainers;
+	std::string mPath; //path of the next value, kept in place as the parser moves
+};
+
+#endif //JSONSAXPARSER_H_
@@ -0,0 +1,161 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "loopmonitor.h"
+#include "logging.h"
+
+LoopMonitor::Scope::Scope(const char *name) :
+	mName(name),
+	mStart(g_get_monotonic_time())
+{
+}
+
+LoopMonitor::Scope::~Scope()
+{
+	gint64 durationMs = (g_get_monotonic_time() - mStart) / 1000;
+	LoopMonitor &monitor = LoopMonitor::getInstance();
+	if (durationMs >= monitor.mThresholdMs)
+		monitor.record(HANDLER, mName, durationMs);
+}
+
+LoopMonitor& LoopMonitor::getInstance()
+{
+	static LoopMonitor monitor;
+	return monitor;
+}
+
+LoopMonitor::LoopMonitor(unsigned int heartbeatMs, unsigned int thresholdMs) :
+	mHeartbeatMs(heartbeatMs),
+	mThresholdMs(thresholdMs),
+	mHeartbeatSource(0),
+	mLastBeat(0),
+	mLastLagMs(0),
+	mMaxLagMs(0),
+	mBeats(0),
+	mLagStalls(0),
+	mHandlerStalls(0),
+	mNextStall(0),
+	mStallCount(0)
+{
+}
+
+LoopMonitor::~LoopMonitor()
+{
+	stop();
+}
+
+void LoopMonitor::start()
+{
+	if (mHeartbeatSource)
+		return;
+
+	mLastBeat = g_get_monotonic_time();
+	mHeartbeatSource = g_timeout_add_full(G_PRIORITY_HIGH, mHeartbeatMs, handleHeartbeat, this, nullptr);
+}
+
+void LoopMonitor::stop()
+{
+	if (mHeartbeatSource)
+	{
+		g_source_remove(mHeartbeatSource);
+		mHeartbeatSource = 0;
+	}
+}
+
+void LoopMonitor::record(StallType type, const char *name, gint64 durationMs)
+{
+	if (type == HANDLER)
+	{
+		mHandlerStalls++;
+		BT_WARNING("MSGID_LOOP_SLOW_HANDLER", 0, "%s blocked the main loop for %lld ms", name ? name : "", (long long) durationMs);
+	}
+	else
+	{
+		mLagStalls++;
+		BT_WARNING("MSGID_LOOP_LAG", 0, "Main loop dispatch lagged by %lld ms", (long long) durationMs);
+	}
+
+	Stall &stall = mStalls[mNextStall];
+	stall.type = type;
+	stall.name = name ? name : "";
+	stall.durationMs = durationMs;
+	stall.timestamp = g_get_monotonic_time();
+
+	mNextStall = (mNextStall + 1) % mStalls.size();
+	if (mStallCount < mStalls.size())
+		mStallCount++;
+}
+
+void LoopMonitor::beat()
+{
+	// The timeout is rearmed when it is dispatched, so anything past one
+	// interval since the previous beat is time the loop spent elsewhere
+	gint64 now = g_get_monotonic_time();
+	gint64 lagMs = (now - mLastBeat) / 1000 - mHeartbeatMs;
+	if (lagMs < 0)
+		lagMs = 0;
+
+	mBeats++;
+	mLastBeat = now;
+	mLastLagMs = lagMs;
+	if (lagMs > mMaxLagMs)
+		mMaxLagMs = lagMs;
+	if (lagMs >= mThresholdMs)
+		record(LAG, "heartbeat", lagMs);
+}
+
+pbnjson::JValue LoopMonitor::getStatus() const
+{
+	gint64 now = g_get_monotonic_time();
+	pbnjson::JValue statusObj = pbnjson::Object();
+	statusObj.put("heartbeat", isRunning());
+	statusObj.put("heartbeatIntervalMs", (int32_t) mHeartbeatMs);
+	statusObj.put("thresholdMs", (int32_t) mThresholdMs);
+	statusObj.put("beats", (int64_t) mBeats);
+	statusObj.put("lastLagMs", (int64_t) mLastLagMs);
+	statusObj.put("maxLagMs", (int64_t) mMaxLagMs);
+	statusObj.put("lagStalls", (int64_t) mLagStalls);
+	statusObj.put("handlerStalls", (int64_t) mHandlerStalls);
+	gint64 firstMethodMs = StartupTrace::getInstance().getFirstMethodMs();
+	if (firstMethodMs >= 0)
+		statusObj.put("firstMethodMs", (int64_t) firstMethodMs);
+
+	// Most recent first
+	pbnjson::JValue stallsObj = pbnjson::Array();
+	for (size_t i = 1; i <= mStallCount; i++)
+	{
+		const Stall &stall = mStalls[(mNextStall + mStalls.size() - i) % mStalls.size()];
+		pbnjson::JValue stallObj = pbnjson::Object();
+		stallObj.put("type", stall.type == HANDLER ? "handler" : "lag");
+		stallObj.put("name", stall.name);
+		stallObj.put("durationMs", (int64_t) stall.durationMs);
+		stallObj.put("ageMs", (int64_t) ((now - stall.timestamp) / 1000));
+		stallsObj.append(stallObj);
+	}
+	statusObj.put("stalls", stallsObj);
+
+	return statusObj;
+}
+
+gboolean LoopMonitor::handleHeartbeat(gpointer userData)
+{
+	LoopMonitor *monitor = static_cast<LoopMonitor*>(userData);
+	if (monitor == nullptr)
+		return FALSE;
+
+	monitor->beat();
+	return TRUE;
+}
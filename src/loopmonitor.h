@@ -0,0 +1,121 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef LOOPMONITOR_H_
+#define LOOPMONITOR_H_
+
+#include <array>
+#include <string>
+
+#include <glib.h>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.hpp>
+
+#include "startuptrace.h"
+#include "statejournal.h"
+
+// Records the duration of the enclosing callback under its function name
+#define LOOP_MONITOR_SCOPE() LoopMonitor::Scope loopMonitorScope(__FUNCTION__)
+
+// Category table entry, see LS_CREATE_CATEGORY_BEGIN, for a luna method run
+// through LoopMonitor::methodWrapper
+#define LS_CATEGORY_MONITORED_METHOD(name) { #name, \
+	&LoopMonitor::methodWrapper<cl_t, &cl_t::name>, \
+	static_cast<LSMethodFlags>(0) },
+
+/*
+ * Health of the main loop, which runs every handler of the service.
+ *
+ * A heartbeat at high priority measures how late it is dispatched, which is
+ * how long the loop was blocked by whatever ran before it. It wakes the
+ * service up every interval, so it only runs once started from the command
+ * line or through getLoopStatus. Handlers wrapped
+ * in a Scope that run longer than the threshold are recorded by name, so a
+ * lag can be traced back to the callback that caused it. Both end up in a
+ * fixed ring of the most recent stalls.
+ */
+class LoopMonitor
+{
+public:
+	class Scope
+	{
+	public:
+		Scope(const char *name);
+		~Scope();
+
+	private:
+		const char *mName;
+		gint64 mStart;
+	};
+
+	static LoopMonitor& getInstance();
+
+	void start();
+	void stop();
+	bool isRunning() const { return mHeartbeatSource != 0; }
+	pbnjson::JValue getStatus() const;
+
+	// Luna method dispatcher that runs the method inside a Scope
+	template<class C, bool (C::*M)(LSMessage&)>
+	static bool methodWrapper(LSHandle *handle, LSMessage *message, void *context)
+	{
+		bool result;
+		StateJournal::getInstance().recordRequest(message);
+		{
+			Scope scope(LSMessageGetMethod(message));
+			result = LS::Handle::methodWraper<C, M>(handle, message, context);
+		}
+		StartupTrace::getInstance().methodServed(LSMessageGetMethod(message));
+		return result;
+	}
+
+private:
+	enum StallType
+	{
+		HANDLER,
+		LAG
+	};
+
+	struct Stall
+	{
+		StallType type;
+		std::string name;
+		gint64 durationMs;
+		gint64 timestamp;
+	};
+
+	LoopMonitor(unsigned int heartbeatMs = 100, unsigned int thresholdMs = 50);
+	~LoopMonitor();
+
+	void record(StallType type, const char *name, gint64 durationMs);
+	void beat();
+	static gboolean handleHeartbeat(gpointer userData);
+
+	unsigned int mHeartbeatMs;
+	unsigned int mThresholdMs;
+	guint mHeartbeatSource;
+	gint64 mLastBeat;
+	gint64 mLastLagMs;
+	gint64 mMaxLagMs;
+	unsigned long mBeats;
+	unsigned long mLagStalls;
+	unsigned long mHandlerStalls;
+	std::array<Stall, 64> mStalls;
+	size_t mNextStall;
+	size_t mStallCount;
+};
+
+#endif //LOOPMONITOR_H_
@@ -18,67 +18,15 @@
 #include <luna-service2/lunaservice.hpp>
 #include "logging.h"
 #include "ls2utils.h"
+#include "statejournal.h"
 
-#ifdef MULTI_SESSION_SUPPORT
-
-#include <map>
-#include <string>
-
-std::map<std::string, std::string> sessionInfoMap;
-
-LSUtils::DisplaySetId LSUtils::getDisplaySetIdIndex(LSMessage &message, LS::Handle *handle)
+void LSUtils::recordResult(LSMessage *message, bool returnValue, int errorCode)
 {
-	if (LSMessageGetSessionId(&message) != NULL)
-	{
-		std::string sessionId = LSMessageGetSessionId(&message);
-		BT_INFO("INFO_SESSION", 0, "session id is %s", sessionId.c_str());
-
-		if (sessionId == "host")
-			return HOST;
-
-		pbnjson::JValue payload = pbnjson::Object();
-		payload.put("sessionId", sessionId.c_str());
-		pbnjson::JGenerator serializer(nullptr);
-		std::string payloadstr;
-		serializer.toString(payload, pbnjson::JSchema::AllSchema(), payloadstr);
-
-		auto it = sessionInfoMap.find(sessionId);
-
-		std::string deviceSetId;
-		if( it == sessionInfoMap.end())
-		{
-			auto reply = handle->callOneReply("luna://com.webos.service.account/getSession", payloadstr.c_str()).get();
-			pbnjson::JValue replyObj = pbnjson::Object();
-			LSUtils::parsePayload(reply.getPayload(), replyObj);
-
-			bool returnValue = replyObj["returnValue"].asBool();
-			if (!returnValue) {
-				return HOST;
-			}
-
-			auto sessionInfo = replyObj["session"];
-			auto deviceInfo = sessionInfo["deviceSetInfo"];
-			deviceSetId = deviceInfo["deviceSetId"].asString();
-
-			sessionInfoMap[sessionId] = deviceSetId;
-
-		}
-		else
-		{
-			deviceSetId = it->second;
-		}
-
-		BT_INFO("INFO_SESSION", 0, "deviceSetId %s", deviceSetId.c_str());
-
-		return getDisplaySetIdIndex(deviceSetId);
-	}
-
-	BT_INFO("INFO_SESSION", 0, "session is null");
-
-	//failure
-	return HOST;
+	StateJournal::getInstance().recordResult(message, returnValue, errorCode);
 }
 
+#ifdef MULTI_SESSION_SUPPORT
+
 LSUtils::DisplaySetId LSUtils::getDisplaySetIdIndex(const std::string &deviceSetId)
 {
 	if ("RSE-L" == deviceSetId)
@@ -84,6 +84,9 @@
 namespace LSUtils
 {
 
+// Journals the result of a request, see StateJournal::recordResult
+void recordResult(LSMessage *message, bool returnValue, int errorCode);
+
 inline bool generatePayload(const pbnjson::JValue &object, std::string &payload)
 {
 	pbnjson::JGenerator serializer(NULL);
@@ -146,6 +149,7 @@ inline void respondWithError(LS::Message &message, const std::string& errorText,
 	std::string payload;
 	generatePayload(responseObj, payload);
 
+	recordResult(message.get(), false, (int) errorCode);
 	message.respond(payload.c_str());
 }
 
@@ -185,6 +189,8 @@ inline void postToClient(LS::Message &message, pbnjson::JValue &object)
 	std::string payload;
 	LSUtils::generatePayload(object, payload);
 
+	recordResult(message.get(), object["returnValue"].asBool(),
+	             object.hasKey("errorCode") ? object["errorCode"].asNumber<int32_t>() : 0);
 	try
 	{
 		message.respond(payload.c_str());
@@ -212,7 +218,6 @@ enum DisplaySetId
     HOST
 };
 
-DisplaySetId getDisplaySetIdIndex(LSMessage &message, LS::Handle *handle);
 DisplaySetId getDisplaySetIdIndex(const std::string &deviceSetId);
 
 #endif
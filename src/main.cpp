@@ -17,21 +17,30 @@
 #include "config.h"
 #include "logging.h"
 #include "bluetoothhfpservice.h"
+#include "loopmonitor.h"
+#include "startuptrace.h"
+#include "statejournal.h"
 
 PmLogContext logContext;
 
 static const char* const logContextName = "webos-hfp-service";
 
 static gboolean option_version = FALSE;
+static gboolean option_monitor_loop = FALSE;
 
 static GOptionEntry options[] = {
 	{ "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
 		"Show version information and exit" },
+	{ "monitor-loop", 'm', 0, G_OPTION_ARG_NONE, &option_monitor_loop,
+		"Measure main loop lag with a heartbeat from startup" },
 	{ NULL },
 };
 
 int main(int argc, char **argv)
 {
+	StartupTrace::getInstance().markProcessStart();
+	StateJournal::getInstance().installCrashHandler();
+
 	try
 	{
 		GMainLoop *mainLoop;
@@ -68,6 +77,16 @@ int main(int argc, char **argv)
 
 		BluetoothHfpService service;
 		service.attachToLoop(mainLoop);
+		StartupTrace::getInstance().mark("attached");
+		// Call control requests are dispatched ahead of oFono D-Bus signals,
+		// bluetooth2 device lists and status rebuilds, which run below it
+		service.setPriority(G_PRIORITY_HIGH);
+		if (option_monitor_loop)
+			LoopMonitor::getInstance().start();
+		g_idle_add([](gpointer) -> gboolean {
+			StartupTrace::getInstance().mark("loopRunning");
+			return FALSE;
+		}, nullptr);
 
 		g_main_loop_run(mainLoop);
 
@@ -0,0 +1,120 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+#include "logging.h"
+#include "config.h"
+
+MappedFile::MappedFile(const std::string &name, size_t size, unsigned int syncIntervalSec) :
+	mPath(std::string(WEBOS_HFP_DATA_DIR) + "/" + name),
+	mSize(size),
+	mSyncIntervalSec(syncIntervalSec),
+	mData(nullptr),
+	mCreated(false),
+	mDirty(false),
+	mSyncSource(0)
+{
+	if (g_mkdir_with_parents(WEBOS_HFP_DATA_DIR, 0700) < 0)
+	{
+		BT_ERROR("MSGID_MAPPED_FILE_FAILED", 0, "Failed to create %s: %s", WEBOS_HFP_DATA_DIR, strerror(errno));
+		return;
+	}
+
+	int fd = open(mPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		BT_ERROR("MSGID_MAPPED_FILE_FAILED", 0, "Failed to open %s: %s", mPath.c_str(), strerror(errno));
+		return;
+	}
+
+	// A file of another size is from a different layout and starts over
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size != mSize)
+	{
+		mCreated = true;
+		if (ftruncate(fd, 0) < 0 || ftruncate(fd, mSize) < 0)
+		{
+			BT_ERROR("MSGID_MAPPED_FILE_FAILED", 0, "Failed to size %s: %s", mPath.c_str(), strerror(errno));
+			close(fd);
+			return;
+		}
+	}
+
+	// Stores into a hole of a shared mapping raise SIGBUS once the data
+	// partition is full, so every block is reserved up front
+	int error = posix_fallocate(fd, 0, mSize);
+	if (error)
+	{
+		BT_ERROR("MSGID_MAPPED_FILE_FAILED", 0, "Failed to reserve %s: %s", mPath.c_str(), strerror(error));
+		close(fd);
+		return;
+	}
+
+	void *data = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		BT_ERROR("MSGID_MAPPED_FILE_FAILED", 0, "Failed to map %s: %s", mPath.c_str(), strerror(errno));
+		return;
+	}
+
+	mData = static_cast<unsigned char*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+	if (mSyncSource)
+		g_source_remove(mSyncSource);
+
+	if (!mData)
+		return;
+
+	sync(true);
+	munmap(mData, mSize);
+}
+
+void MappedFile::markDirty()
+{
+	mDirty = true;
+	if (!mSyncSource)
+		mSyncSource = g_timeout_add_seconds(mSyncIntervalSec, handleSync, this);
+}
+
+void MappedFile::sync(bool wait)
+{
+	if (!mData || !mDirty)
+		return;
+
+	mDirty = false;
+	if (msync(mData, mSize, wait ? MS_SYNC : MS_ASYNC) < 0)
+		BT_WARNING("MSGID_MAPPED_FILE_SYNC_FAILED", 0, "Failed to sync %s: %s", mPath.c_str(), strerror(errno));
+}
+
+gboolean MappedFile::handleSync(gpointer userData)
+{
+	MappedFile *file = static_cast<MappedFile*>(userData);
+
+	file->mSyncSource = 0;
+	file->sync(false);
+	return FALSE;
+}
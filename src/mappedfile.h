@@ -0,0 +1,61 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+
+#include <glib.h>
+
+/*
+ * A fixed size file under the data directory of the service, mapped shared
+ * into memory.
+ *
+ * Writers update the mapping in place and mark it dirty, which costs no
+ * system call. Dirty mappings are handed to the kernel for writeback by a
+ * periodic msync, and synchronously once more when the file is closed.
+ */
+class MappedFile
+{
+public:
+	MappedFile(const std::string &name, size_t size, unsigned int syncIntervalSec = 5);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+
+	bool isOpen() const { return mData != nullptr; }
+	bool isCreated() const { return mCreated; }
+	unsigned char* getData() const { return mData; }
+	size_t getSize() const { return mSize; }
+	const std::string& getPath() const { return mPath; }
+	void markDirty();
+	void sync(bool wait);
+
+private:
+	static gboolean handleSync(gpointer userData);
+
+	std::string mPath;
+	size_t mSize;
+	unsigned int mSyncIntervalSec;
+	unsigned char *mData;
+	bool mCreated;
+	bool mDirty;
+	guint mSyncSource;
+};
+
+#endif //MAPPEDFILE_H_
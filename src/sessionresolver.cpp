@@ -0,0 +1,296 @@
+// Copyright (c) 2020-2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifdef MULTI_SESSION_SUPPORT
+
+#include <pbnjson.hpp>
+
+#include "sessionresolver.h"
+#include "logging.h"
+
+static const std::string ACCOUNTSERVICE = "com.webos.service.account";
+static const std::string LUNAGETSESSIONS = "luna://com.webos.service.account/getSessions";
+static const std::string LUNAGETSESSION = "luna://com.webos.service.account/getSession";
+static const guint MAXHELDREQUESTSEC = 3;
+
+SessionResolver::SessionResolver(LS::Handle *handle) :
+	mLSHandle(handle->get()),
+	mServerStatusCookie(nullptr),
+	mSessionsToken(LSMESSAGE_TOKEN_INVALID),
+	mHeldTimeoutSource(0)
+{
+}
+
+SessionResolver::~SessionResolver()
+{
+	if (mServerStatusCookie)
+		LSCancelServerStatus(mLSHandle, mServerStatusCookie, nullptr);
+
+	unsubscribeSessions();
+	for (auto &lookup : mLookups)
+		LSCallCancel(mLSHandle, lookup.first, nullptr);
+	if (mHeldTimeoutSource)
+		g_source_remove(mHeldTimeoutSource);
+}
+
+void SessionResolver::prefetch()
+{
+	LSError lserror;
+	LSErrorInit(&lserror);
+	if (!LSRegisterServerStatusEx(mLSHandle, ACCOUNTSERVICE.c_str(), accountServiceStatusCb, this, &mServerStatusCookie, &lserror))
+	{
+		BT_ERROR("MSGID_SESSION_PREFETCH_FAILED", 0, "Failed to watch %s: %s", ACCOUNTSERVICE.c_str(), lserror.message);
+		LSErrorFree(&lserror);
+	}
+}
+
+bool SessionResolver::resolve(LSMessage &message, DispatchFunc dispatch)
+{
+	const char *session = LSMessageGetSessionId(&message);
+	if (session == nullptr)
+		return true;
+
+	std::string sessionId = session;
+	if (sessionId == "host" || mSessions.find(sessionId) != mSessions.end())
+		return true;
+
+	BT_INFO("INFO_SESSION", 0, "Holding request until session %s is resolved", sessionId.c_str());
+	auto &heldSession = mHeldRequests[sessionId];
+	heldSession.requests.push_back({LS::Message(&message), dispatch});
+	if (heldSession.requests.size() == 1)
+	{
+		heldSession.heldSince = g_get_monotonic_time();
+		if (!mHeldTimeoutSource)
+			mHeldTimeoutSource = g_timeout_add_seconds(1, handleHeldTimeout, this);
+		lookupSession(sessionId);
+	}
+
+	return false;
+}
+
+LSUtils::DisplaySetId SessionResolver::getDisplaySetId(LSMessage &message) const
+{
+	const char *session = LSMessageGetSessionId(&message);
+	if (session == nullptr)
+	{
+		BT_INFO("INFO_SESSION", 0, "session is null");
+		return LSUtils::DisplaySetId::HOST;
+	}
+
+	auto iter = mSessions.find(session);
+	if (iter == mSessions.end())
+		return LSUtils::DisplaySetId::HOST;
+
+	BT_INFO("INFO_SESSION", 0, "session id %s deviceSetId %s", session, iter->second.c_str());
+	return LSUtils::getDisplaySetIdIndex(iter->second);
+}
+
+void SessionResolver::subscribeSessions()
+{
+	unsubscribeSessions();
+
+	LSError lserror;
+	LSErrorInit(&lserror);
+	if (!LSCall(mLSHandle, LUNAGETSESSIONS.c_str(), "{\"subscribe\":true}", getSessionsCb, this, &mSessionsToken, &lserror))
+	{
+		BT_ERROR("MSGID_SESSION_PREFETCH_FAILED", 0, "Failed to subscribe to sessions: %s", lserror.message);
+		LSErrorFree(&lserror);
+		mSessionsToken = LSMESSAGE_TOKEN_INVALID;
+	}
+}
+
+void SessionResolver::unsubscribeSessions()
+{
+	if (mSessionsToken != LSMESSAGE_TOKEN_INVALID)
+	{
+		LSCallCancel(mLSHandle, mSessionsToken, nullptr);
+		mSessionsToken = LSMESSAGE_TOKEN_INVALID;
+	}
+}
+
+void SessionResolver::lookupSession(const std::string &sessionId)
+{
+	pbnjson::JValue payload = pbnjson::Object();
+	payload.put("sessionId", sessionId);
+	std::string payloadStr;
+	LSUtils::generatePayload(payload, payloadStr);
+
+	LSMessageToken token = LSMESSAGE_TOKEN_INVALID;
+	LSError lserror;
+	LSErrorInit(&lserror);
+	if (!LSCallOneReply(mLSHandle, LUNAGETSESSION.c_str(), payloadStr.c_str(), getSessionCb, this, &token, &lserror))
+	{
+		BT_ERROR("MSGID_SESSION_LOOKUP_FAILED", 0, "Failed to look up session %s: %s", sessionId.c_str(), lserror.message);
+		LSErrorFree(&lserror);
+		updateSession(sessionId, "");
+		return;
+	}
+
+	mLookups[token] = sessionId;
+}
+
+void SessionResolver::handleSessions(LSMessage *reply)
+{
+	LS::Message replyMsg(reply);
+	pbnjson::JValue replyObj;
+	if (!LSUtils::parsePayload(replyMsg.getPayload(), replyObj) || !replyObj["returnValue"].asBool())
+		return;
+
+	pbnjson::JValue sessionList = replyObj["sessionList"];
+	if (!sessionList.isArray())
+		return;
+
+	// The list is complete, so sessions that are gone are forgotten here
+	std::unordered_map<std::string, std::string> sessions;
+	for (int i = 0; i < sessionList.arraySize(); i++)
+	{
+		pbnjson::JValue session = sessionList[i];
+		if (!session.hasKey("sessionId"))
+			continue;
+
+		sessions[session["sessionId"].asString()] = session["deviceSetInfo"]["deviceSetId"].asString();
+	}
+	mSessions.swap(sessions);
+	BT_INFO("INFO_SESSION", 0, "%zu sessions known", mSessions.size());
+
+	std::vector<std::string> resolved;
+	for (auto &held : mHeldRequests)
+	{
+		if (mSessions.find(held.first) != mSessions.end())
+			resolved.push_back(held.first);
+	}
+	for (auto &sessionId : resolved)
+		dispatchHeldRequests(sessionId);
+}
+
+void SessionResolver::handleSession(LSMessage *reply)
+{
+	auto iter = mLookups.find(LSMessageGetResponseToken(reply));
+	if (iter == mLookups.end())
+		return;
+
+	std::string sessionId = iter->second;
+	mLookups.erase(iter);
+
+	LS::Message replyMsg(reply);
+	pbnjson::JValue replyObj;
+	std::string deviceSetId;
+	if (LSUtils::parsePayload(replyMsg.getPayload(), replyObj) && replyObj["returnValue"].asBool())
+		deviceSetId = replyObj["session"]["deviceSetInfo"]["deviceSetId"].asString();
+	else
+		BT_ERROR("MSGID_SESSION_LOOKUP_FAILED", 0, "Session %s is not known to the account service", sessionId.c_str());
+
+	// A failed lookup resolves to the host so that held requests are not
+	// stuck, the getSessions subscription corrects it later
+	updateSession(sessionId, deviceSetId);
+}
+
+void SessionResolver::updateSession(const std::string &sessionId, const std::string &deviceSetId)
+{
+	mSessions[sessionId] = deviceSetId;
+	dispatchHeldRequests(sessionId);
+}
+
+void SessionResolver::dispatchHeldRequests(const std::string &sessionId)
+{
+	auto iter = mHeldRequests.find(sessionId);
+	if (iter == mHeldRequests.end())
+		return;
+
+	std::vector<HeldRequest> heldRequests;
+	heldRequests.swap(iter->second.requests);
+	mHeldRequests.erase(iter);
+
+	for (auto &held : heldRequests)
+		held.dispatch(*held.request.get());
+}
+
+void SessionResolver::expireHeldRequests()
+{
+	// The lookup is left running, a late reply still fills the cache
+	gint64 now = g_get_monotonic_time();
+	std::vector<HeldRequest> expired;
+	for (auto iter = mHeldRequests.begin(); iter != mHeldRequests.end();)
+	{
+		if (now - iter->second.heldSince < (gint64) MAXHELDREQUESTSEC * G_USEC_PER_SEC)
+		{
+			++iter;
+			continue;
+		}
+
+		BT_ERROR("MSGID_SESSION_LOOKUP_FAILED", 0, "Session %s was not resolved in time, dropping %zu requests",
+		         iter->first.c_str(), iter->second.requests.size());
+		for (auto &held : iter->second.requests)
+			expired.push_back(std::move(held));
+		iter = mHeldRequests.erase(iter);
+	}
+
+	for (auto &held : expired)
+		LSUtils::respondWithError(held.request, BT_ERR_SESSION_NOT_RESOLVED);
+}
+
+gboolean SessionResolver::handleHeldTimeout(gpointer userData)
+{
+	SessionResolver *resolver = static_cast<SessionResolver*>(userData);
+
+	resolver->expireHeldRequests();
+	if (!resolver->mHeldRequests.empty())
+		return TRUE;
+
+	resolver->mHeldTimeoutSource = 0;
+	return FALSE;
+}
+
+bool SessionResolver::accountServiceStatusCb(LSHandle *handle, const char *serviceName, bool connected, void *context)
+{
+	SessionResolver *resolver = static_cast<SessionResolver*>(context);
+	if (resolver == nullptr)
+		return true;
+
+	if (connected)
+	{
+		resolver->subscribeSessions();
+	}
+	else
+	{
+		resolver->unsubscribeSessions();
+		resolver->mSessions.clear();
+	}
+
+	return true;
+}
+
+bool SessionResolver::getSessionsCb(LSHandle *handle, LSMessage *reply, void *context)
+{
+	SessionResolver *resolver = static_cast<SessionResolver*>(context);
+	if (resolver == nullptr)
+		return true;
+
+	resolver->handleSessions(reply);
+	return true;
+}
+
+bool SessionResolver::getSessionCb(LSHandle *handle, LSMessage *reply, void *context)
+{
+	SessionResolver *resolver = static_cast<SessionResolver*>(context);
+	if (resolver == nullptr)
+		return true;
+
+	resolver->handleSession(reply);
+	return true;
+}
+
+#endif
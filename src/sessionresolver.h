@@ -0,0 +1,90 @@
+// Copyright (c) 2020-2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SESSION_RESOLVER_H_
+#define SESSION_RESOLVER_H_
+
+#ifdef MULTI_SESSION_SUPPORT
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+#include <luna-service2/lunaservice.hpp>
+
+#include "ls2utils.h"
+
+/*
+ * Session id to display set resolution without blocking the main loop.
+ *
+ * Known sessions are prefetched from a getSessions subscription on the
+ * account service, which also keeps the cache coherent when sessions come
+ * and go. A request from a session that is not known yet is held and
+ * dispatched again once its getSession reply arrives, or answered with an
+ * error if that takes longer than MAXHELDREQUESTSEC.
+ */
+class SessionResolver
+{
+public:
+	typedef std::function<void(LSMessage &message)> DispatchFunc;
+
+	SessionResolver(LS::Handle *handle);
+	~SessionResolver();
+
+	void prefetch();
+	bool resolve(LSMessage &message, DispatchFunc dispatch);
+	LSUtils::DisplaySetId getDisplaySetId(LSMessage &message) const;
+
+private:
+	struct HeldRequest
+	{
+		LS::Message request;
+		DispatchFunc dispatch;
+	};
+
+	struct HeldSession
+	{
+		gint64 heldSince;
+		std::vector<HeldRequest> requests;
+	};
+
+	void subscribeSessions();
+	void unsubscribeSessions();
+	void lookupSession(const std::string &sessionId);
+	void handleSessions(LSMessage *reply);
+	void handleSession(LSMessage *reply);
+	void updateSession(const std::string &sessionId, const std::string &deviceSetId);
+	void dispatchHeldRequests(const std::string &sessionId);
+	void expireHeldRequests();
+	static gboolean handleHeldTimeout(gpointer userData);
+	static bool accountServiceStatusCb(LSHandle *handle, const char *serviceName, bool connected, void *context);
+	static bool getSessionsCb(LSHandle *handle, LSMessage *reply, void *context);
+	static bool getSessionCb(LSHandle *handle, LSMessage *reply, void *context);
+
+	LSHandle *mLSHandle;
+	void *mServerStatusCookie;
+	LSMessageToken mSessionsToken;
+	std::unordered_map<std::string, std::string> mSessions; //session id to device set id
+	std::unordered_map<LSMessageToken, std::string> mLookups; //getSession call to session id
+	std::unordered_map<std::string, HeldSession> mHeldRequests; //session id to requests
+	guint mHeldTimeoutSource;
+};
+
+#endif
+
+#endif //SESSION_RESOLVER_H_
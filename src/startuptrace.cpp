@@ -0,0 +1,97 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "startuptrace.h"
+#include "logging.h"
+
+StartupTrace& StartupTrace::getInstance()
+{
+	static StartupTrace trace;
+	return trace;
+}
+
+StartupTrace::StartupTrace(unsigned int budgetMs) :
+	mBudgetMs(budgetMs),
+	mProcessStart(g_get_monotonic_time()),
+	mFirstMethodMs(-1)
+{
+}
+
+void StartupTrace::markProcessStart()
+{
+	mProcessStart = g_get_monotonic_time();
+	mPhases.clear();
+	mark("start");
+}
+
+gint64 StartupTrace::sinceStart() const
+{
+	return (g_get_monotonic_time() - mProcessStart) / 1000;
+}
+
+void StartupTrace::mark(const std::string &phase)
+{
+	gint64 timeMs = sinceStart();
+	mPhases.push_back({phase, timeMs});
+	BT_DEBUG("Startup phase %s at %lld ms", phase.c_str(), (long long) timeMs);
+}
+
+void StartupTrace::methodServed(const char *name)
+{
+	if (mFirstMethodMs >= 0)
+		return;
+
+	mark(std::string("firstMethod:") + (name ? name : ""));
+
+	gint64 timeMs = mPhases.back().timeMs;
+	mFirstMethodMs = timeMs;
+	if (timeMs > mBudgetMs)
+		BT_WARNING("MSGID_STARTUP_BUDGET_EXCEEDED", 0, "First method served after %lld ms, budget %u ms: %s",
+		           (long long) timeMs, mBudgetMs, summary().c_str());
+	else
+		BT_INFO("STARTUP_TRACE", 0, "%s", summary().c_str());
+}
+
+std::string StartupTrace::summary() const
+{
+	std::string summary;
+	for (auto &phase : mPhases)
+	{
+		if (!summary.empty())
+			summary += " ";
+		summary += phase.name + "=" + std::to_string(phase.timeMs);
+	}
+	return summary;
+}
+
+pbnjson::JValue StartupTrace::getStatus() const
+{
+	pbnjson::JValue statusObj = pbnjson::Object();
+	statusObj.put("budgetMs", (int32_t) mBudgetMs);
+	statusObj.put("uptimeMs", (int64_t) sinceStart());
+
+	pbnjson::JValue phasesObj = pbnjson::Array();
+	for (auto &phase : mPhases)
+	{
+		pbnjson::JValue phaseObj = pbnjson::Object();
+		phaseObj.put("name", phase.name);
+		phaseObj.put("timeMs", (int64_t) phase.timeMs);
+		phasesObj.append(phaseObj);
+	}
+	statusObj.put("phases", phasesObj);
+
+	return statusObj;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STARTUPTRACE_H_
+#define STARTUPTRACE_H_
+
+#include <string>
+#include <vector>
+
+#include <glib.h>
+#include <pbnjson.hpp>
+
+/*
+ * Timestamps of the steps the service takes from process start until it
+ * serves its first request, and of the work deferred past that point.
+ *
+ * Phases are kept in the order they are marked, relative to the start of
+ * the process. The summary is logged once the first method is served,
+ * with a warning if that took longer than the startup budget. The loop
+ * monitor reports the time to the first method from here as well.
+ */
+class StartupTrace
+{
+public:
+	static StartupTrace& getInstance();
+
+	void markProcessStart();
+	void mark(const std::string &phase);
+	void methodServed(const char *name);
+	gint64 getFirstMethodMs() const { return mFirstMethodMs; }
+	pbnjson::JValue getStatus() const;
+
+private:
+	struct Phase
+	{
+		std::string name;
+		gint64 timeMs;
+	};
+
+	StartupTrace(unsigned int budgetMs = 500);
+
+	gint64 sinceStart() const;
+	std::string summary() const;
+
+	unsigned int mBudgetMs;
+	gint64 mProcessStart;
+	gint64 mFirstMethodMs;
+	std::vector<Phase> mPhases;
+};
+
+#endif //STARTUPTRACE_H_
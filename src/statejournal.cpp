@@ -0,0 +1,202 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "statejournal.h"
+#include "logging.h"
+#include "config.h"
+
+#define STATE_JOURNAL_CAPACITY 2048
+
+// Kept outside of the object so that the crash handler only touches plain memory
+static JOURNAL::Record journalRecords[STATE_JOURNAL_CAPACITY];
+static uint64_t journalNextSequence = 1;
+static char journalPath[256];
+static char journalTempPath[256];
+
+static const int crashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+static void copyText(char *field, size_t size, const std::string &value)
+{
+	size_t length = value.size() < size - 1 ? value.size() : size - 1;
+	memcpy(field, value.data(), length);
+	memset(field + length, 0, size - length);
+}
+
+static bool writeAll(int fd, const void *data, size_t length)
+{
+	const char *pos = static_cast<const char*>(data);
+	while (length > 0)
+	{
+		ssize_t written = write(fd, pos, length);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		pos += written;
+		length -= written;
+	}
+	return true;
+}
+
+StateJournal& StateJournal::getInstance()
+{
+	static StateJournal journal;
+	return journal;
+}
+
+StateJournal::StateJournal() :
+	mCrashHandlerInstalled(false),
+	mFlushes(0)
+{
+	snprintf(journalPath, sizeof(journalPath), "%s/journal.bin", WEBOS_HFP_DATA_DIR);
+	snprintf(journalTempPath, sizeof(journalTempPath), "%s/journal.bin.tmp", WEBOS_HFP_DATA_DIR);
+}
+
+void StateJournal::installCrashHandler()
+{
+	if (mCrashHandlerInstalled)
+		return;
+
+	// The directory has to exist before anything goes wrong
+	if (g_mkdir_with_parents(WEBOS_HFP_DATA_DIR, 0700) < 0)
+		BT_WARNING("MSGID_STATE_JOURNAL_FAILED", 0, "Failed to create %s: %s", WEBOS_HFP_DATA_DIR, strerror(errno));
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleCrash;
+	action.sa_flags = SA_RESETHAND;
+	sigemptyset(&action.sa_mask);
+	for (int crashSignal : crashSignals)
+		sigaction(crashSignal, &action, nullptr);
+
+	mCrashHandlerInstalled = true;
+}
+
+void StateJournal::record(JOURNAL::Event event, const std::string &adapterAddr, const std::string &remoteAddr,
+                          int index, int value, const std::string &key, const std::string &text)
+{
+	uint64_t sequence = __sync_fetch_and_add(&journalNextSequence, 1);
+	JOURNAL::Record *record = &journalRecords[(sequence - 1) % STATE_JOURNAL_CAPACITY];
+
+	record->sequence = 0;
+	__sync_synchronize();
+	record->time = g_get_real_time();
+	record->event = event;
+	record->index = index;
+	record->value = value;
+	copyText(record->adapterAddress, sizeof(record->adapterAddress), adapterAddr);
+	copyText(record->address, sizeof(record->address), remoteAddr);
+	copyText(record->key, sizeof(record->key), key);
+	copyText(record->text, sizeof(record->text), text);
+	__sync_synchronize();
+	record->sequence = sequence;
+}
+
+void StateJournal::recordRequest(LSMessage *message)
+{
+	if (message == nullptr)
+		return;
+
+	const char *method = LSMessageGetMethod(message);
+	const char *sender = LSMessageGetSenderServiceName(message);
+	if (sender == nullptr)
+		sender = LSMessageGetApplicationID(message);
+	if (sender == nullptr)
+		sender = LSMessageGetSender(message);
+
+	record(JOURNAL::REQUEST, "", "", 0, 0, method ? method : "", sender ? sender : "");
+}
+
+void StateJournal::recordResult(LSMessage *message, bool returnValue, int errorCode)
+{
+	if (message == nullptr)
+		return;
+
+	const char *method = LSMessageGetMethod(message);
+	record(JOURNAL::RESULT, "", "", errorCode, returnValue ? 1 : 0, method ? method : "");
+}
+
+bool StateJournal::writeFile()
+{
+	// Runs in the crash handler, so only async-signal-safe calls from here on
+	JOURNAL::FileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = STATE_JOURNAL_MAGIC;
+	header.format = STATE_JOURNAL_FORMAT;
+	header.headerSize = sizeof(header);
+	header.recordSize = sizeof(JOURNAL::Record);
+	header.capacity = STATE_JOURNAL_CAPACITY;
+	header.nextSequence = journalNextSequence;
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	header.flushTime = (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+	int fd = open(journalTempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return false;
+
+	bool written = writeAll(fd, &header, sizeof(header)) && writeAll(fd, journalRecords, sizeof(journalRecords)) &&
+	               fsync(fd) == 0;
+	close(fd);
+
+	return written && rename(journalTempPath, journalPath) == 0;
+}
+
+void StateJournal::handleCrash(int signal)
+{
+	int savedErrno = errno;
+	writeFile();
+	errno = savedErrno;
+
+	// The default action was restored when the handler was entered
+	raise(signal);
+}
+
+bool StateJournal::flush()
+{
+	if (!writeFile())
+	{
+		BT_ERROR("MSGID_STATE_JOURNAL_FAILED", 0, "Failed to write %s: %s", journalPath, strerror(errno));
+		return false;
+	}
+
+	mFlushes++;
+	BT_INFO("STATE_JOURNAL_FLUSHED", 0, "Wrote %llu transitions to %s", (unsigned long long) (journalNextSequence - 1), journalPath);
+	return true;
+}
+
+pbnjson::JValue StateJournal::getStatus() const
+{
+	uint64_t written = journalNextSequence - 1;
+
+	pbnjson::JValue statusObj = pbnjson::Object();
+	statusObj.put("path", std::string(journalPath));
+	statusObj.put("capacity", (int32_t) STATE_JOURNAL_CAPACITY);
+	statusObj.put("sequence", (int64_t) written);
+	statusObj.put("records", (int64_t) (written < STATE_JOURNAL_CAPACITY ? written : STATE_JOURNAL_CAPACITY));
+	statusObj.put("flushes", (int64_t) mFlushes);
+	return statusObj;
+}
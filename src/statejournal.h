@@ -0,0 +1,63 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef STATEJOURNAL_H_
+#define STATEJOURNAL_H_
+
+#include <string>
+
+#include <glib.h>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.h>
+
+#include "statejournalformat.h"
+
+/*
+ * Fixed size binary records of every transition of the HF device state and
+ * of every luna request and its result, for replay after a field report.
+ *
+ * Records go into a ring in memory. A writer claims its slot with an atomic
+ * increment and publishes the record by setting its sequence number last,
+ * so no lock is taken and a record is never seen half written. The ring is
+ * written to disk when asked to and from the handler of fatal signals,
+ * which only uses async-signal-safe calls. hfp-journal-decode reads the
+ * file back.
+ */
+class StateJournal
+{
+public:
+	static StateJournal& getInstance();
+
+	void installCrashHandler();
+	void record(JOURNAL::Event event, const std::string &adapterAddr, const std::string &remoteAddr,
+	            int index = 0, int value = 0, const std::string &key = "", const std::string &text = "");
+	void recordRequest(LSMessage *message);
+	void recordResult(LSMessage *message, bool returnValue, int errorCode);
+	bool flush();
+	pbnjson::JValue getStatus() const;
+
+private:
+	StateJournal();
+
+	static void handleCrash(int signal);
+	static bool writeFile();
+
+	bool mCrashHandlerInstalled;
+	unsigned long mFlushes;
+};
+
+#endif //STATEJOURNAL_H_
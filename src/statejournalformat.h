@@ -0,0 +1,77 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#ifndef STATEJOURNALFORMAT_H_
+#define STATEJOURNALFORMAT_H_
+
+#include <stdint.h>
+
+// Layout of the state journal, shared by the service and the offline decoder
+
+#define STATE_JOURNAL_MAGIC 0x4a504648 //"HFPJ"
+#define STATE_JOURNAL_FORMAT 1
+
+namespace JOURNAL
+{
+	enum Event
+	{
+		DEVICE_CREATED = 1,
+		DEVICE_REMOVED,
+		INDICATOR,          //index CIND::DeviceStatus, value
+		AUDIO,              //index SCO::DeviceStatus, value
+		FEATURE,            //index BRSF::DeviceStatus, value
+		RING,               //value
+		BVRA,               //value
+		CALL_STATUS,        //key number, index CLCC::DeviceStatus, text value
+		CALL_ERASED,        //key number
+		CALLS_CLEARED,
+		NETWORK_OPERATOR,   //text name
+		NETWORK_STATUS,     //text status
+		REQUEST,            //key method, text sender
+		RESULT,             //key method, value returnValue, index errorCode
+		MAXEVENT
+	};
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint16_t format;
+		uint16_t headerSize;
+		uint16_t recordSize;
+		uint16_t reserved;
+		uint32_t capacity;
+		uint64_t nextSequence;
+		int64_t flushTime; //us since the epoch
+	};
+
+	// Records follow the header in ring order, the oldest one is the slot
+	// after the one holding nextSequence - 1
+	struct Record
+	{
+		uint64_t sequence; //0 for a slot never or not completely written
+		int64_t time; //us since the epoch
+		uint16_t event;
+		int16_t index;
+		int32_t value;
+		char adapterAddress[18]; //empty for a device that is still being set up
+		char address[18];
+		char key[32];
+		char text[36];
+	};
+}
+
+#endif //STATEJOURNALFORMAT_H_
@@ -0,0 +1,533 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Stand-in for com.webos.service.bluetooth2 serving the methods the HF role
+// subscribes to, with a set of adapters and AGs that never change, so the
+// subscriptions webos-hfp-service opens can be counted. It runs in place of
+// bluetooth2 on a development target, with bluetooth2 stopped and its role
+// files applying to this executable.
+//
+// With a storm rate set it keeps posting device/getStatus and signal
+// indicator updates to the subscribers, while hf/answerCall is called at a
+// steady interval and its round trip timed. Without oFono behind the
+// service answerCall ends at the modem lookup, which still measures how
+// long call control waits behind the status traffic.
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <glib.h>
+#include <pbnjson.hpp>
+#include <luna-service2/lunaservice.h>
+
+namespace
+{
+
+struct StandIn
+{
+	LSHandle *handle;
+	GMainLoop *loop;
+	int adapters;
+	int devices; //paired per adapter
+	int connected; //of those, with HFP_AG connected
+	bool perDeviceOnly;
+	unsigned long requests;
+	unsigned long sendATs;
+	unsigned long stormPosts;
+	int stormStep;
+	std::vector<gint64> answerUs; //round trips of hf/answerCall
+	unsigned long answersPending;
+};
+
+StandIn standIn;
+
+std::string adapterAddress(int adapter)
+{
+	char buffer[18];
+	snprintf(buffer, sizeof(buffer), "00:aa:bb:cc:dd:%02x", adapter);
+	return buffer;
+}
+
+std::string deviceAddress(int adapter, int device)
+{
+	char buffer[18];
+	snprintf(buffer, sizeof(buffer), "00:11:22:33:%02x:%02x", adapter, device);
+	return buffer;
+}
+
+int findAdapter(const std::string &address)
+{
+	for (int i = 0; i < standIn.adapters; i++)
+	{
+		if (adapterAddress(i) == address)
+			return i;
+	}
+	return address.empty() ? 0 : -1;
+}
+
+bool parseRequest(LSMessage *message, pbnjson::JValue &requestObj)
+{
+	pbnjson::JDomParser parser;
+	if (!parser.parse(LSMessageGetPayload(message), pbnjson::JSchema::AllSchema()))
+		return false;
+	requestObj = parser.getDom();
+	return true;
+}
+
+void respond(LSMessage *message, const pbnjson::JValue &responseObj)
+{
+	LSError error;
+	LSErrorInit(&error);
+	if (!LSMessageRespond(message, responseObj.stringify().c_str(), &error))
+	{
+		LSErrorPrint(&error, stderr);
+		LSErrorFree(&error);
+	}
+}
+
+void respondWithError(LSMessage *message, const std::string &errorText)
+{
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", false);
+	responseObj.put("errorCode", 1);
+	responseObj.put("errorText", errorText);
+	respond(message, responseObj);
+}
+
+// Keeps the request for later posts on key when it asks for them
+bool subscribe(LSHandle *handle, LSMessage *message, const std::string &key)
+{
+	if (!LSMessageIsSubscription(message))
+		return false;
+
+	LSError error;
+	LSErrorInit(&error);
+	if (!LSSubscriptionAdd(handle, key.c_str(), message, &error))
+	{
+		LSErrorPrint(&error, stderr);
+		LSErrorFree(&error);
+		return false;
+	}
+	return true;
+}
+
+pbnjson::JValue buildAdapterStatus()
+{
+	pbnjson::JValue adaptersObj = pbnjson::Array();
+	for (int i = 0; i < standIn.adapters; i++)
+	{
+		pbnjson::JValue adapterObj = pbnjson::Object();
+		adapterObj.put("adapterAddress", adapterAddress(i));
+		adapterObj.put("name", "hfp-standin-" + std::to_string(i));
+		adapterObj.put("interfaceName", "hci" + std::to_string(i));
+		adapterObj.put("powered", true);
+		adaptersObj.append(adapterObj);
+	}
+
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	responseObj.put("adapters", adaptersObj);
+	return responseObj;
+}
+
+pbnjson::JValue buildDeviceStatus(int adapter, int rssi)
+{
+	pbnjson::JValue devicesObj = pbnjson::Array();
+	for (int i = 0; i < standIn.devices; i++)
+	{
+		pbnjson::JValue rolesObj = pbnjson::Array();
+		if (i < standIn.connected)
+			rolesObj.append("HFP_AG");
+
+		pbnjson::JValue deviceObj = pbnjson::Object();
+		deviceObj.put("name", "AG " + std::to_string(i));
+		deviceObj.put("address", deviceAddress(adapter, i));
+		deviceObj.put("adapterAddress", adapterAddress(adapter));
+		deviceObj.put("typeOfDevice", "bredr");
+		deviceObj.put("paired", true);
+		deviceObj.put("rssi", rssi);
+		deviceObj.put("connectedRoles", rolesObj);
+		devicesObj.append(deviceObj);
+	}
+
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	responseObj.put("adapterAddress", adapterAddress(adapter));
+	responseObj.put("devices", devicesObj);
+	return responseObj;
+}
+
+pbnjson::JValue buildSCOStatus(int adapter, int device)
+{
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	responseObj.put("adapterAddress", adapterAddress(adapter));
+	responseObj.put("address", deviceAddress(adapter, device));
+	responseObj.put("sco", false);
+	return responseObj;
+}
+
+bool handleAdapterGetStatus(LSHandle *handle, LSMessage *message, void *context)
+{
+	standIn.requests++;
+	pbnjson::JValue responseObj = buildAdapterStatus();
+	responseObj.put("subscribed", subscribe(handle, message, "adapter/getStatus"));
+	respond(message, responseObj);
+	return true;
+}
+
+bool handleDeviceGetStatus(LSHandle *handle, LSMessage *message, void *context)
+{
+	standIn.requests++;
+	pbnjson::JValue requestObj;
+	if (!parseRequest(message, requestObj))
+	{
+		respondWithError(message, "Invalid JSON input");
+		return true;
+	}
+
+	int adapter = findAdapter(requestObj["adapterAddress"].asString());
+	if (adapter < 0)
+	{
+		respondWithError(message, "Unknown adapter");
+		return true;
+	}
+
+	pbnjson::JValue responseObj = buildDeviceStatus(adapter, -60);
+	responseObj.put("subscribed", subscribe(handle, message, "device/getStatus/" + adapterAddress(adapter)));
+	respond(message, responseObj);
+	return true;
+}
+
+// Without an address the status of every AG of the adapter is posted, one
+// reply per AG, unless only the per device form is served
+bool handleHfpGetStatus(LSHandle *handle, LSMessage *message, void *context)
+{
+	standIn.requests++;
+	pbnjson::JValue requestObj;
+	if (!parseRequest(message, requestObj))
+	{
+		respondWithError(message, "Invalid JSON input");
+		return true;
+	}
+
+	int adapter = findAdapter(requestObj["adapterAddress"].asString());
+	if (adapter < 0)
+	{
+		respondWithError(message, "Unknown adapter");
+		return true;
+	}
+
+	if (requestObj.hasKey("address"))
+	{
+		std::string remoteAddr = requestObj["address"].asString();
+		int device = 0;
+		while (device < standIn.connected && deviceAddress(adapter, device) != remoteAddr)
+			device++;
+		if (device == standIn.connected)
+		{
+			respondWithError(message, "Device is not connected");
+			return true;
+		}
+
+		pbnjson::JValue responseObj = buildSCOStatus(adapter, device);
+		responseObj.put("subscribed", subscribe(handle, message, "hfp/getStatus/" + adapterAddress(adapter) + "/" + remoteAddr));
+		respond(message, responseObj);
+		return true;
+	}
+
+	if (standIn.perDeviceOnly || standIn.connected == 0)
+	{
+		respondWithError(message, "Address parameter is missing");
+		return true;
+	}
+
+	bool subscribed = subscribe(handle, message, "hfp/getStatus/" + adapterAddress(adapter));
+	for (int i = 0; i < standIn.connected; i++)
+	{
+		pbnjson::JValue responseObj = buildSCOStatus(adapter, i);
+		responseObj.put("subscribed", subscribed);
+		respond(message, responseObj);
+	}
+	return true;
+}
+
+bool handleReceiveResult(LSHandle *handle, LSMessage *message, void *context)
+{
+	standIn.requests++;
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	responseObj.put("subscribed", subscribe(handle, message, "hfp/receiveResult"));
+	respond(message, responseObj);
+	return true;
+}
+
+bool handleSendAT(LSHandle *handle, LSMessage *message, void *context)
+{
+	standIn.requests++;
+	standIn.sendATs++;
+	pbnjson::JValue responseObj = pbnjson::Object();
+	responseObj.put("returnValue", true);
+	respond(message, responseObj);
+	return true;
+}
+
+LSMethod adapterMethods[] = {
+	{ "getStatus", handleAdapterGetStatus, LUNA_METHOD_FLAGS_NONE },
+	{ nullptr, nullptr }
+};
+
+LSMethod deviceMethods[] = {
+	{ "getStatus", handleDeviceGetStatus, LUNA_METHOD_FLAGS_NONE },
+	{ nullptr, nullptr }
+};
+
+LSMethod hfpMethods[] = {
+	{ "getStatus", handleHfpGetStatus, LUNA_METHOD_FLAGS_NONE },
+	{ "receiveResult", handleReceiveResult, LUNA_METHOD_FLAGS_NONE },
+	{ "sendAT", handleSendAT, LUNA_METHOD_FLAGS_NONE },
+	{ nullptr, nullptr }
+};
+
+unsigned int countSubscribers(const std::string &key)
+{
+	return LSSubscriptionGetHandleSubscribersCount(standIn.handle, key.c_str());
+}
+
+// Alternates a device/getStatus repost, as bluetooth2 does on any rssi or
+// property change, with a signal strength indicator of the first AG
+gboolean handleStorm(gpointer userData)
+{
+	LSError error;
+	LSErrorInit(&error);
+	int step = standIn.stormStep++;
+	if (step % 2 == 0)
+	{
+		for (int i = 0; i < standIn.adapters; i++)
+		{
+			pbnjson::JValue responseObj = buildDeviceStatus(i, -60 - (step / 2) % 20);
+			responseObj.put("subscribed", true);
+			std::string key = "device/getStatus/" + adapterAddress(i);
+			if (!LSSubscriptionReply(standIn.handle, key.c_str(), responseObj.stringify().c_str(), &error))
+			{
+				LSErrorPrint(&error, stderr);
+				LSErrorFree(&error);
+			}
+			standIn.stormPosts++;
+		}
+	}
+	else if (standIn.connected > 0)
+	{
+		pbnjson::JValue responseObj = pbnjson::Object();
+		responseObj.put("returnValue", true);
+		responseObj.put("subscribed", true);
+		responseObj.put("adapterAddress", adapterAddress(0));
+		responseObj.put("address", deviceAddress(0, 0));
+		responseObj.put("type", "receive");
+		responseObj.put("resultCode", "+CIEV: 5," + std::to_string((step / 2) % 6));
+		if (!LSSubscriptionReply(standIn.handle, "hfp/receiveResult", responseObj.stringify().c_str(), &error))
+		{
+			LSErrorPrint(&error, stderr);
+			LSErrorFree(&error);
+		}
+		standIn.stormPosts++;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+bool handleAnswerCallReply(LSHandle *handle, LSMessage *reply, void *context)
+{
+	gint64 *sent = static_cast<gint64*>(context);
+	standIn.answerUs.push_back(g_get_monotonic_time() - *sent);
+	standIn.answersPending--;
+	delete sent;
+	return true;
+}
+
+gboolean handleProbe(gpointer userData)
+{
+	std::string payload = "{\"address\":\"" + deviceAddress(0, 0) + "\",\"adapterAddress\":\"" + adapterAddress(0) + "\"}";
+	gint64 *sent = new gint64(g_get_monotonic_time());
+
+	LSError error;
+	LSErrorInit(&error);
+	if (!LSCallOneReply(standIn.handle, "luna://com.webos.service.hfp/hf/answerCall", payload.c_str(),
+	                    handleAnswerCallReply, sent, nullptr, &error))
+	{
+		LSErrorPrint(&error, stderr);
+		LSErrorFree(&error);
+		delete sent;
+		return G_SOURCE_CONTINUE;
+	}
+	standIn.answersPending++;
+	return G_SOURCE_CONTINUE;
+}
+
+void reportAnswerLatency()
+{
+	if (standIn.answerUs.empty())
+		return;
+
+	std::vector<gint64> samples = standIn.answerUs;
+	std::sort(samples.begin(), samples.end());
+	printf("hf/answerCall: %zu answered, %lu pending, median %.3f ms, 99th %.3f ms, max %.3f ms, %lu storm posts\n",
+	       samples.size(), standIn.answersPending, samples[samples.size() / 2] / 1000.0,
+	       samples[samples.size() * 99 / 100] / 1000.0, samples.back() / 1000.0, standIn.stormPosts);
+}
+
+gboolean handleReport(gpointer userData)
+{
+	unsigned int deviceStatus = 0;
+	unsigned int adapterWide = 0;
+	unsigned int perDevice = 0;
+	for (int i = 0; i < standIn.adapters; i++)
+	{
+		deviceStatus += countSubscribers("device/getStatus/" + adapterAddress(i));
+		adapterWide += countSubscribers("hfp/getStatus/" + adapterAddress(i));
+		for (int j = 0; j < standIn.connected; j++)
+			perDevice += countSubscribers("hfp/getStatus/" + adapterAddress(i) + "/" + deviceAddress(i, j));
+	}
+
+	printf("%d adapters, %d AGs connected: adapter/getStatus %u, device/getStatus %u, hfp/getStatus %u per adapter + %u per AG, "
+	       "hfp/receiveResult %u subscriptions, %lu requests, %lu sendAT\n",
+	       standIn.adapters, standIn.adapters * standIn.connected, countSubscribers("adapter/getStatus"), deviceStatus,
+	       adapterWide, perDevice, countSubscribers("hfp/receiveResult"), standIn.requests, standIn.sendATs);
+	reportAnswerLatency();
+	fflush(stdout);
+	return G_SOURCE_CONTINUE;
+}
+
+gboolean handleDuration(gpointer userData)
+{
+	handleReport(nullptr);
+	g_main_loop_quit(standIn.loop);
+	return G_SOURCE_REMOVE;
+}
+
+bool registerCategory(const char *category, LSMethod *methods)
+{
+	LSError error;
+	LSErrorInit(&error);
+	if (!LSRegisterCategory(standIn.handle, category, methods, nullptr, nullptr, &error))
+	{
+		LSErrorPrint(&error, stderr);
+		LSErrorFree(&error);
+		return false;
+	}
+	return true;
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-a ADAPTERS] [-d DEVICES] [-c CONNECTED] [-p] [-s RATE] [-l PERIOD] [-i INTERVAL] [-t DURATION]\n"
+	                "  -a ADAPTERS   powered adapters, 1 by default\n"
+	                "  -d DEVICES    paired devices per adapter, 4 by default\n"
+	                "  -c CONNECTED  of those, AGs with HFP connected, 2 by default\n"
+	                "  -p            serve hfp/getStatus only per AG, as older bluetooth2 does\n"
+	                "  -s RATE       status updates posted per second, none by default\n"
+	                "  -l PERIOD     ms between hf/answerCall probes of the first AG, none by default\n"
+	                "  -i INTERVAL   seconds between subscription counts, 5 by default\n"
+	                "  -t DURATION   seconds to run, until killed by default\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	standIn.adapters = 1;
+	standIn.devices = 4;
+	standIn.connected = 2;
+	unsigned int interval = 5;
+	unsigned int duration = 0;
+	unsigned int stormRate = 0;
+	unsigned int probePeriod = 0;
+
+	int option;
+	while ((option = getopt(argc, argv, "a:d:c:ps:l:i:t:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'a':
+			standIn.adapters = atoi(optarg);
+			break;
+		case 'd':
+			standIn.devices = atoi(optarg);
+			break;
+		case 'c':
+			standIn.connected = atoi(optarg);
+			break;
+		case 'p':
+			standIn.perDeviceOnly = true;
+			break;
+		case 's':
+			stormRate = strtoul(optarg, nullptr, 10);
+			break;
+		case 'l':
+			probePeriod = strtoul(optarg, nullptr, 10);
+			break;
+		case 'i':
+			interval = strtoul(optarg, nullptr, 10);
+			break;
+		case 't':
+			duration = strtoul(optarg, nullptr, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (standIn.adapters <= 0 || standIn.adapters > 255 || standIn.devices < 0 || standIn.devices > 255 ||
+	    standIn.connected < 0 || standIn.connected > standIn.devices || interval == 0 || stormRate > 1000)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	standIn.loop = g_main_loop_new(nullptr, FALSE);
+
+	LSError error;
+	LSErrorInit(&error);
+	if (!LSRegister("com.webos.service.bluetooth2", &standIn.handle, &error) ||
+	    !LSGmainAttach(standIn.handle, standIn.loop, &error))
+	{
+		LSErrorPrint(&error, stderr);
+		LSErrorFree(&error);
+		return 1;
+	}
+
+	if (!registerCategory("/adapter", adapterMethods) || !registerCategory("/device", deviceMethods) ||
+	    !registerCategory("/hfp", hfpMethods))
+		return 1;
+
+	g_timeout_add_seconds(interval, handleReport, nullptr);
+	if (stormRate)
+		g_timeout_add(1000 / stormRate, handleStorm, nullptr);
+	if (probePeriod)
+		g_timeout_add(probePeriod, handleProbe, nullptr);
+	if (duration)
+		g_timeout_add_seconds(duration, handleDuration, nullptr);
+	g_main_loop_run(standIn.loop);
+
+	LSUnregister(standIn.handle, &error);
+	g_main_loop_unref(standIn.loop);
+	return 0;
+}
@@ -0,0 +1,223 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Measures how long the service takes to notice a bus that comes up after
+// it started waiting for it. Every round forks a waiter, as the service
+// would be started at boot, starts the bus daemon given on the command line
+// a moment later and stops it again once the waiter saw the bus.
+//
+// The wait mode goes through DBusUtils::waitForBus. The poll mode retries
+// every 100 ms as waitForBus did before, and the tight mode retries every
+// millisecond, which is about as soon as the daemon can be connected to.
+
+#include <algorithm>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "dbusutils.h"
+#include "logging.h"
+
+PmLogContext logContext;
+
+namespace
+{
+
+struct Waiter
+{
+	GMainLoop *loop;
+	GBusType busType;
+	int readyFd;
+};
+
+Waiter waiter;
+
+void handleBusReady(bool available)
+{
+	gint64 now = g_get_monotonic_time();
+	if (write(waiter.readyFd, &now, sizeof(now)) != sizeof(now))
+		perror("write");
+	g_main_loop_quit(waiter.loop);
+}
+
+// The loop waitForBus ran before it watched the bus socket
+void pollBus(unsigned int intervalMs)
+{
+	DBusUtils::checkBus(waiter.busType, [intervalMs](bool available) {
+		if (available)
+		{
+			handleBusReady(true);
+			return;
+		}
+
+		g_timeout_add(intervalMs, [](gpointer userData) -> gboolean {
+			pollBus(GPOINTER_TO_UINT(userData));
+			return G_SOURCE_REMOVE;
+		}, GUINT_TO_POINTER(intervalMs));
+	});
+}
+
+// Runs in the forked waiter, GLib is only used from there so every round
+// starts without a bus connection cached
+void runWaiter(GBusType busType, const std::string &mode, int readyFd)
+{
+	waiter.busType = busType;
+	waiter.readyFd = readyFd;
+	waiter.loop = g_main_loop_new(nullptr, FALSE);
+
+	if (mode == "wait")
+		DBusUtils::waitForBus(busType, handleBusReady);
+	else
+		pollBus(mode == "poll" ? 100 : 1);
+
+	g_main_loop_run(waiter.loop);
+	g_main_loop_unref(waiter.loop);
+}
+
+pid_t spawn(char **command)
+{
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execvp(command[0], command);
+		_exit(127);
+	}
+	return pid;
+}
+
+// Time from starting the bus daemon until the waiter saw it, or -1
+gint64 runRound(GBusType busType, const std::string &mode, unsigned int delayMs, char **command)
+{
+	int fds[2];
+	if (pipe(fds) < 0)
+	{
+		perror("pipe");
+		return -1;
+	}
+
+	pid_t waiterPid = fork();
+	if (waiterPid == 0)
+	{
+		close(fds[0]);
+		runWaiter(busType, mode, fds[1]);
+		_exit(0);
+	}
+	close(fds[1]);
+
+	usleep(delayMs * 1000);
+	gint64 startedAt = g_get_monotonic_time();
+	pid_t daemonPid = spawn(command);
+
+	gint64 readyAt = 0;
+	bool ready = waiterPid > 0 && daemonPid > 0 && read(fds[0], &readyAt, sizeof(readyAt)) == sizeof(readyAt);
+	close(fds[0]);
+
+	if (waiterPid > 0)
+	{
+		if (!ready)
+			kill(waiterPid, SIGTERM);
+		waitpid(waiterPid, nullptr, 0);
+	}
+	if (daemonPid > 0)
+	{
+		kill(daemonPid, SIGTERM);
+		waitpid(daemonPid, nullptr, 0);
+	}
+
+	return ready ? readyAt - startedAt : -1;
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-y] [-m wait|poll|tight] [-d DELAY] [-r ROUNDS] -- COMMAND...\n"
+	                "  -y         use the system bus, the session bus by default\n"
+	                "  -m MODE    waitForBus (default), a 100 ms or a 1 ms retry\n"
+	                "  -d DELAY   ms between waiting and starting COMMAND, 200 by default, plus\n"
+	                "             up to 100 ms spread over the rounds\n"
+	                "  -r ROUNDS  rounds, 20 by default\n"
+	                "  COMMAND    starts the bus daemon in the foreground, it is stopped with\n"
+	                "             SIGTERM after each round\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	GBusType busType = G_BUS_TYPE_SESSION;
+	std::string mode = "wait";
+	unsigned int delayMs = 200;
+	int rounds = 20;
+
+	int option;
+	while ((option = getopt(argc, argv, "ym:d:r:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'y':
+			busType = G_BUS_TYPE_SYSTEM;
+			break;
+		case 'm':
+			mode = optarg;
+			break;
+		case 'd':
+			delayMs = strtoul(optarg, nullptr, 10);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc || rounds <= 0 || (mode != "wait" && mode != "poll" && mode != "tight"))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	PmLogGetContext("hfp-bus-wait-probe", &logContext);
+
+	std::vector<gint64> values;
+	for (int round = 0; round < rounds; round++)
+	{
+		// The start is spread over a 100 ms retry period so polling is not
+		// measured at one phase only
+		gint64 readyUs = runRound(busType, mode, delayMs + round * 100 / rounds, argv + optind);
+		if (readyUs < 0)
+		{
+			fprintf(stderr, "Round %d did not see the bus\n", round);
+			return 1;
+		}
+		values.push_back(readyUs);
+		usleep(100 * 1000);
+	}
+
+	std::sort(values.begin(), values.end());
+	printf("%s, %zu rounds, bus daemon start to ready: min %.1f ms  median %.1f ms  max %.1f ms\n",
+	       mode.c_str(), values.size(), values.front() / 1000.0, values[values.size() / 2] / 1000.0,
+	       values.back() / 1000.0);
+	return 0;
+}
@@ -0,0 +1,239 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Measures how long enabling SCO routing on a set of adapters holds up the
+// main loop, the way handleAdapterGetStatus does it when adapters show up.
+// The vendor command goes through HfpHciCommand with a fake transport that
+// completes after a set controller delay, through the raw HCI socket on a
+// target, or through system() as before HfpHciCommand existed.
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <glib.h>
+
+#include "HF/hfphcicommand.h"
+#include "logging.h"
+
+PmLogContext logContext;
+
+namespace
+{
+
+// Completes every command from the main loop once the controller delay is
+// over, checking that it is the SCO routing vendor command
+class FakeHciTransport : public HfpHciTransport
+{
+public:
+	FakeHciTransport(unsigned int delayMs, bool fail) :
+		mDelayMs(delayMs),
+		mFail(fail)
+	{
+	}
+
+	bool sendCommand(int deviceId, uint16_t opcode, const std::vector<uint8_t> &params,
+	                 HciCompletionCallback callback) override
+	{
+		static const std::vector<uint8_t> scoRouting = {0x01, 0x02, 0x00, 0x01, 0x01};
+		bool success = !mFail && opcode == 0xFC1C && params == scoRouting;
+		g_timeout_add(mDelayMs, [](gpointer userData) -> gboolean {
+			auto completion = static_cast<std::pair<bool, HciCompletionCallback>*>(userData);
+			completion->second(completion->first);
+			delete completion;
+			return G_SOURCE_REMOVE;
+		}, new std::pair<bool, HciCompletionCallback>(success, callback));
+		return true;
+	}
+
+private:
+	unsigned int mDelayMs;
+	bool mFail;
+};
+
+struct Bench
+{
+	GMainLoop *loop;
+	HfpHciCommand *command;
+	std::string systemCommand;
+	int adapters;
+	int rounds;
+	int round;
+	int pending;
+	int failed;
+	gint64 roundStart;
+	gint64 lastBeat;
+	gint64 maxGap;
+	std::vector<gint64> dispatchUs;
+	std::vector<gint64> completionUs;
+};
+
+gboolean handleHeartbeat(gpointer userData)
+{
+	Bench *bench = static_cast<Bench*>(userData);
+	gint64 now = g_get_monotonic_time();
+	bench->maxGap = std::max(bench->maxGap, now - bench->lastBeat);
+	bench->lastBeat = now;
+	return G_SOURCE_CONTINUE;
+}
+
+gboolean startRound(gpointer userData);
+
+void finishRound(Bench *bench)
+{
+	bench->completionUs.push_back(g_get_monotonic_time() - bench->roundStart);
+	if (++bench->round < bench->rounds)
+		g_timeout_add(10, startRound, bench);
+	else
+		g_main_loop_quit(bench->loop);
+}
+
+// One callback enabling routing on every adapter, as when bluetooth2
+// reports them all at once after boot
+gboolean startRound(gpointer userData)
+{
+	Bench *bench = static_cast<Bench*>(userData);
+	bench->roundStart = g_get_monotonic_time();
+	bench->pending = bench->adapters;
+
+	for (int i = 0; i < bench->adapters; i++)
+	{
+		std::string interfaceName = "hci" + std::to_string(i);
+		if (!bench->command)
+		{
+			std::string cmd = bench->systemCommand + " -i " + interfaceName + " cmd 0x3F 0x01C 0x01 0x02 0x00 0x01 0x01 &";
+			if (system(cmd.c_str()) != 0)
+				bench->failed++;
+			bench->pending--;
+			continue;
+		}
+
+		bool sent = bench->command->enableScoRouting(interfaceName, [bench](bool success) {
+			if (!success)
+				bench->failed++;
+			if (--bench->pending == 0)
+				finishRound(bench);
+		});
+		if (!sent)
+		{
+			bench->failed++;
+			bench->pending--;
+		}
+	}
+
+	bench->dispatchUs.push_back(g_get_monotonic_time() - bench->roundStart);
+	if (bench->pending == 0)
+		finishRound(bench);
+	return G_SOURCE_REMOVE;
+}
+
+void printDistribution(const char *name, std::vector<gint64> values)
+{
+	if (values.empty())
+		return;
+	std::sort(values.begin(), values.end());
+	printf("%-22s min %8.3f ms  median %8.3f ms  max %8.3f ms\n", name, values.front() / 1000.0,
+	       values[values.size() / 2] / 1000.0, values.back() / 1000.0);
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-t fake|socket|system] [-a ADAPTERS] [-r ROUNDS] [-d DELAY] [-f] [-c COMMAND]\n"
+	                "  -t TRANSPORT  fake controller (default), raw HCI socket or system()\n"
+	                "  -a ADAPTERS   adapters enabled per round, hci0 upwards, 1 by default\n"
+	                "  -r ROUNDS     rounds, 100 by default\n"
+	                "  -d DELAY      controller delay of the fake in ms, 2 by default\n"
+	                "  -f            the fake fails every command\n"
+	                "  -c COMMAND    run by system() in place of hcitool, \"true\" by default\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	std::string transport = "fake";
+	std::string systemCommand = "true";
+	int adapters = 1;
+	int rounds = 100;
+	unsigned int delayMs = 2;
+	bool fail = false;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:a:r:d:fc:h")) != -1)
+	{
+		switch (option)
+		{
+		case 't':
+			transport = optarg;
+			break;
+		case 'a':
+			adapters = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'd':
+			delayMs = strtoul(optarg, nullptr, 10);
+			break;
+		case 'f':
+			fail = true;
+			break;
+		case 'c':
+			systemCommand = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (adapters <= 0 || rounds <= 0 || (transport != "fake" && transport != "socket" && transport != "system"))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	PmLogGetContext("hfp-hci-bench", &logContext);
+
+	Bench bench = {};
+	bench.loop = g_main_loop_new(nullptr, FALSE);
+	bench.systemCommand = systemCommand;
+	bench.adapters = adapters;
+	bench.rounds = rounds;
+	if (transport == "fake")
+		bench.command = new HfpHciCommand(new FakeHciTransport(delayMs, fail));
+	else if (transport == "socket")
+		bench.command = new HfpHciCommand(new HfpHciSocketTransport());
+
+	bench.lastBeat = g_get_monotonic_time();
+	guint heartbeat = g_timeout_add_full(G_PRIORITY_HIGH, 1, handleHeartbeat, &bench, nullptr);
+	g_timeout_add(10, startRound, &bench);
+	g_main_loop_run(bench.loop);
+	g_source_remove(heartbeat);
+
+	printf("%s transport, %d adapters, %d rounds, %d commands failed\n", transport.c_str(), adapters, rounds, bench.failed);
+	printDistribution("main loop held", bench.dispatchUs);
+	printDistribution("all adapters done", bench.completionUs);
+	printf("%-22s %8.3f ms\n", "longest loop gap", bench.maxGap / 1000.0);
+
+	delete bench.command;
+	g_main_loop_unref(bench.loop);
+	return 0;
+}
@@ -0,0 +1,364 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Offline decoder for the state journal written by webos-hfp-service. It
+// prints the recorded transitions and rebuilds the HF device state as it
+// was after any of them.
+
+#include <algorithm>
+#include <errno.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "statejournalformat.h"
+#include "HF/hfphfdefines.h"
+
+namespace
+{
+
+const char *eventNames[JOURNAL::MAXEVENT] = {
+	"", "deviceCreated", "deviceRemoved", "indicator", "audio", "feature", "ring", "bvra",
+	"callStatus", "callErased", "callsCleared", "networkOperator", "networkStatus", "request", "result"
+};
+
+const char *indicatorNames[CIND::DeviceStatus::MAXSTATUS] = {
+	"service", "call", "callsetup", "callheld", "signal", "roam", "battchg"
+};
+
+const char *audioNames[SCO::DeviceStatus::MAXSTATUS] = { "sco", "volume" };
+
+const char *callFieldNames[CLCC::DeviceStatus::MAXSTATUS] = {
+	"index", "direction", "status", "mode", "multiparty", "number", "type"
+};
+
+// Mirrors HfpDeviceInfo
+struct DeviceState
+{
+	DeviceState() : ring(false), bvra(false), networkStatus("unknown")
+	{
+		std::fill(indicators, indicators + CIND::DeviceStatus::MAXSTATUS, (int) HFGeneral::Status::STATUSNONE);
+		std::fill(audio, audio + SCO::DeviceStatus::MAXSTATUS, (int) HFGeneral::Status::STATUSNONE);
+		std::fill(features, features + BRSF::DeviceStatus::MAXSTATUS, false);
+	}
+
+	int indicators[CIND::DeviceStatus::MAXSTATUS];
+	int audio[SCO::DeviceStatus::MAXSTATUS];
+	bool features[BRSF::DeviceStatus::MAXSTATUS];
+	bool ring;
+	bool bvra;
+	std::map<std::string, std::vector<std::string>> calls; //number to CLCC fields
+	std::string operatorName;
+	std::string networkStatus;
+};
+
+typedef std::pair<std::string, std::string> DeviceKey; //adapter and remote address
+
+std::string field(const char *value, size_t size)
+{
+	return std::string(value, strnlen(value, size));
+}
+
+std::string formatTime(int64_t time)
+{
+	time_t seconds = time / 1000000;
+	struct tm tm;
+	char buffer[32];
+	gmtime_r(&seconds, &tm);
+	strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(buffer + strlen(buffer), sizeof(buffer) - strlen(buffer), ".%03d", (int) (time % 1000000 / 1000));
+	return buffer;
+}
+
+const char* name(const char **names, int count, int index)
+{
+	return index >= 0 && index < count ? names[index] : "?";
+}
+
+bool load(const char *path, JOURNAL::FileHeader &header, std::vector<JOURNAL::Record> &records)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == STATE_JOURNAL_MAGIC &&
+	             header.format == STATE_JOURNAL_FORMAT && header.headerSize == sizeof(header) &&
+	             header.recordSize == sizeof(JOURNAL::Record);
+	if (!valid)
+	{
+		fprintf(stderr, "%s is not a state journal of this format\n", path);
+		fclose(file);
+		return false;
+	}
+
+	std::vector<JOURNAL::Record> slots(header.capacity);
+	size_t count = fread(slots.data(), sizeof(JOURNAL::Record), slots.size(), file);
+	fclose(file);
+
+	// Slots that were never written or were being written at flush time
+	// carry no sequence or one that does not belong there
+	for (size_t i = 0; i < count; i++)
+	{
+		const JOURNAL::Record &record = slots[i];
+		if (record.sequence && record.sequence < header.nextSequence && (record.sequence - 1) % header.capacity == i)
+			records.push_back(record);
+	}
+
+	std::sort(records.begin(), records.end(), [](const JOURNAL::Record &a, const JOURNAL::Record &b) {
+		return a.sequence < b.sequence;
+	});
+	return true;
+}
+
+void printEvent(const JOURNAL::Record &record)
+{
+	std::string address = field(record.address, sizeof(record.address));
+	std::string adapterAddress = field(record.adapterAddress, sizeof(record.adapterAddress));
+	std::string key = field(record.key, sizeof(record.key));
+	std::string text = field(record.text, sizeof(record.text));
+
+	printf("%8llu %s %-15s ", (unsigned long long) record.sequence, formatTime(record.time).c_str(),
+	       name(eventNames, JOURNAL::MAXEVENT, record.event));
+	if (record.event == JOURNAL::REQUEST)
+		printf("%s from %s\n", key.c_str(), text.c_str());
+	else if (record.event == JOURNAL::RESULT)
+		printf("%s returnValue %s errorCode %d\n", key.c_str(), record.value ? "true" : "false", record.index);
+	else
+	{
+		printf("%s/%s", adapterAddress.empty() ? "-" : adapterAddress.c_str(), address.empty() ? "(connecting)" : address.c_str());
+		switch (record.event)
+		{
+		case JOURNAL::INDICATOR:
+			printf(" %s=%d", name(indicatorNames, CIND::DeviceStatus::MAXSTATUS, record.index), record.value);
+			break;
+		case JOURNAL::AUDIO:
+			printf(" %s=%d", name(audioNames, SCO::DeviceStatus::MAXSTATUS, record.index), record.value);
+			break;
+		case JOURNAL::FEATURE:
+			printf(" %d=%d", record.index, record.value);
+			break;
+		case JOURNAL::RING:
+		case JOURNAL::BVRA:
+			printf(" %d", record.value);
+			break;
+		case JOURNAL::CALL_STATUS:
+			printf(" %s %s=%s", key.c_str(), name(callFieldNames, CLCC::DeviceStatus::MAXSTATUS, record.index), text.c_str());
+			break;
+		case JOURNAL::CALL_ERASED:
+			printf(" %s", key.c_str());
+			break;
+		case JOURNAL::NETWORK_OPERATOR:
+		case JOURNAL::NETWORK_STATUS:
+			printf(" %s", text.c_str());
+			break;
+		default:
+			break;
+		}
+		printf("\n");
+	}
+}
+
+// Applies one transition the way HfpHFDeviceStatus and HfpDeviceInfo did
+void apply(const JOURNAL::Record &record, std::map<DeviceKey, DeviceState> &devices, DeviceState &pending, bool &hasPending)
+{
+	if (record.event == JOURNAL::REQUEST || record.event == JOURNAL::RESULT)
+		return;
+
+	DeviceKey deviceKey(field(record.adapterAddress, sizeof(record.adapterAddress)), field(record.address, sizeof(record.address)));
+	if (record.event == JOURNAL::DEVICE_CREATED)
+	{
+		// A device that was being set up takes over what was set on it so far
+		devices[deviceKey] = hasPending ? pending : DeviceState();
+		pending = DeviceState();
+		hasPending = false;
+		return;
+	}
+	if (record.event == JOURNAL::DEVICE_REMOVED)
+	{
+		devices.erase(deviceKey);
+		return;
+	}
+
+	// Before it is created a device is only known as the one being set up
+	DeviceState *device = &pending;
+	if (deviceKey.second.empty())
+		hasPending = true;
+	else
+		device = &devices[deviceKey];
+
+	std::string key = field(record.key, sizeof(record.key));
+	std::string text = field(record.text, sizeof(record.text));
+	switch (record.event)
+	{
+	case JOURNAL::INDICATOR:
+		if (record.index >= 0 && record.index < CIND::DeviceStatus::MAXSTATUS)
+			device->indicators[record.index] = record.value;
+		break;
+	case JOURNAL::AUDIO:
+		if (record.index >= 0 && record.index < SCO::DeviceStatus::MAXSTATUS)
+			device->audio[record.index] = record.value;
+		break;
+	case JOURNAL::FEATURE:
+		if (record.index >= 0 && record.index < BRSF::DeviceStatus::MAXSTATUS)
+			device->features[record.index] = record.value != 0;
+		break;
+	case JOURNAL::RING:
+		device->ring = record.value != 0;
+		break;
+	case JOURNAL::BVRA:
+		device->bvra = record.value != 0;
+		break;
+	case JOURNAL::CALL_STATUS:
+	{
+		std::vector<std::string> &call = device->calls[key];
+		call.resize(CLCC::DeviceStatus::MAXSTATUS);
+		if (record.index >= 0 && record.index < CLCC::DeviceStatus::MAXSTATUS)
+			call[record.index] = text;
+		break;
+	}
+	case JOURNAL::CALL_ERASED:
+		device->calls.erase(key);
+		break;
+	case JOURNAL::CALLS_CLEARED:
+		device->calls.clear();
+		break;
+	case JOURNAL::NETWORK_OPERATOR:
+		device->operatorName = text;
+		break;
+	case JOURNAL::NETWORK_STATUS:
+		device->networkStatus = text;
+		break;
+	default:
+		break;
+	}
+}
+
+void printDevice(const std::string &title, const DeviceState &device)
+{
+	printf("%s\n ", title.c_str());
+	for (int i = 0; i < CIND::DeviceStatus::MAXSTATUS; i++)
+		printf(" %s=%d", indicatorNames[i], device.indicators[i]);
+	for (int i = 0; i < SCO::DeviceStatus::MAXSTATUS; i++)
+		printf(" %s=%d", audioNames[i], device.audio[i]);
+	printf(" ring=%d bvra=%d\n", device.ring, device.bvra);
+
+	printf("  features ");
+	for (int i = 0; i < BRSF::DeviceStatus::MAXSTATUS; i++)
+		printf("%s", device.features[i] ? "1" : "0");
+	printf(" operator \"%s\" network %s\n", device.operatorName.c_str(), device.networkStatus.c_str());
+
+	for (auto &call : device.calls)
+	{
+		printf("  call %s", call.first.c_str());
+		for (int i = 0; i < CLCC::DeviceStatus::MAXSTATUS; i++)
+		{
+			if (i != CLCC::DeviceStatus::NUMBER && !call.second[i].empty())
+				printf(" %s=%s", callFieldNames[i], call.second[i].c_str());
+		}
+		printf("\n");
+	}
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-e] [-s SEQUENCE | -t TIME] JOURNAL\n"
+	                "  -e           print every transition up to the end point\n"
+	                "  -s SEQUENCE  rebuild the state after this transition\n"
+	                "  -t TIME      rebuild the state at this time, in ms since the epoch\n"
+	                "Without -s or -t the state at the time of the flush is rebuilt.\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	bool printEvents = false;
+	unsigned long long untilSequence = 0;
+	long long untilTime = 0;
+
+	int option;
+	while ((option = getopt(argc, argv, "es:t:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'e':
+			printEvents = true;
+			break;
+		case 's':
+			untilSequence = strtoull(optarg, nullptr, 10);
+			break;
+		case 't':
+			untilTime = strtoll(optarg, nullptr, 10) * 1000;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	JOURNAL::FileHeader header;
+	std::vector<JOURNAL::Record> records;
+	if (!load(argv[optind], header, records))
+		return 1;
+
+	printf("Flushed %s, %llu transitions recorded, %zu in the journal\n", formatTime(header.flushTime).c_str(),
+	       (unsigned long long) (header.nextSequence - 1), records.size());
+	if (!records.empty() && records.front().sequence > 1)
+		printf("Transitions before %llu were overwritten, devices created before then are only partly known\n",
+		       (unsigned long long) records.front().sequence);
+
+	std::map<DeviceKey, DeviceState> devices;
+	DeviceState pending;
+	bool hasPending = false;
+	const JOURNAL::Record *last = nullptr;
+	for (auto &record : records)
+	{
+		if ((untilSequence && record.sequence > untilSequence) || (untilTime && record.time > untilTime))
+			break;
+
+		if (printEvents)
+			printEvent(record);
+		apply(record, devices, pending, hasPending);
+		last = &record;
+	}
+
+	if (last)
+		printf("\nState after %llu at %s\n", (unsigned long long) last->sequence, formatTime(last->time).c_str());
+	else
+		printf("\nNo transition up to that point\n");
+
+	for (auto &device : devices)
+		printDevice("AG " + device.first.second + " on " + device.first.first, device.second);
+	if (hasPending)
+		printDevice("AG being connected", pending);
+
+	return 0;
+}
@@ -0,0 +1,585 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Binds to the modems of hfp-ofono-standin the way the HF role does and
+// reports what that costs: time, memory and match rules per modem, the
+// messages the bus delivers during a PropertyChanged storm, and how long
+// it takes to be ready again once oFono restarts.
+//
+// The proxies mode creates a GDBusProxy per modem interface, fetches its
+// properties synchronously and drops everything when oFono goes away, as
+// before HfpOfonoClient existed. The client mode goes through
+// HfpOfonoClient with the subscriptions of the oFono binding classes and
+// keeps its state across a restart, the unfiltered mode does the same
+// without arg0 matches on PropertyChanged.
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "dbusutils.h"
+#include "logging.h"
+#include "HF/hfpofonoclient.h"
+
+PmLogContext logContext;
+
+namespace
+{
+
+// Properties the binding classes subscribe to, see HfpOfonoModem,
+// HfpOfonoHandsfree, HfpOfonoNetworkRegistration and HfpOfonoCallVolume
+const std::map<std::string, std::vector<const char*>> consumedProperties = {
+	{ OFONO::MODEM, { "Interfaces", "Serial" } },
+	{ OFONO::HANDSFREE, { "BatteryChargeLevel" } },
+	{ OFONO::NETWORKREGISTRATION, { "Strength", "Name", "Status" } },
+	{ OFONO::CALLVOLUME, { "SpeakerVolume" } }
+};
+
+const char *propertyInterfaces[] = {
+	OFONO::HANDSFREE, OFONO::NETWORKREGISTRATION, OFONO::CALLVOLUME
+};
+
+// As HfpOfonoManager retries GetModems
+const unsigned int getModemsRetryMinMs = 100;
+const unsigned int getModemsRetryMaxMs = 5000;
+
+struct Probe
+{
+	GMainLoop *loop;
+	GDBusConnection *connection;
+	std::string mode;
+	unsigned int stormSeconds;
+	unsigned int restarts;
+
+	// proxies mode
+	GDBusProxy *manager;
+	std::vector<GDBusProxy*> proxies;
+
+	// client and unfiltered modes
+	HfpOfonoClient *client;
+	std::vector<guint> handlerIds;
+	std::vector<guint> callIds;
+	std::vector<std::string> modems;
+	guint retrySource;
+	unsigned int retryMs;
+
+	// Last value seen of every consumed property, by path and name
+	std::map<std::string, std::string> values;
+	unsigned long published;
+
+	bool attached;
+	bool attaching;
+	unsigned int lives;
+	gint64 appearedAt;
+	gint64 lastBeat;
+	gint64 maxGap;
+	long rssBefore;
+	std::atomic<unsigned long> messagesReceived;
+	unsigned long signalsHandled;
+	unsigned long signalsConsumed;
+};
+
+Probe probe;
+
+long readRssKb()
+{
+	FILE *status = fopen("/proc/self/status", "r");
+	if (!status)
+		return -1;
+
+	char line[256];
+	long rss = -1;
+	while (fgets(line, sizeof(line), status))
+	{
+		if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+			break;
+	}
+	fclose(status);
+	return rss;
+}
+
+// Match rules the bus daemon holds for the connection, which needs the
+// Debug.Stats interface of dbus-daemon
+long readMatchRules()
+{
+	GError *error = nullptr;
+	GVariant *reply = g_dbus_connection_call_sync(probe.connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+	                                              "org.freedesktop.DBus.Debug.Stats", "GetConnectionStats",
+	                                              g_variant_new("(s)", g_dbus_connection_get_unique_name(probe.connection)),
+	                                              G_VARIANT_TYPE("(a{sv})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+	if (!reply)
+	{
+		fprintf(stderr, "No connection stats from the bus: %s\n", error->message);
+		g_error_free(error);
+		return -1;
+	}
+
+	GVariant *stats = g_variant_get_child_value(reply, 0);
+	guint32 matchRules = 0;
+	long result = g_variant_lookup(stats, "MatchRules", "u", &matchRules) ? matchRules : -1;
+	g_variant_unref(stats);
+	g_variant_unref(reply);
+	return result;
+}
+
+GDBusMessage* handleMessage(GDBusConnection *connection, GDBusMessage *message, gboolean incoming, gpointer userData)
+{
+	// Runs on the worker thread of GDBus for everything the bus delivers
+	if (incoming && g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_SIGNAL)
+		probe.messagesReceived++;
+	return message;
+}
+
+gboolean handleHeartbeat(gpointer userData)
+{
+	gint64 now = g_get_monotonic_time();
+	if (probe.attaching)
+		probe.maxGap = std::max(probe.maxGap, now - probe.lastBeat);
+	probe.lastBeat = now;
+	return G_SOURCE_CONTINUE;
+}
+
+bool isConsumed(const std::string &interface, const std::string &name)
+{
+	auto it = consumedProperties.find(interface);
+	if (it == consumedProperties.end())
+		return false;
+	for (auto property : it->second)
+	{
+		if (name == property)
+			return true;
+	}
+	return false;
+}
+
+void updateValue(const std::string &path, const std::string &interface, const std::string &name, GVariant *value)
+{
+	if (!isConsumed(interface, name))
+		return;
+
+	gchar *printed = g_variant_print(value, FALSE);
+	std::string &stored = probe.values[path + " " + name];
+	if (stored != printed)
+	{
+		stored = printed;
+		probe.published++;
+	}
+	g_free(printed);
+}
+
+void updateValues(const std::string &path, const std::string &interface, GVariant *properties)
+{
+	GVariantIter iter;
+	const gchar *name;
+	GVariant *value;
+	g_variant_iter_init(&iter, properties);
+	while (g_variant_iter_loop(&iter, "{&sv}", &name, &value))
+		updateValue(path, interface, name, value);
+}
+
+void handlePropertyChanged(const std::string &path, const std::string &interface, GVariant *parameters)
+{
+	const gchar *name = nullptr;
+	GVariant *value = nullptr;
+	g_variant_get(parameters, "(&sv)", &name, &value);
+
+	probe.signalsHandled++;
+	if (isConsumed(interface, name))
+		probe.signalsConsumed++;
+	updateValue(path, interface, name, value);
+	g_variant_unref(value);
+}
+
+void reportReady()
+{
+	probe.attaching = false;
+	gint64 now = g_get_monotonic_time();
+	// A synchronous attach never lets the heartbeat in
+	probe.maxGap = std::max(probe.maxGap, now - probe.lastBeat);
+	size_t modems = probe.mode == "proxies" ? probe.proxies.size() / 5 : probe.modems.size();
+
+	if (!probe.attached)
+	{
+		probe.attached = true;
+		long rss = readRssKb();
+		long matchRules = readMatchRules();
+		printf("attached in %.1f ms, %zu modems, RSS +%ld kB (%.1f kB per modem), %ld match rules, main loop held up to %.1f ms\n",
+		       (now - probe.appearedAt) / 1000.0, modems, rss - probe.rssBefore,
+		       modems ? (double) (rss - probe.rssBefore) / modems : 0.0, matchRules, probe.maxGap / 1000.0);
+	}
+	else
+	{
+		printf("reattached in %.1f ms, %zu modems, %lu values published, main loop held up to %.1f ms\n",
+		       (now - probe.appearedAt) / 1000.0, modems, probe.published, probe.maxGap / 1000.0);
+	}
+	fflush(stdout);
+
+	if (probe.lives > probe.restarts && !probe.stormSeconds)
+		g_main_loop_quit(probe.loop);
+}
+
+void handleProxySignal(GDBusProxy *proxy, const gchar *sender, const gchar *signalName, GVariant *parameters, gpointer userData)
+{
+	if (g_strcmp0(signalName, "PropertyChanged") == 0)
+		handlePropertyChanged(g_dbus_proxy_get_object_path(proxy), g_dbus_proxy_get_interface_name(proxy), parameters);
+}
+
+GDBusProxy* createProxy(const std::string &path, const char *interface)
+{
+	GError *error = nullptr;
+	GDBusProxy *proxy = g_dbus_proxy_new_sync(probe.connection, G_DBUS_PROXY_FLAGS_NONE, nullptr, OFONO::SERVICE,
+	                                          path.c_str(), interface, nullptr, &error);
+	if (!proxy)
+	{
+		fprintf(stderr, "Failed to create a proxy for %s on %s: %s\n", interface, path.c_str(), error->message);
+		g_error_free(error);
+		return nullptr;
+	}
+
+	g_signal_connect(proxy, "g-signal", G_CALLBACK(handleProxySignal), nullptr);
+	return proxy;
+}
+
+GVariant* callProxy(GDBusProxy *proxy, const char *method)
+{
+	GError *error = nullptr;
+	GVariant *reply = g_dbus_proxy_call_sync(proxy, method, nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+	if (!reply)
+	{
+		fprintf(stderr, "%s failed: %s\n", method, error->message);
+		g_error_free(error);
+	}
+	return reply;
+}
+
+// Everything from scratch and in one go, as createOfonoManager did
+void attachProxies()
+{
+	probe.manager = createProxy("/", OFONO::MANAGER);
+	GVariant *reply = probe.manager ? callProxy(probe.manager, "GetModems") : nullptr;
+	if (reply)
+	{
+		GVariantIter *modems = nullptr;
+		const gchar *path;
+		GVariant *properties;
+		g_variant_get(reply, "(a(oa{sv}))", &modems);
+		while (g_variant_iter_loop(modems, "(&o@a{sv})", &path, &properties))
+		{
+			updateValues(path, OFONO::MODEM, properties);
+
+			GDBusProxy *modem = createProxy(path, OFONO::MODEM);
+			GVariant *modemProperties = modem ? callProxy(modem, "GetProperties") : nullptr;
+			if (modemProperties)
+				g_variant_unref(modemProperties);
+			probe.proxies.push_back(modem);
+
+			for (auto interface : propertyInterfaces)
+			{
+				GDBusProxy *proxy = createProxy(path, interface);
+				GVariant *interfaceProperties = proxy ? callProxy(proxy, "GetProperties") : nullptr;
+				probe.proxies.push_back(proxy);
+				if (!interfaceProperties)
+					continue;
+				GVariant *dict = g_variant_get_child_value(interfaceProperties, 0);
+				updateValues(path, interface, dict);
+				g_variant_unref(dict);
+				g_variant_unref(interfaceProperties);
+			}
+
+			GDBusProxy *voiceCallManager = createProxy(path, OFONO::VOICECALLMANAGER);
+			GVariant *calls = voiceCallManager ? callProxy(voiceCallManager, "GetCalls") : nullptr;
+			if (calls)
+				g_variant_unref(calls);
+			probe.proxies.push_back(voiceCallManager);
+		}
+		g_variant_iter_free(modems);
+		g_variant_unref(reply);
+	}
+	reportReady();
+}
+
+void detachProxies()
+{
+	if (probe.manager)
+		g_object_unref(probe.manager);
+	probe.manager = nullptr;
+	for (auto proxy : probe.proxies)
+	{
+		if (proxy)
+			g_object_unref(proxy);
+	}
+	probe.proxies.clear();
+	probe.values.clear();
+}
+
+void clientCall(const std::string &path, const char *interface, const char *method, const char *replyType,
+                HfpOfonoClient::ReplyFunc func)
+{
+	probe.callIds.push_back(probe.client->call(path, interface, method, nullptr, G_VARIANT_TYPE(replyType), func));
+}
+
+void fetchProperties(const std::string &path, const char *interface)
+{
+	std::string interfaceName = interface;
+	clientCall(path, interface, "GetProperties", "(a{sv})", [path, interfaceName](GVariant *reply, GError *error) {
+		if (!reply)
+			return;
+		GVariant *dict = g_variant_get_child_value(reply, 0);
+		updateValues(path, interfaceName, dict);
+		g_variant_unref(dict);
+	});
+}
+
+void subscribeModem(const std::string &path)
+{
+	bool filtered = probe.mode == "client";
+	for (auto &interface : consumedProperties)
+	{
+		std::string interfaceName = interface.first;
+		auto func = [path, interfaceName](GVariant *parameters) { handlePropertyChanged(path, interfaceName, parameters); };
+		if (filtered)
+		{
+			auto ids = probe.client->subscribeProperties(interface.first.c_str(), path, interface.second, func);
+			probe.handlerIds.insert(probe.handlerIds.end(), ids.begin(), ids.end());
+		}
+		else
+			probe.handlerIds.push_back(probe.client->subscribe(interface.first.c_str(), "PropertyChanged", path, func));
+	}
+
+	probe.handlerIds.push_back(probe.client->subscribe(OFONO::VOICECALLMANAGER, "CallAdded", path, [](GVariant*) {}));
+	probe.handlerIds.push_back(probe.client->subscribe(OFONO::VOICECALLMANAGER, "CallRemoved", path, [](GVariant*) {}));
+}
+
+void getModems();
+
+gboolean handleGetModemsRetry(gpointer userData)
+{
+	probe.retrySource = 0;
+	getModems();
+	return G_SOURCE_REMOVE;
+}
+
+void handleGetModems(GVariant *reply, GError *error)
+{
+	if (error)
+	{
+		probe.retrySource = g_timeout_add(probe.retryMs, handleGetModemsRetry, nullptr);
+		probe.retryMs = std::min(probe.retryMs * 2, getModemsRetryMaxMs);
+		return;
+	}
+	probe.retryMs = getModemsRetryMinMs;
+
+	GVariantIter *modems = nullptr;
+	const gchar *path;
+	GVariant *properties;
+	g_variant_get(reply, "(a(oa{sv}))", &modems);
+	while (g_variant_iter_loop(modems, "(&o@a{sv})", &path, &properties))
+	{
+		// Modems that are kept only fetch their properties again
+		if (std::find(probe.modems.begin(), probe.modems.end(), path) == probe.modems.end())
+		{
+			probe.modems.push_back(path);
+			subscribeModem(path);
+		}
+
+		updateValues(path, OFONO::MODEM, properties);
+		for (auto interface : propertyInterfaces)
+			fetchProperties(path, interface);
+		clientCall(path, OFONO::VOICECALLMANAGER, "GetCalls", "(a(oa{sv}))", [](GVariant*, GError*) {});
+	}
+	g_variant_iter_free(modems);
+
+	probe.client->notifyWhenIdle([]() {
+		probe.callIds.clear();
+		if (probe.attaching)
+			reportReady();
+	});
+}
+
+void getModems()
+{
+	clientCall("/", OFONO::MANAGER, "GetModems", "(a(oa{sv}))", handleGetModems);
+}
+
+void attachClient()
+{
+	if (!probe.client)
+	{
+		probe.client = new HfpOfonoClient(G_DBUS_CONNECTION(g_object_ref(probe.connection)));
+		probe.handlerIds.push_back(probe.client->subscribe(OFONO::MANAGER, "ModemAdded", "/", [](GVariant*) {}));
+		probe.handlerIds.push_back(probe.client->subscribe(OFONO::MANAGER, "ModemRemoved", "/", [](GVariant*) {}));
+	}
+	getModems();
+}
+
+// The state stays, only what was in flight is dropped
+void detachClient()
+{
+	if (probe.retrySource)
+	{
+		g_source_remove(probe.retrySource);
+		probe.retrySource = 0;
+	}
+	for (auto callId : probe.callIds)
+		probe.client->cancel(callId);
+	probe.callIds.clear();
+}
+
+void handleOfonoStatus(bool available)
+{
+	if (!available)
+	{
+		if (!probe.attached && !probe.attaching)
+			return;
+		printf("oFono gone\n");
+		fflush(stdout);
+		probe.attaching = false;
+		if (probe.mode == "proxies")
+			detachProxies();
+		else
+			detachClient();
+		return;
+	}
+
+	probe.lives++;
+	probe.appearedAt = g_get_monotonic_time();
+	probe.lastBeat = probe.appearedAt;
+	probe.maxGap = 0;
+	probe.published = 0;
+	probe.attaching = true;
+	if (probe.mode == "proxies")
+		attachProxies();
+	else
+		attachClient();
+}
+
+gboolean startStorm(gpointer userData);
+
+gboolean finishStorm(gpointer userData)
+{
+	unsigned long received = probe.messagesReceived;
+	printf("storm over %u s: %lu signals received, %lu handled, %lu consumed\n", probe.stormSeconds, received,
+	       probe.signalsHandled, probe.signalsConsumed);
+	fflush(stdout);
+	if (probe.lives > probe.restarts)
+		g_main_loop_quit(probe.loop);
+	return G_SOURCE_REMOVE;
+}
+
+gboolean startStorm(gpointer userData)
+{
+	if (!probe.attached || probe.attaching)
+		return G_SOURCE_CONTINUE;
+
+	probe.messagesReceived = 0;
+	probe.signalsHandled = 0;
+	probe.signalsConsumed = 0;
+	g_timeout_add_seconds(probe.stormSeconds, finishStorm, nullptr);
+	return G_SOURCE_REMOVE;
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-y] [-m proxies|client|unfiltered] [-s SECONDS] [-r RESTARTS]\n"
+	                "  -y             use the system bus, the session bus by default\n"
+	                "  -m MODE        bind as before HfpOfonoClient, through it (default) or through\n"
+	                "                 it without arg0 matches\n"
+	                "  -s SECONDS     count the signals of a storm for SECONDS once attached\n"
+	                "  -r RESTARTS    stay for RESTARTS restarts of oFono, none by default\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	GBusType busType = G_BUS_TYPE_SESSION;
+	probe.mode = "client";
+
+	int option;
+	while ((option = getopt(argc, argv, "ym:s:r:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'y':
+			busType = G_BUS_TYPE_SYSTEM;
+			break;
+		case 'm':
+			probe.mode = optarg;
+			break;
+		case 's':
+			probe.stormSeconds = strtoul(optarg, nullptr, 10);
+			break;
+		case 'r':
+			probe.restarts = strtoul(optarg, nullptr, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (probe.mode != "proxies" && probe.mode != "client" && probe.mode != "unfiltered")
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	PmLogGetContext("hfp-ofono-probe", &logContext);
+
+	GError *error = nullptr;
+	probe.connection = g_bus_get_sync(busType, nullptr, &error);
+	if (!probe.connection)
+	{
+		fprintf(stderr, "Failed to connect to the bus: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_dbus_connection_add_filter(probe.connection, handleMessage, nullptr, nullptr);
+
+	probe.loop = g_main_loop_new(nullptr, FALSE);
+	probe.retryMs = getModemsRetryMinMs;
+	probe.rssBefore = readRssKb();
+
+	DBusUtils::NameWatch nameWatch(busType, OFONO::SERVICE);
+	nameWatch.watch(handleOfonoStatus);
+
+	guint heartbeat = g_timeout_add_full(G_PRIORITY_HIGH, 1, handleHeartbeat, nullptr, nullptr);
+	if (probe.stormSeconds)
+		g_timeout_add(100, startStorm, nullptr);
+	g_main_loop_run(probe.loop);
+	g_source_remove(heartbeat);
+
+	if (probe.mode == "proxies")
+		detachProxies();
+	else if (probe.client)
+	{
+		detachClient();
+		probe.client->unsubscribe(probe.handlerIds);
+		delete probe.client;
+	}
+	g_main_loop_unref(probe.loop);
+	g_object_unref(probe.connection);
+	return 0;
+}
@@ -0,0 +1,385 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Stand-in for oFono with a fixed set of HFP modems, for running the oFono
+// binding against a private bus. Each modem has the interfaces the HF role
+// uses and answers their GetProperties, without any calls.
+//
+// It can keep emitting PropertyChanged for properties the service consumes
+// and for ones it does not, and it can restart itself: it drops its bus
+// connection, which takes org.ofono away, and comes back on a new one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+namespace
+{
+
+const char introspectionXml[] =
+	"<node>"
+	"  <interface name='org.ofono.Manager'>"
+	"    <method name='GetModems'><arg type='a(oa{sv})' direction='out'/></method>"
+	"    <signal name='ModemAdded'><arg type='o'/><arg type='a{sv}'/></signal>"
+	"    <signal name='ModemRemoved'><arg type='o'/></signal>"
+	"  </interface>"
+	"  <interface name='org.ofono.Modem'>"
+	"    <method name='GetProperties'><arg type='a{sv}' direction='out'/></method>"
+	"    <signal name='PropertyChanged'><arg type='s'/><arg type='v'/></signal>"
+	"  </interface>"
+	"  <interface name='org.ofono.Handsfree'>"
+	"    <method name='GetProperties'><arg type='a{sv}' direction='out'/></method>"
+	"    <signal name='PropertyChanged'><arg type='s'/><arg type='v'/></signal>"
+	"  </interface>"
+	"  <interface name='org.ofono.NetworkRegistration'>"
+	"    <method name='GetProperties'><arg type='a{sv}' direction='out'/></method>"
+	"    <signal name='PropertyChanged'><arg type='s'/><arg type='v'/></signal>"
+	"  </interface>"
+	"  <interface name='org.ofono.CallVolume'>"
+	"    <method name='GetProperties'><arg type='a{sv}' direction='out'/></method>"
+	"    <signal name='PropertyChanged'><arg type='s'/><arg type='v'/></signal>"
+	"  </interface>"
+	"  <interface name='org.ofono.VoiceCallManager'>"
+	"    <method name='GetProperties'><arg type='a{sv}' direction='out'/></method>"
+	"    <method name='GetCalls'><arg type='a(oa{sv})' direction='out'/></method>"
+	"    <signal name='CallAdded'><arg type='o'/><arg type='a{sv}'/></signal>"
+	"    <signal name='CallRemoved'><arg type='o'/></signal>"
+	"    <signal name='PropertyChanged'><arg type='s'/><arg type='v'/></signal>"
+	"  </interface>"
+	"</node>";
+
+const char *modemInterfaces[] = {
+	"org.ofono.Modem", "org.ofono.Handsfree", "org.ofono.NetworkRegistration", "org.ofono.CallVolume",
+	"org.ofono.VoiceCallManager"
+};
+
+// One change after the other, per modem. Strength and BatteryChargeLevel
+// are consumed by the service, the rest is not
+struct PropertyChange
+{
+	const char *interface;
+	const char *name;
+};
+
+const PropertyChange stormChanges[] = {
+	{ "org.ofono.NetworkRegistration", "Strength" },
+	{ "org.ofono.NetworkRegistration", "LocationAreaCode" },
+	{ "org.ofono.NetworkRegistration", "CellId" },
+	{ "org.ofono.NetworkRegistration", "Technology" },
+	{ "org.ofono.Handsfree", "BatteryChargeLevel" },
+	{ "org.ofono.CallVolume", "MicrophoneVolume" }
+};
+
+struct StandIn
+{
+	GMainLoop *loop;
+	GBusType busType;
+	GDBusNodeInfo *introspection;
+	GDBusConnection *connection;
+	guint ownerId;
+	std::vector<guint> registrations;
+	int modems;
+	unsigned int stormRate;
+	unsigned int restartMs;
+	unsigned int downMs;
+	unsigned int lateMs;
+	guint stormSource;
+	unsigned long stormStep;
+	unsigned long lives;
+};
+
+StandIn standIn;
+
+std::string modemPath(int modem)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "/hfp/org/bluez/hci0/dev_00_11_22_33_%02X_%02X", (modem >> 8) & 0xff, modem & 0xff);
+	return buffer;
+}
+
+std::string modemSerial(int modem)
+{
+	char buffer[18];
+	snprintf(buffer, sizeof(buffer), "00:11:22:33:%02X:%02X", (modem >> 8) & 0xff, modem & 0xff);
+	return buffer;
+}
+
+GVariant* buildModemProperties(int modem)
+{
+	GVariantBuilder interfaces;
+	g_variant_builder_init(&interfaces, G_VARIANT_TYPE("as"));
+	for (auto interface : modemInterfaces)
+		g_variant_builder_add(&interfaces, "s", interface);
+
+	GVariantBuilder properties;
+	g_variant_builder_init(&properties, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&properties, "{sv}", "Powered", g_variant_new_boolean(TRUE));
+	g_variant_builder_add(&properties, "{sv}", "Online", g_variant_new_boolean(TRUE));
+	g_variant_builder_add(&properties, "{sv}", "Name", g_variant_new_string("AG"));
+	g_variant_builder_add(&properties, "{sv}", "Serial", g_variant_new_string(modemSerial(modem).c_str()));
+	g_variant_builder_add(&properties, "{sv}", "Type", g_variant_new_string("hfp"));
+	g_variant_builder_add(&properties, "{sv}", "Interfaces", g_variant_builder_end(&interfaces));
+	return g_variant_builder_end(&properties);
+}
+
+GVariant* buildInterfaceProperties(const std::string &interface)
+{
+	GVariantBuilder properties;
+	g_variant_builder_init(&properties, G_VARIANT_TYPE_VARDICT);
+	if (interface == "org.ofono.Handsfree")
+	{
+		g_variant_builder_add(&properties, "{sv}", "BatteryChargeLevel", g_variant_new_byte(4));
+		g_variant_builder_add(&properties, "{sv}", "VoiceRecognition", g_variant_new_boolean(FALSE));
+		g_variant_builder_add(&properties, "{sv}", "EchoCancelingNoiseReduction", g_variant_new_boolean(TRUE));
+	}
+	else if (interface == "org.ofono.NetworkRegistration")
+	{
+		g_variant_builder_add(&properties, "{sv}", "Status", g_variant_new_string("registered"));
+		g_variant_builder_add(&properties, "{sv}", "Name", g_variant_new_string("Operator"));
+		g_variant_builder_add(&properties, "{sv}", "Strength", g_variant_new_byte(80));
+		g_variant_builder_add(&properties, "{sv}", "LocationAreaCode", g_variant_new_uint16(1));
+		g_variant_builder_add(&properties, "{sv}", "CellId", g_variant_new_uint32(1));
+		g_variant_builder_add(&properties, "{sv}", "Technology", g_variant_new_string("lte"));
+	}
+	else if (interface == "org.ofono.CallVolume")
+	{
+		g_variant_builder_add(&properties, "{sv}", "SpeakerVolume", g_variant_new_byte(60));
+		g_variant_builder_add(&properties, "{sv}", "MicrophoneVolume", g_variant_new_byte(60));
+		g_variant_builder_add(&properties, "{sv}", "Muted", g_variant_new_boolean(FALSE));
+	}
+	return g_variant_builder_end(&properties);
+}
+
+void handleMethodCall(GDBusConnection *connection, const gchar *sender, const gchar *objectPath,
+                      const gchar *interfaceName, const gchar *methodName, GVariant *parameters,
+                      GDBusMethodInvocation *invocation, gpointer userData)
+{
+	int modem = GPOINTER_TO_INT(userData);
+	std::string interface = interfaceName;
+	std::string method = methodName;
+
+	if (interface == "org.ofono.Manager" && method == "GetModems")
+	{
+		GVariantBuilder modems;
+		g_variant_builder_init(&modems, G_VARIANT_TYPE("a(oa{sv})"));
+		for (int i = 0; i < standIn.modems; i++)
+			g_variant_builder_add(&modems, "(o@a{sv})", modemPath(i).c_str(), buildModemProperties(i));
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(oa{sv}))", &modems));
+	}
+	else if (interface == "org.ofono.VoiceCallManager" && method == "GetCalls")
+	{
+		GVariantBuilder calls;
+		g_variant_builder_init(&calls, G_VARIANT_TYPE("a(oa{sv})"));
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(oa{sv}))", &calls));
+	}
+	else if (method == "GetProperties")
+	{
+		GVariant *properties = interface == "org.ofono.Modem" ? buildModemProperties(modem) : buildInterfaceProperties(interface);
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(@a{sv})", properties));
+	}
+	else
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.ofono.Error.NotImplemented", "Not implemented");
+}
+
+const GDBusInterfaceVTable interfaceVTable = { handleMethodCall, nullptr, nullptr };
+
+bool registerObject(const std::string &path, const char *interface, int modem)
+{
+	GError *error = nullptr;
+	GDBusInterfaceInfo *info = g_dbus_node_info_lookup_interface(standIn.introspection, interface);
+	guint id = g_dbus_connection_register_object(standIn.connection, path.c_str(), info, &interfaceVTable,
+	                                             GINT_TO_POINTER(modem), nullptr, &error);
+	if (!id)
+	{
+		fprintf(stderr, "Failed to register %s on %s: %s\n", interface, path.c_str(), error->message);
+		g_error_free(error);
+		return false;
+	}
+	standIn.registrations.push_back(id);
+	return true;
+}
+
+gboolean registerObjects(gpointer userData)
+{
+	registerObject("/", "org.ofono.Manager", 0);
+	for (int i = 0; i < standIn.modems; i++)
+	{
+		for (auto interface : modemInterfaces)
+			registerObject(modemPath(i), interface, i);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+gboolean handleStorm(gpointer userData)
+{
+	const PropertyChange &change = stormChanges[standIn.stormStep % G_N_ELEMENTS(stormChanges)];
+	guint8 value = (guint8) (standIn.stormStep / G_N_ELEMENTS(stormChanges));
+	standIn.stormStep++;
+
+	GVariant *valueVar;
+	std::string name = change.name;
+	if (name == "LocationAreaCode")
+		valueVar = g_variant_new_uint16(value);
+	else if (name == "CellId")
+		valueVar = g_variant_new_uint32(value);
+	else if (name == "Technology")
+		valueVar = g_variant_new_string(value % 2 ? "umts" : "lte");
+	else
+		valueVar = g_variant_new_byte(value % 100);
+
+	// The same change goes to every modem, ref'd as emit_signal sinks it
+	GVariant *parameters = g_variant_ref_sink(g_variant_new("(sv)", change.name, valueVar));
+	for (int i = 0; i < standIn.modems; i++)
+		g_dbus_connection_emit_signal(standIn.connection, nullptr, modemPath(i).c_str(), change.interface,
+		                              "PropertyChanged", parameters, nullptr);
+	g_variant_unref(parameters);
+	return G_SOURCE_CONTINUE;
+}
+
+gboolean handleRestart(gpointer userData);
+
+gboolean start(gpointer userData)
+{
+	GError *error = nullptr;
+	gchar *address = g_dbus_address_get_for_bus_sync(standIn.busType, nullptr, &error);
+	if (address)
+	{
+		// A connection of its own, so every life has a new unique name as
+		// a restarted oFono would
+		standIn.connection = g_dbus_connection_new_for_address_sync(address,
+			(GDBusConnectionFlags) (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+			nullptr, nullptr, &error);
+		g_free(address);
+	}
+	if (!standIn.connection)
+	{
+		fprintf(stderr, "Failed to connect to the bus: %s\n", error->message);
+		g_error_free(error);
+		g_main_loop_quit(standIn.loop);
+		return G_SOURCE_REMOVE;
+	}
+
+	// oFono may own its name a moment before its objects answer
+	if (standIn.lateMs)
+		g_timeout_add(standIn.lateMs, registerObjects, nullptr);
+	else
+		registerObjects(nullptr);
+	standIn.ownerId = g_bus_own_name_on_connection(standIn.connection, "org.ofono", G_BUS_NAME_OWNER_FLAGS_NONE,
+	                                               nullptr, nullptr, nullptr, nullptr);
+
+	standIn.lives++;
+	printf("oFono stand-in up as %s with %d modems, life %lu\n", g_dbus_connection_get_unique_name(standIn.connection),
+	       standIn.modems, standIn.lives);
+	fflush(stdout);
+
+	if (standIn.stormRate)
+		standIn.stormSource = g_timeout_add(1000 / standIn.stormRate, handleStorm, nullptr);
+	if (standIn.restartMs)
+		g_timeout_add(standIn.restartMs, handleRestart, nullptr);
+	return G_SOURCE_REMOVE;
+}
+
+gboolean handleRestart(gpointer userData)
+{
+	if (standIn.stormSource)
+	{
+		g_source_remove(standIn.stormSource);
+		standIn.stormSource = 0;
+	}
+	for (auto id : standIn.registrations)
+		g_dbus_connection_unregister_object(standIn.connection, id);
+	standIn.registrations.clear();
+	g_bus_unown_name(standIn.ownerId);
+	g_dbus_connection_close_sync(standIn.connection, nullptr, nullptr);
+	g_object_unref(standIn.connection);
+	standIn.connection = nullptr;
+
+	printf("oFono stand-in down for %u ms\n", standIn.downMs);
+	fflush(stdout);
+	g_timeout_add(standIn.downMs, start, nullptr);
+	return G_SOURCE_REMOVE;
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-y] [-m MODEMS] [-s RATE] [-r PERIOD] [-d DOWN] [-l LATE]\n"
+	                "  -y         use the system bus, the session bus by default\n"
+	                "  -m MODEMS  HFP modems, 4 by default\n"
+	                "  -s RATE    PropertyChanged per second and modem, none by default\n"
+	                "  -r PERIOD  restart every PERIOD ms, never by default\n"
+	                "  -d DOWN    ms without oFono on a restart, 500 by default\n"
+	                "  -l LATE    ms between owning org.ofono and answering on it, 0 by default\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	standIn.busType = G_BUS_TYPE_SESSION;
+	standIn.modems = 4;
+	standIn.downMs = 500;
+
+	int option;
+	while ((option = getopt(argc, argv, "ym:s:r:d:l:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'y':
+			standIn.busType = G_BUS_TYPE_SYSTEM;
+			break;
+		case 'm':
+			standIn.modems = atoi(optarg);
+			break;
+		case 's':
+			standIn.stormRate = strtoul(optarg, nullptr, 10);
+			break;
+		case 'r':
+			standIn.restartMs = strtoul(optarg, nullptr, 10);
+			break;
+		case 'd':
+			standIn.downMs = strtoul(optarg, nullptr, 10);
+			break;
+		case 'l':
+			standIn.lateMs = strtoul(optarg, nullptr, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (standIn.modems < 0 || standIn.modems > 0xffff || standIn.stormRate > 1000)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	standIn.introspection = g_dbus_node_info_new_for_xml(introspectionXml, nullptr);
+	standIn.loop = g_main_loop_new(nullptr, FALSE);
+	start(nullptr);
+	if (standIn.connection)
+		g_main_loop_run(standIn.loop);
+
+	g_dbus_node_info_unref(standIn.introspection);
+	g_main_loop_unref(standIn.loop);
+	return 0;
+}
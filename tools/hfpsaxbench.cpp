@@ -0,0 +1,305 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Compares the selective SAX readers of subscription replies with the DOM
+// parse they replaced, on payloads shaped like the ones bluetooth2 and
+// telephony post. The DOM side reads the same keys the handlers used to
+// read after LSUtils::parsePayload.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+#include <pbnjson.hpp>
+
+#include "jsonsaxparser.h"
+#include "AG/hfpagreplyparser.h"
+
+namespace
+{
+
+long long now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+std::string address(int index)
+{
+	char buffer[18];
+	snprintf(buffer, sizeof(buffer), "00:11:22:33:%02x:%02x", (index >> 8) & 0xff, index & 0xff);
+	return buffer;
+}
+
+// hfp/receiveResult carrying one unsolicited result code
+std::string receiveResultPayload()
+{
+	return "{\"returnValue\":true,\"subscribed\":true,\"adapterAddress\":\"00:aa:bb:cc:dd:ee\","
+	       "\"address\":\"" + address(1) + "\",\"type\":\"receive\",\"resultCode\":\"+CIEV: 5,3\\r\\n\"}";
+}
+
+// device/getStatus with every paired device listed in full
+std::string deviceStatusPayload(int devices)
+{
+	std::string payload = "{\"returnValue\":true,\"subscribed\":true,\"adapterAddress\":\"00:aa:bb:cc:dd:ee\",\"devices\":[";
+	for (int i = 0; i < devices; i++)
+	{
+		if (i)
+			payload += ",";
+		payload += "{\"name\":\"Phone " + std::to_string(i) + "\",\"address\":\"" + address(i) + "\","
+		           "\"adapterAddress\":\"00:aa:bb:cc:dd:ee\",\"typeOfDevice\":\"bredr\",\"classOfDevice\":5898764,"
+		           "\"paired\":true,\"pairing\":false,\"trusted\":true,\"blocked\":false,\"rssi\":-61,"
+		           "\"serviceClasses\":[{\"mask\":1,\"name\":\"HFP\",\"category\":\"AG\"},"
+		           "{\"mask\":2,\"name\":\"A2DP\",\"category\":\"SRC\"},{\"mask\":4,\"name\":\"PBAP\",\"category\":\"PSE\"}],"
+		           "\"connectedProfiles\":[\"hfp\",\"a2dp\"],\"connectedRoles\":[\"HFP_AG\",\"A2DP_SRC\"],"
+		           "\"manufacturerData\":{\"companyId\":[0,76],\"data\":[2,21,1,2,3,4,5,6,7,8]}}";
+	}
+	return payload + "]}";
+}
+
+// com.palm.telephony/callStateQuery with one call per line
+std::string callStatePayload(int lines)
+{
+	std::string payload = "{\"returnValue\":true,\"subscribed\":true,\"lines\":[";
+	for (int i = 0; i < lines; i++)
+	{
+		if (i)
+			payload += ",";
+		payload += "{\"id\":" + std::to_string(i + 1) + ",\"state\":\"" + (i ? "held" : "active") + "\","
+		           "\"calls\":[{\"id\":" + std::to_string(i + 1) + ",\"origin\":\"incoming\",\"address\":\"+1555000" +
+		           std::to_string(1000 + i) + "\",\"imsconfinfo\":false,\"startTime\":1600000000000,"
+		           "\"duration\":12345,\"cnap\":\"\",\"presentation\":\"allowed\"}]}";
+	}
+	return payload + "]}";
+}
+
+bool domParse(const std::string &payload, pbnjson::JValue &object)
+{
+	pbnjson::JDomParser parser;
+	if (!parser.parse(payload, pbnjson::JSchema::AllSchema()))
+		return false;
+	object = parser.getDom();
+	return true;
+}
+
+// Each reader returns a value derived from what it read, so the work is
+// not optimized away
+size_t domReceiveResult(const std::string &payload)
+{
+	pbnjson::JValue replyObj;
+	if (!domParse(payload, replyObj))
+		return 0;
+	return replyObj["address"].asString().size() + replyObj["resultCode"].asString().size();
+}
+
+size_t domDeviceStatus(const std::string &payload)
+{
+	pbnjson::JValue replyObj;
+	if (!domParse(payload, replyObj))
+		return 0;
+
+	size_t connected = 0;
+	pbnjson::JValue devices = replyObj["devices"];
+	for (int i = 0; i < devices.arraySize(); i++)
+	{
+		pbnjson::JValue device = devices[i];
+		if (!device.hasKey("address") || !device.hasKey("connectedRoles"))
+			continue;
+		std::string remoteAddr = device["address"].asString();
+		pbnjson::JValue roles = device["connectedRoles"];
+		for (int j = 0; j < roles.arraySize(); j++)
+		{
+			if (roles[j].asString() == "HFP_AG")
+				connected += remoteAddr.size();
+		}
+	}
+	return connected;
+}
+
+size_t domCallState(const std::string &payload)
+{
+	pbnjson::JValue replyObj;
+	if (!domParse(payload, replyObj) || !replyObj.hasKey("lines"))
+		return 0;
+
+	size_t read = 0;
+	pbnjson::JValue lines = replyObj["lines"];
+	for (int i = 0; i < lines.arraySize(); i++)
+	{
+		pbnjson::JValue line = lines[i];
+		if (line.hasKey("state"))
+			read += line["state"].asString().size();
+		if (!line.hasKey("calls"))
+			continue;
+		pbnjson::JValue call = line["calls"][0];
+		if (call.hasKey("id"))
+			read += call["id"].asNumber<int32_t>();
+		if (call.hasKey("origin"))
+			read += call["origin"].asString().size();
+		if (call.hasKey("imsconfinfo"))
+			read += call["imsconfinfo"].asBool();
+		if (call.hasKey("address"))
+			read += call["address"].asString().size();
+	}
+	return read;
+}
+
+// Mirrors the receiveResult binding of HfpHFReplyParser
+class ReceiveResultReader
+{
+public:
+	ReceiveResultReader()
+	{
+		mParser.bindString("address", [this](const std::string &value) { mAddress = value; });
+		mParser.bindString("resultCode", [this](const std::string &value) { mResultCode = value; });
+	}
+
+	size_t read(const std::string &payload)
+	{
+		mAddress.clear();
+		mResultCode.clear();
+		if (!mParser.parse(payload))
+			return 0;
+		return mAddress.size() + mResultCode.size();
+	}
+
+private:
+	JsonSaxParser mParser;
+	std::string mAddress;
+	std::string mResultCode;
+};
+
+struct Result
+{
+	double nsPerParse;
+	size_t checksum;
+};
+
+template<class F>
+Result run(int iterations, F read)
+{
+	size_t checksum = 0;
+	long long start = now();
+	for (int i = 0; i < iterations; i++)
+		checksum += read();
+	return { (double) (now() - start) / iterations, checksum };
+}
+
+void report(const char *name, size_t size, const Result &dom, const Result &sax)
+{
+	printf("%-16s %7zu bytes  dom %9.0f ns  sax %9.0f ns  %5.2fx%s\n", name, size, dom.nsPerParse, sax.nsPerParse,
+	       dom.nsPerParse / sax.nsPerParse, dom.checksum == sax.checksum ? "" : "  (readers disagree)");
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-n ITERATIONS] [-d DEVICES] [-l LINES]\n"
+	                "  -n ITERATIONS  parses per payload, 100000 by default\n"
+	                "  -d DEVICES     devices in device/getStatus, 8 by default\n"
+	                "  -l LINES       lines in callStateQuery, 2 by default\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 100000;
+	int devices = 8;
+	int lines = 2;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:d:l:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'd':
+			devices = atoi(optarg);
+			break;
+		case 'l':
+			lines = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (iterations <= 0 || devices < 0 || lines < 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::string receiveResult = receiveResultPayload();
+	std::string deviceStatus = deviceStatusPayload(devices);
+	std::string callState = callStatePayload(lines);
+
+	ReceiveResultReader receiveResultReader;
+	HfpAGReplyParser replyParser;
+
+	Result dom = run(iterations, [&]() { return domReceiveResult(receiveResult); });
+	Result sax = run(iterations, [&]() { return receiveResultReader.read(receiveResult); });
+	report("receiveResult", receiveResult.size(), dom, sax);
+
+	dom = run(iterations, [&]() { return domDeviceStatus(deviceStatus); });
+	sax = run(iterations, [&]() {
+		AGReply::DeviceStatus result;
+		if (!replyParser.parseDeviceStatus(deviceStatus, result))
+			return (size_t) 0;
+		size_t connected = 0;
+		for (auto &device : result.devices)
+		{
+			if (device.hasAddress && device.hasConnectedProfiles && device.hfpConnected)
+				connected += device.address.size();
+		}
+		return connected;
+	});
+	// The AG reader keys on connectedProfiles, the DOM side on
+	// connectedRoles, both are set on every device of the payload
+	report("device/getStatus", deviceStatus.size(), dom, sax);
+
+	dom = run(iterations, [&]() { return domCallState(callState); });
+	sax = run(iterations, [&]() {
+		AGReply::CallState result;
+		if (!replyParser.parseCallState(callState, result))
+			return (size_t) 0;
+		size_t read = 0;
+		for (auto &line : result.lines)
+		{
+			if (line.hasState)
+				read += line.state.size();
+			if (line.hasId)
+				read += line.id;
+			if (line.hasOrigin)
+				read += line.origin.size();
+			if (line.hasImsConfInfo)
+				read += line.imsconfinfo;
+			if (line.hasAddress)
+				read += line.address.size();
+		}
+		return read;
+	});
+	report("callStateQuery", callState.size(), dom, sax);
+
+	return 0;
+}
@@ -0,0 +1,313 @@
+// Copyright (c) 2020 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+// Sizes and serializes hf/getStatus payloads the way the HF role builds
+// them, from AG objects shaped like buildGetStatusResp makes them.
+//
+// Typical widget filters are compared with the unfiltered v1 payload, and
+// a run of status changes counts how many of them still change what a
+// filter shows and so get posted. v1 is then compared with v2 for a
+// growing number of calls per AG.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <pbnjson.hpp>
+
+#include "HF/hfphfstatusfilter.h"
+
+namespace
+{
+
+struct AGState
+{
+	int signal;
+	int battery;
+	bool sco;
+	int volume;
+	bool ring;
+	int calls;
+	int callStatus;
+};
+
+long long now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+std::string address(int index)
+{
+	char buffer[18];
+	snprintf(buffer, sizeof(buffer), "00:11:22:33:%02x:%02x", (index >> 8) & 0xff, index & 0xff);
+	return buffer;
+}
+
+// As HfpHFRole::buildGetStatusResp
+pbnjson::JValue buildAG(int index, const AGState &state)
+{
+	pbnjson::JValue callsObj = pbnjson::Array();
+	for (int i = 0; i < state.calls; i++)
+	{
+		pbnjson::JValue callObj = pbnjson::Object();
+		callObj.put("number", "+1555000" + std::to_string(1000 + i));
+		callObj.put("callStatus", std::to_string(i ? 1 : state.callStatus));
+		callObj.put("direction", std::to_string(i % 2));
+		callObj.put("index", i + 1);
+		callsObj.append(callObj);
+	}
+
+	pbnjson::JValue AGObj = pbnjson::Object();
+	AGObj.put("address", address(index));
+	AGObj.put("adapterAddress", "00:aa:bb:cc:dd:ee");
+	AGObj.put("signal", std::to_string(state.signal));
+	AGObj.put("battery", std::to_string(state.battery));
+	AGObj.put("sco", state.sco);
+	AGObj.put("volume", std::to_string(state.volume));
+	AGObj.put("ring", state.ring);
+	AGObj.put("operatorName", "Operator " + std::to_string(index));
+	AGObj.put("networkStatus", "registered");
+	AGObj.put("calls", callsObj);
+	return AGObj;
+}
+
+pbnjson::JValue buildDevices(const HfpHFStatusFilter &filter, const std::vector<pbnjson::JValue> &fragments)
+{
+	pbnjson::JValue devicesObj = pbnjson::Array();
+	for (size_t i = 0; i < fragments.size(); i++)
+	{
+		if (!filter.matchesDevice(address(i)))
+			continue;
+
+		if (filter.getVersion() >= 2)
+			devicesObj.append(filter.project(fragments[i]));
+		else
+			HfpHFStatusFilter::flatten(filter.project(fragments[i]), devicesObj);
+	}
+	return devicesObj;
+}
+
+// As HfpHFRole::getStatusSnapshot for a subscription
+std::string serialize(const HfpHFStatusFilter &filter, const std::vector<pbnjson::JValue> &fragments)
+{
+	pbnjson::JValue responseObj = pbnjson::Object();
+	if (filter.getVersion() >= 2)
+		responseObj.put("version", filter.getVersion());
+	responseObj.put("statusVersion", (int64_t) 12345);
+	responseObj.put("audioGateways", buildDevices(filter, fragments));
+	responseObj.put("returnValue", true);
+	responseObj.put("subscribed", true);
+
+	std::string payload;
+	pbnjson::JGenerator serializer(NULL);
+	serializer.toString(responseObj, pbnjson::JSchema::AllSchema(), payload);
+	return payload;
+}
+
+HfpHFStatusFilter makeFilter(int version, const std::vector<std::string> &fields, const std::vector<std::string> &devices)
+{
+	pbnjson::JValue requestObj = pbnjson::Object();
+	requestObj.put("version", version);
+	if (!fields.empty())
+	{
+		pbnjson::JValue fieldsObj = pbnjson::Array();
+		for (auto &field : fields)
+			fieldsObj.append(field);
+		requestObj.put("fields", fieldsObj);
+	}
+	if (!devices.empty())
+	{
+		pbnjson::JValue devicesObj = pbnjson::Array();
+		for (auto &device : devices)
+			devicesObj.append(device);
+		requestObj.put("devices", devicesObj);
+	}
+
+	HfpHFStatusFilter filter;
+	filter.parse(requestObj);
+	return filter;
+}
+
+std::vector<pbnjson::JValue> buildFragments(int ags, const AGState &state)
+{
+	std::vector<pbnjson::JValue> fragments;
+	for (int i = 0; i < ags; i++)
+		fragments.push_back(buildAG(i, state));
+	return fragments;
+}
+
+// Best of a few rounds, so that a preempted round does not count
+double timeSerialize(int iterations, const HfpHFStatusFilter &filter, const std::vector<pbnjson::JValue> &fragments)
+{
+	double best = 0;
+	size_t checksum = 0;
+	for (int round = 0; round < 5; round++)
+	{
+		long long start = now();
+		for (int i = 0; i < iterations; i++)
+			checksum += serialize(filter, fragments).size();
+		double ns = (double) (now() - start) / iterations;
+		if (!best || ns < best)
+			best = ns;
+	}
+	return checksum ? best : 0;
+}
+
+// Changes of a call on AG 0, as they come in: mostly signal and volume,
+// now and then battery, audio, ring and call progress
+void applyChange(int step, AGState &state)
+{
+	switch (step % 12)
+	{
+	case 0: case 3: case 6: case 9:
+		state.signal = (state.signal + 1) % 6;
+		break;
+	case 1: case 5: case 10:
+		state.volume = (state.volume + 1) % 16;
+		break;
+	case 2:
+		state.battery = (state.battery + 4) % 6;
+		break;
+	case 4:
+		state.sco = !state.sco;
+		break;
+	case 7:
+		state.ring = !state.ring;
+		break;
+	case 8: case 11:
+		state.callStatus = (state.callStatus + 1) % 5;
+		break;
+	}
+}
+
+void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [-n ITERATIONS] [-a AGS] [-c CHANGES]\n"
+	                "  -n ITERATIONS  serializations per payload and round, 100000 by default\n"
+	                "  -a AGS         connected AGs, 2 by default\n"
+	                "  -c CHANGES     status changes run through the filters, 1200 by default\n", program);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 100000;
+	int ags = 2;
+	int changes = 1200;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:a:c:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'a':
+			ags = atoi(optarg);
+			break;
+		case 'c':
+			changes = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (iterations <= 0 || ags <= 0 || changes <= 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	struct Case
+	{
+		const char *name;
+		HfpHFStatusFilter filter;
+	};
+
+	std::vector<Case> filters = {
+		{ "unfiltered", makeFilter(1, {}, {}) },
+		{ "battery", makeFilter(1, {"battery"}, {}) },
+		{ "signal,battery", makeFilter(1, {"signal", "battery"}, {}) },
+		{ "operator", makeFilter(1, {"operatorName", "networkStatus"}, {}) },
+		{ "calls", makeFilter(1, {"calls"}, {}) },
+		{ "one AG", makeFilter(1, {}, {address(ags - 1)}) }
+	};
+
+	AGState initial = { 3, 4, true, 8, false, 1, 0 };
+	std::vector<pbnjson::JValue> fragments = buildFragments(ags, initial);
+
+	printf("v1 filters, %d AGs with 1 call, %d changes of AG 0\n", ags, changes);
+	size_t unfilteredSize = 0;
+	double unfilteredNs = 0;
+	for (auto &filterCase : filters)
+	{
+		size_t size = serialize(filterCase.filter, fragments).size();
+		double ns = timeSerialize(iterations, filterCase.filter, fragments);
+		if (!unfilteredSize)
+		{
+			unfilteredSize = size;
+			unfilteredNs = ns;
+		}
+
+		// What HfpHFRole::flushStatusChanges compares before it posts
+		AGState state = initial;
+		std::vector<pbnjson::JValue> changed = fragments;
+		std::string posted = buildDevices(filterCase.filter, changed).stringify();
+		int posts = 0;
+		for (int step = 0; step < changes; step++)
+		{
+			applyChange(step, state);
+			changed[0] = buildAG(0, state);
+			std::string content = buildDevices(filterCase.filter, changed).stringify();
+			if (content == posted)
+				continue;
+			posted = content;
+			posts++;
+		}
+
+		printf("%-16s %5zu bytes %4.0f%%  %7.0f ns %4.0f%%  %5d posts %4.0f%%\n", filterCase.name, size,
+		       100.0 * size / unfilteredSize, ns, 100.0 * ns / unfilteredNs, posts, 100.0 * posts / changes);
+	}
+
+	HfpHFStatusFilter v1 = makeFilter(1, {}, {});
+	HfpHFStatusFilter v2 = makeFilter(2, {}, {});
+	printf("\nv1 against v2, %d AGs\n", ags);
+	for (int calls = 0; calls <= 3; calls++)
+	{
+		AGState state = initial;
+		state.calls = calls;
+		std::vector<pbnjson::JValue> callFragments = buildFragments(ags, state);
+
+		size_t v1Size = serialize(v1, callFragments).size();
+		size_t v2Size = serialize(v2, callFragments).size();
+		double v1Ns = timeSerialize(iterations, v1, callFragments);
+		double v2Ns = timeSerialize(iterations, v2, callFragments);
+		printf("%d calls per AG  v1 %5zu bytes %7.0f ns  v2 %5zu bytes %7.0f ns  v1/v2 size %4.2f time %4.2f\n", calls,
+		       v1Size, v1Ns, v2Size, v2Ns, (double) v1Size / v2Size, v1Ns / v2Ns);
+	}
+
+	return 0;
+}